@@ -0,0 +1,45 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bench_helper.h"
+#include "AsyncBuffer.hpp"
+#include "ChunkBuffer.hpp"
+
+using namespace asynclog;
+
+//模拟一轮突发写入，统计每次push的耗时，连续缓冲区在扩容时会出现明显的尖刺
+template<typename BufferType>
+void run(const char* name,const Util::JsonUtil::JsonData& config,size_t total_bytes)
+{
+    std::string record(200,'x');
+    record.back()='\n';
+
+    BufferType buf(config);
+    std::vector<uint64_t>samples;
+    samples.reserve(total_bytes/record.size()+1);
+    for(size_t written=0;written<total_bytes;written+=record.size())
+    {
+        uint64_t begin=bench::nowNs();
+        buf.push(record.data(),record.size());
+        samples.push_back(bench::nowNs()-begin);
+    }
+
+    uint64_t p50=bench::percentile(samples,50);
+    uint64_t p999=bench::percentile(samples,99.9);
+    uint64_t max=samples.back();
+    printf("%-14s %10lu %10lu %12lu\n",name,p50,p999,max);
+}
+
+int main()
+{
+    Util::JsonUtil::JsonData config;
+    config.buffer_size_=4*1024*1024;
+    config.chunk_size_=64*1024;
+    const size_t total=64*1024*1024;
+
+    printf("%-14s %10s %10s %12s\n","buffer","p50(ns)","p99.9(ns)","max(ns)");
+    run<Buffer>("Buffer",config,total);
+    run<ChunkBuffer>("ChunkBuffer",config,total);
+    return 0;
+}
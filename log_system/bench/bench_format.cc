@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <ctime>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "bench_helper.h"
+#include "Message.hpp"
+
+using namespace asynclog;
+
+//修改之前LogMessage::format的实现，作为对照
+std::string legacyFormat(const LogMessage& msg)
+{
+    struct tm tm_;
+    localtime_r(&msg.ctime_,&tm_);
+    char buf[128] = {0};
+    strftime(buf,sizeof(buf),"%Y-%m-%d %H:%M:%S",&tm_);
+
+    std::string tem1 = '['+std::string(buf)+"][";
+    std::string tem2 = "]["+ std::string(LogLevel::toString(msg.level_))+"]["+msg.name_+"]["+msg.file_name_+':'+std::to_string(msg.line_)+"]\t"+msg.pay_load_+'\n';
+
+    std::stringstream ret;
+    ret<<tem1<<msg.tid_<<tem2;
+    return ret.str();
+}
+
+//重复格式化同一条日志，返回平均每条的耗时(ns)
+template<typename F>
+double measure(int count,F&& f)
+{
+    size_t total=0;
+    uint64_t begin=bench::nowNs();
+    for(int i=0;i<count;++i)
+    {
+        total+=f();
+    }
+    uint64_t cost=bench::nowNs()-begin;
+    //防止编译器把循环优化掉
+    if(total==0) printf("unexpected empty output\n");
+    return static_cast<double>(cost)/count;
+}
+
+int main()
+{
+    const int count=1000000;
+    LogMessage msg(LogLevel::value::INFO,128,"src/server/DataManager.hpp","cloud_storage_server",
+        "insertData:insert into cloud_storage values('/download/a.txt','./deep_storage/a.txt',1024)");
+
+    std::string out;
+    out.reserve(512);
+    double legacy=measure(count,[&](){return legacyFormat(msg).size();});
+    double current=measure(count,[&](){return msg.format().size();});
+    double direct=measure(count,[&](){
+        out.clear();
+        msg.formatTo(out);
+        return out.size();
+    });
+    double stack=measure(count,[&](){
+        Fmt::LineWriter w;
+        msg.formatTo(w);
+        return w.size();
+    });
+
+    //读取时钟的开销
+    double seconds=measure(count,[](){return static_cast<size_t>(Clock::now(TimePrecision::SECOND).sec_);});
+    double tsc=measure(count,[](){return static_cast<size_t>(Clock::now(TimePrecision::NANO).nsec_|1);});
+    double realtime=measure(count,[](){return static_cast<size_t>(Clock::realtimeNs());});
+
+    printf("%-28s %10s\n","formatter","ns/record");
+    printf("%-28s %10.1f\n","legacy format()",legacy);
+    printf("%-28s %10.1f\n","format()",current);
+    printf("%-28s %10.1f\n","formatTo(std::string)",direct);
+    printf("%-28s %10.1f\n","formatTo(LineWriter)",stack);
+    printf("\n%-28s %10s\n","clock","ns/read");
+    printf("%-28s %10.1f\n","time(nullptr)",seconds);
+    printf("%-28s %10.1f (%s)\n","Clock::now(NANO)",tsc,
+        Clock::TscClock::getInstance().usingTsc() ? "tsc" : "clock_gettime");
+    printf("%-28s %10.1f\n","clock_gettime(REALTIME)",realtime);
+    return 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "LogFlush.hpp"
+
+namespace bench
+{
+
+//丢弃所有数据的落地方向，只测量前端的开销
+class NullFlush: public asynclog::LogFlush
+{
+public:
+    void flush(const char*,size_t)override {}
+};
+
+inline uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//返回第p百分位的值，会对samples排序
+inline uint64_t percentile(std::vector<uint64_t>& samples,double p)
+{
+    if(samples.empty()) return 0;
+    std::sort(samples.begin(),samples.end());
+    size_t idx=static_cast<size_t>(p/100.0*(samples.size()-1));
+    return samples[idx];
+}
+
+} // namespace bench
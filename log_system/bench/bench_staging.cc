@@ -0,0 +1,73 @@
+#include <thread>
+#include <mutex>
+#include <vector>
+
+#include "bench_helper.h"
+#include "AsyncLogger.hpp"
+
+using namespace asynclog;
+
+struct Result
+{
+    size_t lock_count;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+};
+
+//多个线程同时写日志，统计每次调用的耗时以及AsyncWorker中锁的获取次数
+Result run(size_t staging_size,int thread_num,int logs_per_thread)
+{
+    Util::JsonUtil::JsonData config;
+    config.staging_size_=staging_size;
+
+    std::vector<uint64_t>samples;
+    std::mutex samples_mtx;
+    size_t lock_count=0;
+    {
+        auto pool=std::make_shared<ThreadPool>(1,16);
+        std::vector<std::shared_ptr<LogFlush>>flushes{std::make_shared<bench::NullFlush>()};
+        AsyncLogger logger("bench",flushes,pool,config);
+
+        std::vector<std::thread>threads;
+        for(int t=0;t<thread_num;++t)
+        {
+            threads.emplace_back([&,t](){
+                std::vector<uint64_t>local;
+                local.reserve(logs_per_thread);
+                for(int i=0;i<logs_per_thread;++i)
+                {
+                    uint64_t begin=bench::nowNs();
+                    logger.info(__FILE__,__LINE__,"thread %d write log number %d",t,i);
+                    local.push_back(bench::nowNs()-begin);
+                }
+                std::lock_guard<std::mutex>lock(samples_mtx);
+                samples.insert(samples.end(),local.begin(),local.end());
+            });
+        }
+        for(auto&t:threads) t.join();
+        lock_count=logger.lockCount();
+    }
+
+    Result r;
+    r.lock_count=lock_count;
+    r.p50=bench::percentile(samples,50);
+    r.p99=bench::percentile(samples,99);
+    r.p999=bench::percentile(samples,99.9);
+    return r;
+}
+
+int main()
+{
+    const int thread_num=std::max(4u,std::thread::hardware_concurrency());
+    const int logs_per_thread=100000;
+
+    printf("threads=%d logs_per_thread=%d\n",thread_num,logs_per_thread);
+    printf("%-14s %14s %10s %10s %10s\n","staging_size","lock_acquires","p50(ns)","p99(ns)","p99.9(ns)");
+    for(size_t staging_size:{0,1024,4096,16384})
+    {
+        Result r=run(staging_size,thread_num,logs_per_thread);
+        printf("%-14zu %14zu %10lu %10lu %10lu\n",staging_size,r.lock_count,r.p50,r.p99,r.p999);
+    }
+    return 0;
+}
@@ -4,12 +4,21 @@
 #include <vector>
 #include <cstdarg>
 #include <memory>
+#include <mutex>
+#include <chrono>
+#include <array>
+#include <cstdio>
 
 #include "LogFlush.hpp"
 #include "AsyncWorker.hpp"
+#include "SinkWorker.hpp"
 #include "backlog/CliBackUpLog.hpp"
 #include "ThreadPool.hpp"
+#include "WorkStealingPool.hpp"
 #include "Message.hpp"
+#include "BinaryLog.hpp"
+#include "RateLimit.hpp"
+#include "Format.hpp"
 #include "Level.hpp"
 #include "ISystemOps.h"
 
@@ -23,64 +32,472 @@ public:
     int vasprintf(char **ret,const char *fmt,va_list ap)override{return ::vasprintf(ret,fmt,ap);}
 };
 
+class AsyncLogger;
+
+//线程本地暂存区，业务线程先把格式化好的日志写入这里，攒够一批之后再一次性提交给AsyncWorker
+struct StagingBuffer
+{
+    std::mutex mtx_;            //只有后台线程回收或者日志器析构时才会产生竞争
+    std::string data_;
+    std::chrono::steady_clock::time_point first_time_;  //暂存区中最早一条日志的写入时间
+    std::array<uint64_t,5>counts_{};  //暂存区中每个等级的日志条数，缓冲区满时按等级丢弃和统计
+    AsyncLogger* owner_=nullptr;//所属的日志器，日志器析构时置空
+};
+
+//每个线程持有的暂存区集合(按日志器的id区分)，线程退出时把剩余的数据提交给对应的日志器
+class StagingHolder
+{
+public:
+    std::vector<std::pair<uint64_t,std::shared_ptr<StagingBuffer>>>stagings_;
+
+    ~StagingHolder();
+
+    static StagingHolder& local()
+    {
+        static thread_local StagingHolder holder;
+        return holder;
+    }
+};
+
 class AsyncLogger
 {
+    friend class StagingHolder;
 protected:
     std::string logger_name_;
     std::vector<std::shared_ptr<LogFlush>>flushes_; //将日志刷新到多个地方
     std::unique_ptr<AsyncWorker> worker_;
-    std::shared_ptr<ThreadPool>thread_pool_;
+    std::shared_ptr<Executor>thread_pool_;
     std::unique_ptr<ISystemStrOps>ops_;
     Util::JsonUtil::JsonData config_data_;
     size_t max_buffer_size_;
 
-    void serialize(LogLevel::value level,const std::string& file,size_t line,char *ret)
+    uint64_t id_;                   //日志器的唯一id，用于区分线程本地暂存区
+    size_t staging_size_;           //线程本地暂存区的大小，为0时直接写入AsyncWorker
+    std::chrono::milliseconds staging_interval_;
+    std::mutex staging_mtx_;        //保护stagings_
+    std::vector<std::shared_ptr<StagingBuffer>>stagings_;   //所有线程中属于这个日志器的暂存区
+
+    bool binary_;                   //是否使用二进制日志
+    std::atomic<LogLevel::value> min_level_;   //运行时的最低日志等级
+    TimePrecision precision_;       //时间戳的精度
+    std::string render_buf_;        //二进制模式下后台线程渲染文本使用的缓冲区
+    std::string gather_buf_;        //二进制模式下把分段缓冲区拼接为连续数据使用的缓冲区
+    std::vector<struct iovec>iov_;  //分段模式下交给落地方向的iovec
+    std::vector<std::unique_ptr<SinkWorker>>sink_workers_;  //每个落地方向的线程，没有开启sink_threads时为空
+    std::shared_ptr<SinkBatchPool>batch_pool_;              //交给落地线程的批次
+    std::unique_ptr<BackupClient>backup_client_;    //转发ERROR/FATAL日志，没有开启backup_enabled时为空
+    std::chrono::steady_clock::time_point last_suppressed_flush_;   //后台线程上一次输出被限流条数的时间
+
+    static uint64_t nextId()
+    {
+        static std::atomic<uint64_t> id{0};
+        return ++id;
+    }
+
+    //获取当前线程属于这个日志器的暂存区，第一次使用时注册
+    StagingBuffer& localStaging()
     {
-        //构建消息体
-        LogMessage message(level,line,file,logger_name_,ret);
-        std::string data=message.format();
+        auto& holder=StagingHolder::local();
+        for(auto& [id,staging]:holder.stagings_)
+        {
+            if(id==id_) return *staging;
+        }
+
+        //顺便清理已经析构的日志器的暂存区
+        std::erase_if(holder.stagings_,[](auto& item){
+            std::lock_guard<std::mutex>lock(item.second->mtx_);
+            return item.second->owner_==nullptr;
+        });
+
+        auto staging=std::make_shared<StagingBuffer>();
+        staging->data_.reserve(staging_size_*2);
+        staging->owner_=this;
+        {
+            std::lock_guard<std::mutex>lock(staging_mtx_);
+            stagings_.push_back(staging);
+        }
+        holder.stagings_.emplace_back(id_,staging);
+        return *staging;
+    }
+
+    //调用者需要持有staging.mtx_，AsyncWorker拒绝时这批数据被丢弃并返回false
+    bool commitStaging(StagingBuffer& staging)
+    {
+        if(staging.data_.empty()) return true;
+        bool ret=worker_->pushStaged(staging.data_.data(),staging.data_.size(),staging.counts_);
+        staging.data_.clear();
+        staging.counts_.fill(0);
+        return ret;
+    }
+
+    /* 业务线程提交自己的暂存区，调用者通过lock持有staging.mtx_
+    先把数据取出再释放锁提交，block策略下等待空间时后台线程回收暂存区不会被这个锁阻塞
+    只有所属的线程会写入暂存区，它在提交期间不会写入新的数据，所以不会打乱顺序 */
+    bool commitStaging(StagingBuffer& staging,std::unique_lock<std::mutex>& lock)
+    {
+        if(staging.data_.empty()) return true;
+        static thread_local std::string data;
+        data.clear();
+        data.swap(staging.data_);
+        auto counts=staging.counts_;
+        staging.counts_.fill(0);
+        lock.unlock();
+        bool ret=worker_->pushStaged(data.data(),data.size(),counts);
+        lock.lock();
+        //归还容量，避免每次提交之后重新分配
+        if(staging.data_.empty())
+        {
+            data.clear();
+            data.swap(staging.data_);
+        }
+        return ret;
+    }
+
+    //线程退出时调用，调用者需要持有staging->mtx_
+    void unregisterStaging(StagingBuffer* staging)
+    {
+        std::lock_guard<std::mutex>lock(staging_mtx_);
+        std::erase_if(stagings_,[staging](auto& item){return item.get()==staging;});
+    }
+
+    /* 由AsyncWorker的后台线程在交换缓冲区之前调用，回收所有线程暂存区中的数据
+    正在被使用的暂存区留到下一次回收，线程退出时持有锁提交，block策略下等待它会让后台线程无法腾出空间 */
+    void collectStaging()
+    {
+        std::vector<std::shared_ptr<StagingBuffer>>stagings;
+        {
+            std::lock_guard<std::mutex>lock(staging_mtx_);
+            stagings=stagings_;
+        }
+        for(auto& staging:stagings)
+        {
+            std::unique_lock<std::mutex>lock(staging->mtx_,std::try_to_lock);
+            if(lock.owns_lock()) commitStaging(*staging);
+        }
+    }
+
+    //提交所有暂存区中的数据并解除和线程的关联
+    void detachStaging()
+    {
+        std::vector<std::shared_ptr<StagingBuffer>>stagings;
+        {
+            std::lock_guard<std::mutex>lock(staging_mtx_);
+            stagings=stagings_;
+        }
+        for(auto& staging:stagings)
+        {
+            std::lock_guard<std::mutex>lock(staging->mtx_);
+            commitStaging(*staging);
+            staging->owner_=nullptr;
+        }
+    }
+
+    bool serialize(LogLevel::value level,const char* file,size_t line,char *ret)
+    {
+        //日志头和消息体直接写入栈上的缓冲区，格式和LogMessage::format一致
+        Fmt::LineWriter w;
+        Fmt::writeHeader(w,Clock::now(precision_),precision_,Fmt::threadIdText(),level,logger_name_,file,line);
+        w.append(ret);
+        w.append("\n",1);
 
         if(level==LogLevel::value::ERROR||level==LogLevel::value::FATAL)
         {
-            try
-            {
-                auto ret=thread_pool_->enqueue(start_backup,data,
-                    config_data_.backup_addr_,config_data_.backup_port_);  
-            }
-            catch(const std::exception& e)
-            {
-                std::cerr << e.what() << '\n';
-            }
-            
+            backup(w.data(),w.size());
+        }
+        return flush(level,w.data(),w.size());
+    }
+
+    //返回false说明日志因为缓冲区满被丢弃
+    bool flush(LogLevel::value level,const char* data,size_t len)
+    {
+        if(staging_size_==0)
+        {
+            //因为AsyncWorker是线程安全的，所以此处不用加锁
+            return worker_->push(data,len,level);
+        }
+
+        //先写入线程本地暂存区，达到大小或者时间阈值之后再一次性提交
+        StagingBuffer& staging=localStaging();
+        std::unique_lock<std::mutex>lock(staging.mtx_);
+        auto now=std::chrono::steady_clock::now();
+        if(staging.data_.empty()) staging.first_time_=now;
+        staging.data_.append(data,len);
+        ++staging.counts_[static_cast<size_t>(level)];
+        if(staging.data_.size()>=staging_size_||now-staging.first_time_>=staging_interval_)
+        {
+            return commitStaging(staging,lock);
         }
-        flush(data.c_str(),data.size());
+        return true;
     }
 
-    void flush(const char* data,size_t len)
+    //二进制模式下用可变参数构造一条记录
+    void encodeRecord(std::string& out,LogLevel::value level,const char* file,size_t line,const char* format,...)
     {
-        //因为AsyncWorker是线程安全的，所以此处不用加锁
-        worker_->push(data,len);
+        va_list args;
+        va_start(args,format);
+        Binary::encode(out,nullptr,level,file,line,format,args,precision_);
+        va_end(args);
+    }
+
+    /* 后台线程写入一条日志，不经过暂存区和等级过滤，直接放入AsyncWorker
+    后台线程调用push可能在BLOCK策略下等待自己，所以使用pushStaged */
+    void pushReport(LogLevel::value level,const char* file,size_t line,const char* text)
+    {
+        if(binary_)
+        {
+            std::string record;
+            encodeRecord(record,level,file,line,"%s",text);
+            worker_->pushStaged(record.data(),record.size(),level);
+            return;
+        }
+        Fmt::LineWriter w;
+        Fmt::writeHeader(w,Clock::now(precision_),precision_,Fmt::threadIdText(),level,logger_name_,file,line);
+        w.append(text);
+        w.push('\n');
+        if(level==LogLevel::value::ERROR||level==LogLevel::value::FATAL)
+        {
+            backup(w.data(),w.size());
+        }
+        worker_->pushStaged(w.data(),w.size(),level);
+    }
+
+    //由AsyncWorker的后台线程在丢弃日志的压力消退之后调用，写入一条WARN日志汇报各等级丢弃的条数
+    void reportDrops(const std::array<uint64_t,5>& counts)
+    {
+        char summary[256];
+        snprintf(summary,sizeof(summary),
+            "log records dropped under buffer pressure: DEBUG=%lu INFO=%lu WARN=%lu ERROR=%lu FATAL=%lu",
+            (unsigned long)counts[0],(unsigned long)counts[1],(unsigned long)counts[2],
+            (unsigned long)counts[3],(unsigned long)counts[4]);
+        pushReport(LogLevel::value::WARN,__FILE__,__LINE__,summary);
+    }
+
+    /* 输出最近由这个日志器限流的调用点中还没有汇报的条数，调用点在日志风暴之后一直没有再输出时也不会漏掉
+    release为true时(日志器析构)解除关联 */
+    void flushSuppressed(bool release)
+    {
+        //BLOCK策略下pushStaged可能等待后台线程，所以不能在持有注册表的锁时写入
+        std::vector<std::pair<const CallSite*,uint64_t>>pending;
+        CallSiteRegistry::getInstance().forEachLimited([this,release,&pending](const CallSite* site,SuppressedCounter* counter){
+            if(counter->owner()!=this) return;
+            uint64_t n=counter->takeSuppressed();
+            if(n>0) pending.emplace_back(site,n);
+            if(release) counter->release(this);
+        });
+        for(auto& [site,n]:pending)
+        {
+            std::string text=std::to_string(n)+" records suppressed by rate limit: "+site->format_;
+            pushReport(site->level_,site->file_,site->line_,text.c_str());
+        }
+    }
+
+    //二进制模式下只拷贝参数，格式化由后台线程在realFlush中完成
+    bool serializeBinary(LogLevel::value level,const CallSite* site,const char* file,size_t line,const char* format,va_list args)
+    {
+        static thread_local std::string record;
+        record.clear();
+        Binary::encode(record,site,level,file,line,format,args,precision_);
+        return flush(level,record.data(),record.size());
+    }
+
+    bool logV(LogLevel::value level,const CallSite* site,const char* file,size_t line,const char* format,va_list args)
+    {
+        if(!shouldLog(level)) return false;
+        if(binary_)
+        {
+            return serializeBinary(level,site,file,line,format,args);
+        }
+
+        char * ret;
+        int r = ops_->vasprintf(&ret,format,args);
+        if(r==-1||ret==nullptr)
+        {
+            return false;
+        }
+
+        bool pushed=serialize(level,file,line,ret);
+
+        free(ret);
+        return pushed;
+    }
+
+    bool logAt(LogLevel::value level,const char* file,size_t line,const char* format,...)
+    {
+        va_list args;
+        va_start(args,format);
+        bool ret=logV(level,nullptr,file,line,format,args);
+        va_end(args);
+        return ret;
+    }
+
+    //类型安全的日志接口的实现，整条日志在栈上完成格式化
+    template<typename F,typename... A>
+    bool logFmt(LogLevel::value level,const F& fmt,const A&... args)
+    {
+        if(!shouldLog(level)) return false;
+        Fmt::LineWriter w;
+        //二进制模式下参数已经渲染完成，正文作为"%.*s"的字符串参数编码成一条内联格式的记录，备份在renderBinary中完成
+        if(binary_)
+        {
+            fmt.format(w,args...);
+            static thread_local std::string record;
+            record.clear();
+            encodeRecord(record,level,fmt.location().file_name(),fmt.location().line(),
+                "%.*s",static_cast<int>(w.size()),w.data());
+            return flush(level,record.data(),record.size());
+        }
+        Fmt::writeHeader(w,Clock::now(precision_),precision_,Fmt::threadIdText(),level,logger_name_,
+            fmt.location().file_name(),fmt.location().line());
+        fmt.format(w,args...);
+        w.push('\n');
+
+        if(level==LogLevel::value::ERROR||level==LogLevel::value::FATAL)
+        {
+            backup(w.data(),w.size());
+        }
+        return flush(level,w.data(),w.size());
+    }
+
+    //只把记录拷贝到BackupClient的队列中，由它的线程合并发送
+    void backup(const char* data,size_t len)
+    {
+        if(backup_client_) backup_client_->post(data,len);
+    }
+
+    //把二进制记录渲染为文本并刷新，ERROR/FATAL级别的日志在这里发送到备份服务器
+    void renderBinary(const char* data,size_t len)
+    {
+        render_buf_.clear();
+        Binary::decode(data,len,logger_name_,render_buf_,
+            [this](LogLevel::value level,const char* line,size_t len){
+                if(level==LogLevel::value::ERROR||level==LogLevel::value::FATAL)
+                {
+                    backup(line,len);
+                }
+            },precision_);
+        if(!sink_workers_.empty())
+        {
+            auto batch=batch_pool_->acquire();
+            batch->text_.swap(render_buf_);
+            batch->iov_.push_back(iovec{batch->text_.data(),batch->text_.size()});
+            dispatch(std::move(batch));
+            return;
+        }
+        for(auto&f:flushes_)
+        {
+            f->flush(render_buf_.data(),render_buf_.size());
+        }
+    }
+
+    //把一批数据交给所有落地线程，空的批次不需要交给它们
+    void dispatch(std::shared_ptr<SinkBatch>batch)
+    {
+        size_t bytes=0;
+        for(auto& iov:batch->iov_) bytes+=iov.iov_len;
+        if(bytes==0) return;
+        for(auto& w:sink_workers_) w->push(batch);
+    }
+
+    //后台线程顺便对齐高精度时钟的锚点
+    void resyncClock()
+    {
+        if(precision_!=TimePrecision::SECOND)
+        {
+            Clock::TscClock::getInstance().resync();
+        }
     }
 
     //将缓冲区中的数据刷新到磁盘中
     void realFlush(Buffer&buf)
     {   
+        resyncClock();
+        if(binary_)
+        {
+            renderBinary(buf.peek(),buf.readableBytes());
+            buf.moveReadPos(buf.readableBytes());
+            return;
+        }
+
+        if(!sink_workers_.empty())
+        {
+            //交换出消费者缓冲区，后台线程换上一个空的缓冲区继续工作
+            auto batch=batch_pool_->acquire();
+            batch->buffer_.swap(buf);
+            batch->iov_.push_back(iovec{const_cast<char*>(batch->buffer_.peek()),batch->buffer_.readableBytes()});
+            dispatch(std::move(batch));
+            return;
+        }
+
         for(auto&f:flushes_)
         {
             f->flush(buf.peek(),buf.readableBytes());
         }
         buf.moveReadPos(buf.readableBytes());
     }
+
+    //分段模式下把每个块作为iovec交给落地方向，不拷贝数据
+    void realFlushChunks(ChunkBuffer& chunks)
+    {
+        resyncClock();
+        iov_.clear();
+        chunks.toIovec(iov_);
+        if(binary_)
+        {
+            //二进制记录可能跨越块的边界，先拼接为连续的数据再解码
+            gather_buf_.clear();
+            for(auto& iov:iov_)
+            {
+                gather_buf_.append(static_cast<const char*>(iov.iov_base),iov.iov_len);
+            }
+            renderBinary(gather_buf_.data(),gather_buf_.size());
+            return;
+        }
+
+        if(!sink_workers_.empty())
+        {
+            //块移动到批次中，所有落地线程写完之后才归还给ChunkPool
+            auto batch=batch_pool_->acquire();
+            batch->chunks_.splice(chunks);
+            batch->chunks_.toIovec(batch->iov_);
+            dispatch(std::move(batch));
+            return;
+        }
+
+        for(auto&f:flushes_)
+        {
+            f->flushv(iov_.data(),static_cast<int>(iov_.size()));
+        }
+    }
 public:
     AsyncLogger(std::string logger_name,const std::vector<std::shared_ptr<LogFlush>>&flushes
-        ,std::shared_ptr<ThreadPool>pool,Util::JsonUtil::JsonData config_data
+        ,std::shared_ptr<Executor>pool,Util::JsonUtil::JsonData config_data
         ,BufferPolicy buf_policy=BufferPolicy::UNLIMITED,size_t max_buffer_size=16*1024
         ,std::unique_ptr<ISystemStrOps>ops=nullptr)
         :logger_name_(std::move(logger_name))
         ,flushes_(flushes)
         ,thread_pool_(pool)
         ,config_data_(std::move(config_data))
+        ,id_(nextId())
+        ,binary_(config_data_.binary_log_)
+        ,min_level_(LogLevel::value::DEBUG)
+        ,precision_(TimePrecision::SECOND)
     {
+        if(!Clock::precisionFromString(config_data_.timestamp_precision_,precision_))
+        {
+            precision_=TimePrecision::SECOND;
+        }
+        //在构造时完成高精度时钟的标定，避免第一条日志等待
+        if(precision_!=TimePrecision::SECOND)
+        {
+            Clock::TscClock::getInstance();
+        }
+
+        LogLevel::value level;
+        if(LogLevel::fromString(config_data_.log_level_,level))
+        {
+            min_level_.store(level);
+        }
+
         if(ops)
         {
             ops_=std::move(ops);
@@ -89,122 +506,227 @@ public:
         {
             ops_=std::make_unique<RealSystemStrOps>();
         }
+        //落地方向的后台任务(例如压缩滚动的日志文件)使用日志器的线程池
+        for(auto&f:flushes_) f->setThreadPool(thread_pool_);
+        if(config_data_.backup_enabled_)
+        {
+            backup_client_=std::make_unique<BackupClient>(config_data_.backup_addr_,config_data_.backup_port_,config_data_);
+        }
+        if(config_data_.sink_threads_)
+        {
+            batch_pool_=std::make_shared<SinkBatchPool>(config_data_);
+            for(auto&f:flushes_) sink_workers_.push_back(std::make_unique<SinkWorker>(f,config_data_));
+        }
         //这里不要在初始化列表中构造AsyncWorker，因为config_data_使用了move，不管用哪个变量都可能是空的
-        worker_=std::make_unique<AsyncWorker>(config_data_,[this](Buffer&buf){realFlush(buf);},buf_policy,max_buffer_size);
+        worker_=std::make_unique<AsyncWorker>(config_data_,[this](Buffer&buf){realFlush(buf);},buf_policy,max_buffer_size,
+            [this](ChunkBuffer&chunks){realFlushChunks(chunks);});
+
+        staging_size_=config_data_.staging_size_;
+        staging_interval_=std::chrono::milliseconds(config_data_.staging_interval_ms_);
+        last_suppressed_flush_=std::chrono::steady_clock::now();
+        worker_->setCollector([this](){
+            if(staging_size_>0) collectStaging();
+            //每秒最多检查一次被限流的调用点
+            auto now=std::chrono::steady_clock::now();
+            if(now-last_suppressed_flush_>=std::chrono::seconds(1))
+            {
+                last_suppressed_flush_=now;
+                flushSuppressed(false);
+            }
+        });
+        worker_->setDropReporter([this](const std::array<uint64_t,5>& counts){reportDrops(counts);});
+        worker_->setSyncFunctor([this](){
+            if(sink_workers_.empty())
+            {
+                for(auto&f:flushes_) f->sync();
+                return;
+            }
+            //所有落地线程同时落盘
+            std::vector<uint64_t>seqs;
+            for(auto& w:sink_workers_) seqs.push_back(w->requestSync());
+            for(size_t i=0;i<sink_workers_.size();++i) sink_workers_[i]->waitSync(seqs[i]);
+        });
         worker_->start();
     }
     ~AsyncLogger()
     {
-
+        //先把各线程暂存区中的数据提交并解除关联，再停止后台线程
+        detachStaging();
+        //还没有汇报的被限流条数写入缓冲区，之后的计数由下一次使用调用点的日志器汇报
+        flushSuppressed(true);
+        //后台线程退出之前可能还会通过worker_写入汇报丢弃条数的日志，所以先等待它退出再析构
+        worker_->stop();
+        worker_->join();
+        worker_.reset();
+        //落地线程写完队列中剩余的批次之后退出
+        sink_workers_.clear();
+        //发送或者溢出还没有转发的记录
+        backup_client_.reset();
     }
 
     inline std::string name()const {return logger_name_;}
 
-    bool debug(const std::string&file,size_t line,const std::string&format,...)
+    //线程安全，可以在运行时调整日志等级
+    void setLevel(LogLevel::value level){min_level_.store(level,std::memory_order_relaxed);}
+    inline LogLevel::value level()const {return min_level_.load(std::memory_order_relaxed);}
+
+    //该等级的日志是否需要输出，日志宏在求值参数之前调用
+    inline bool shouldLog(LogLevel::value level)const
     {
-        //获取可变参数列表
-        va_list args;
-        va_start(args,format);
+        return LogLevel::enabled(level)&&level>=min_level_.load(std::memory_order_relaxed);
+    }
 
-        char * ret;
-        int r = ops_->vasprintf(&ret,format.c_str(),args);
-        va_end(args);
+    /* 类型安全的日志接口，格式串使用{}占位符，在编译期检查占位符和参数的个数
+    整数、浮点数和字符串参数直接写入栈上的缓冲区，不需要堆内存
+    例如: logger->infoFmt("upload {} size {}",name,size); */
+    template<typename... Args>
+    bool debugFmt(FormatStringFor<Args...> fmt,Args&&... args)
+    {
+        return logFmt(LogLevel::value::DEBUG,fmt,args...);
+    }
 
-        if(r==-1||ret==nullptr)
-        {
-            return false;
-        }
+    template<typename... Args>
+    bool infoFmt(FormatStringFor<Args...> fmt,Args&&... args)
+    {
+        return logFmt(LogLevel::value::INFO,fmt,args...);
+    }
 
-        serialize(LogLevel::value::DEBUG,file,line,ret);
+    template<typename... Args>
+    bool warnFmt(FormatStringFor<Args...> fmt,Args&&... args)
+    {
+        return logFmt(LogLevel::value::WARN,fmt,args...);
+    }
 
-        free(ret);
-        return true;
+    template<typename... Args>
+    bool errorFmt(FormatStringFor<Args...> fmt,Args&&... args)
+    {
+        return logFmt(LogLevel::value::ERROR,fmt,args...);
     }
 
-    bool info(const std::string&file,size_t line,const std::string&format,...)
+    template<typename... Args>
+    bool fatalFmt(FormatStringFor<Args...> fmt,Args&&... args)
     {
-        //获取可变参数列表
-        va_list args;
-        va_start(args,format);
+        return logFmt(LogLevel::value::FATAL,fmt,args...);
+    }
 
-        char * ret;
-        int r = ops_->vasprintf(&ret,format.c_str(),args);
+    //通过静态调用点记录日志，由日志宏使用
+    bool logSite(const CallSite* site,...)
+    {
+        va_list args;
+        va_start(args,site);
+        bool ret=logV(site->level_,site,site->file_,site->line_,site->format_,args);
         va_end(args);
+        return ret;
+    }
 
-        if(r==-1||ret==nullptr)
+    //限流的调用点在下一条日志之前输出一条汇总记录，说明期间有多少条被丢弃，n为0时不输出
+    bool logSuppressed(const CallSite* site,uint64_t n)
+    {
+        if(n==0) return false;
+        return logAt(site->level_,site->file_,site->line_,"%llu records suppressed by rate limit: %s",
+            static_cast<unsigned long long>(n),site->format_);
+    }
+
+    //限流的调用点被限流时调用，第一次被限流时登记到CallSiteRegistry，由后台线程定期汇报被限流的条数
+    template<typename L>
+    void trackSuppressed(const CallSite* site,L& limiter)
+    {
+        if constexpr(std::is_base_of_v<SuppressedCounter,L>)
         {
-            return false;
+            if(limiter.track(this)) CallSiteRegistry::getInstance().addLimited(site,&limiter);
         }
+    }
 
-        serialize(LogLevel::value::INFO,file,line,ret);
+    /* 把调用之前写入的所有日志刷新到各个落地方向并落盘，阻塞直到完成或者超时(超时返回false)
+    多个线程同时调用时共享同一次落盘，适合只在关键操作之后要求持久化、平时使用flush_log=0的场景 */
+    bool flushAndWait(std::chrono::milliseconds timeout)
+    {
+        //先提交各线程暂存区中的数据，保证它们在这次落盘的范围内
+        if(staging_size_>0) collectStaging();
+        return worker_->sync(timeout);
+    }
 
-        free(ret);
-        return true;
+    //不限时间地等待落盘完成
+    bool sync()
+    {
+        return flushAndWait(std::chrono::milliseconds::max());
     }
 
-    bool warn(const std::string&file,size_t line,const std::string&format,...)
+    //生产者获取AsyncWorker中锁的次数
+    inline size_t lockCount()const {return worker_->lockCount();}
+    //累计因为缓冲区满被丢弃的某个等级的日志条数
+    inline uint64_t droppedCount(LogLevel::value level)const {return worker_->droppedCount(level);}
+    //第idx个落地方向因为队列已满丢弃的批次数，没有开启sink_threads时为0
+    inline uint64_t sinkDroppedBatches(size_t idx)const
+    {
+        return idx<sink_workers_.size() ? sink_workers_[idx]->dropped() : 0;
+    }
+    //没有配置备份服务器时返回nullptr
+    inline BackupClient* backupClient()const {return backup_client_.get();}
+
+    bool debug(const char* file,size_t line,const char* format,...)
     {
         //获取可变参数列表
         va_list args;
         va_start(args,format);
-
-        char * ret;
-        int r = ops_->vasprintf(&ret,format.c_str(),args);
+        bool ret=logV(LogLevel::value::DEBUG,nullptr,file,line,format,args);
         va_end(args);
-
-        if(r==-1||ret==nullptr)
-        {
-            return false;
-        }
-
-        serialize(LogLevel::value::WARN,file,line,ret);
-
-        free(ret);
-        return true;
+        return ret;
     }
 
-    bool error(const std::string&file,size_t line,const std::string&format,...)
+    bool info(const char* file,size_t line,const char* format,...)
     {
         //获取可变参数列表
         va_list args;
         va_start(args,format);
-
-        char * ret;
-        int r = ops_->vasprintf(&ret,format.c_str(),args);
+        bool ret=logV(LogLevel::value::INFO,nullptr,file,line,format,args);
         va_end(args);
+        return ret;
+    }
 
-        if(r==-1||ret==nullptr)
-        {
-            return false;
-        }
-
-        serialize(LogLevel::value::ERROR,file,line,ret);
-
-        free(ret);
-        return true;
+    bool warn(const char* file,size_t line,const char* format,...)
+    {
+        //获取可变参数列表
+        va_list args;
+        va_start(args,format);
+        bool ret=logV(LogLevel::value::WARN,nullptr,file,line,format,args);
+        va_end(args);
+        return ret;
     }
 
-    bool fatal(const std::string&file,size_t line,const std::string&format,...)
+    bool error(const char* file,size_t line,const char* format,...)
     {
         //获取可变参数列表
         va_list args;
         va_start(args,format);
+        bool ret=logV(LogLevel::value::ERROR,nullptr,file,line,format,args);
+        va_end(args);
+        return ret;
+    }
 
-        char * ret;
-        int r = ops_->vasprintf(&ret,format.c_str(),args);
+    bool fatal(const char* file,size_t line,const char* format,...)
+    {
+        //获取可变参数列表
+        va_list args;
+        va_start(args,format);
+        bool ret=logV(LogLevel::value::FATAL,nullptr,file,line,format,args);
         va_end(args);
+        return ret;
+    }
+};
 
-        if(r==-1||ret==nullptr)
+inline StagingHolder::~StagingHolder()
+{
+    for(auto& [id,staging]:stagings_)
+    {
+        std::lock_guard<std::mutex>lock(staging->mtx_);
+        if(staging->owner_)
         {
-            return false;
+            staging->owner_->commitStaging(*staging);
+            staging->owner_->unregisterStaging(staging.get());
         }
-
-        serialize(LogLevel::value::FATAL,file,line,ret);
-
-        free(ret);
-        return true;
     }
-};
+}
 
 class AsyncLoggerBuilder
 {
@@ -235,7 +757,7 @@ public:
             LogFlushFactory<FlushType>::createLogFlush(std::forward<Args>(args)...));
     }
 
-    std::shared_ptr<AsyncLogger> build(std::shared_ptr<ThreadPool>pool)
+    std::shared_ptr<AsyncLogger> build(std::shared_ptr<Executor>pool)
     {
         if(flushes_.empty()) addLogFlush<StdOutFlush>();
         return std::make_shared<AsyncLogger>(logger_name_,flushes_,pool,config_data_,buffer_policy_,max_buffer_size_);
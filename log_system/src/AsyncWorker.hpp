@@ -7,8 +7,16 @@
 #include <iostream>
 #include <atomic>
 #include <chrono>
+#include <vector>
+#include <array>
+#include <deque>
+#include <string_view>
 
 #include "AsyncBuffer.hpp"
+#include "RingBuffer.hpp"
+#include "ChunkBuffer.hpp"
+#include "FlushScheduler.hpp"
+#include "Level.hpp"
 #include "Util.hpp"
 
 namespace asynclog
@@ -18,13 +26,50 @@ namespace asynclog
 enum class BufferPolicy
 {
     LIMIT_SIZE,   //缓冲区有限制大小
-    UNLIMITED     //缓冲区无限制大小
+    UNLIMITED,    //缓冲区无限制大小
+    LOCK_FREE     //生产者写入无锁环形缓冲区，环形缓冲区满时退化为加锁写入生产者缓冲区
 };
 
+//LIMIT_SIZE模式下生产者缓冲区满时的处理策略
+enum class OverflowPolicy
+{
+    REJECT,     //直接拒绝新的日志
+    BLOCK,      //阻塞等待消费者腾出空间，超时之后拒绝
+    DROP_LOW,   //按等级分级丢弃: 使用超过1/2时丢弃DEBUG，超过3/4时丢弃INFO，WARN及以上只在缓冲区满时丢弃
+    EVICT_LOW   //缓冲区满时丢弃最早写入的DEBUG/INFO日志，为WARN及以上的日志腾出空间
+};
+
+//配置中的"reject"/"block"/"drop_low"/"evict_low"转换为溢出策略，无法识别时返回false
+inline bool overflowPolicyFromString(std::string_view str,OverflowPolicy& policy)
+{
+    if(str=="reject") policy=OverflowPolicy::REJECT;
+    else if(str=="block") policy=OverflowPolicy::BLOCK;
+    else if(str=="drop_low") policy=OverflowPolicy::DROP_LOW;
+    else if(str=="evict_low") policy=OverflowPolicy::EVICT_LOW;
+    else return false;
+    return true;
+}
+
 class AsyncWorker
 {
 private:
     using Functor=std::function<void(Buffer&)>;
+    using Collector=std::function<void()>;
+    using SyncFunctor=std::function<void()>;
+    using ChunkFunctor=std::function<void(ChunkBuffer&)>;
+    using DropCounts=std::array<uint64_t,5>;
+    using DropReporter=std::function<void(const DropCounts&)>;
+
+    /* EVICT_LOW模式下生产者缓冲区中一条记录的位置，暂存区提交的一批数据也作为一条记录，
+    level_为其中最高的等级，只有全部是DEBUG/INFO的一批数据才会被丢弃，丢弃时按两个等级各自的条数统计 */
+    struct RecordInfo
+    {
+        size_t offset_;
+        size_t len_;
+        LogLevel::value level_;
+        uint32_t debug_count_;
+        uint32_t info_count_;
+    };
 
     BufferPolicy buffer_policy_;    //是否限制缓冲区大小
     size_t max_buffer_bytes_ ;      //如果限制缓冲区大小，允许写入缓冲区的最大大小(如果不限制大小，则此参数无意义) 
@@ -33,6 +78,40 @@ private:
     Buffer consumer_buffer_;        //消费者缓冲区(用于后台线程进行将日志内容输出)
     Functor functor_;               //用于处理消费缓冲区内容的函数(将输出缓冲区中的内容写入到其它地方)
     double swap_factor=0.5;         //决定判断缓冲区是否置换的因子(可读数据和缓冲区大小*swap_factor作比较)
+    static constexpr size_t kSegmentedBufferSize=4096;
+    std::unique_ptr<MpscRingBuffer>ring_;   //LOCK_FREE模式下生产者写入的环形缓冲区
+    std::atomic_bool overflow_;     //LOCK_FREE模式下生产者缓冲区中是否有溢出的数据，为true时生产者都走慢路径，保证同一线程的日志顺序
+    std::atomic<size_t> ring_writers_;//正在无锁快路径中写入环形缓冲区的生产者数量，后台线程等它们写完再退出
+    Collector collector_;           //每次交换缓冲区之前由后台线程调用，用于回收外部暂存(如线程本地暂存区)的数据
+    std::atomic<size_t> lock_count_;//生产者获取mtx_的次数，用于统计锁竞争
+    std::unique_ptr<ChunkBuffer>productor_chunks_;  //分段模式(chunk_size>0)下代替productor_buffer_
+    std::unique_ptr<ChunkBuffer>consumer_chunks_;   //分段模式下代替consumer_buffer_
+    ChunkFunctor chunk_functor_;    //分段模式下处理消费缓冲区的函数，为空时先拷贝到consumer_buffer_再调用functor_
+    size_t chunk_swap_bytes_;       //分段模式下的交换阈值
+    std::vector<std::unique_ptr<Buffer>>free_buffers_;  //缓冲区队列模式(buffer_count>2)下预先分配的空闲缓冲区
+    std::vector<std::unique_ptr<Buffer>>full_buffers_;  //已经写满、等待消费者处理的缓冲区(按写入顺序)
+    std::chrono::milliseconds max_latency_;     //消费者最长的等待时间
+    std::unique_ptr<FlushScheduler>scheduler_;  //自适应刷新模式下决定等待时间和交换阈值
+    size_t swap_threshold_;                     //自适应刷新模式下的交换阈值，由后台线程更新
+
+    OverflowPolicy overflow_policy_;            //LIMIT_SIZE模式下缓冲区满时的策略
+    std::chrono::milliseconds block_timeout_;   //BLOCK策略下最长的阻塞时间
+    std::condition_variable cond_productor_;    //BLOCK策略下生产者等待消费者腾出空间
+    size_t blocked_;                            //BLOCK策略下正在等待的生产者数量，由mtx_保护
+    std::deque<RecordInfo>records_;             //EVICT_LOW策略下生产者缓冲区中每条记录的位置和等级
+    std::array<std::atomic<uint64_t>,5>dropped_;//按等级统计被丢弃的日志条数
+    DropCounts unreported_;                     //还没有汇报的丢弃条数，由mtx_保护
+    bool dropping_;                             //上一次交换之后是否发生过丢弃，由mtx_保护
+    DropReporter drop_reporter_;                //压力消退之后汇报丢弃条数
+    std::thread::id consumer_id_;               //后台线程的id，由mtx_保护
+
+    /* 组提交: 每次sync请求领取一个递增的序号，后台线程交换缓冲区时记下已经登记的最大序号，
+    刷新完这一批数据之后只调用一次sync_functor_落盘，所有序号不超过它的请求一起完成 */
+    SyncFunctor sync_functor_;                  //让所有落地方向落盘
+    std::condition_variable cond_sync_;         //sync请求等待落盘完成
+    uint64_t sync_requested_;                   //已经登记的最大序号，由mtx_保护
+    uint64_t sync_covered_;                     //已经被某次交换覆盖的最大序号，由mtx_保护
+    uint64_t sync_done_;                        //已经落盘完成的最大序号，由mtx_保护
 
     
     std::unique_ptr<std::thread>thread_ ;//后台线程
@@ -45,69 +124,401 @@ private:
     如果生产者缓冲区中的可读的数据达到总量的一部分(由swap_factor决定)则置换 */
     inline bool needSwap()const 
     {
+        if(!full_buffers_.empty()||blocked_>0||sync_requested_>sync_covered_) return true;
+        if(ring_&&ring_->usedBytes()>ring_->capacity()*swap_factor) return true;
+        if(scheduler_) return productorBytes()>swap_threshold_;
+        if(productor_chunks_) return productor_chunks_->readableBytes()>chunk_swap_bytes_;
         return productor_buffer_.readableBytes()>productor_buffer_.size()*swap_factor;
     }
 
-    //functor进行一次刷盘应该将缓冲区的数据全部刷入磁盘
-    void ThreadEntry()
+    inline bool hasProductorData()const
     {
-       while(1)
-       {
-            std::unique_lock<std::mutex>lock(mtx_);
-            //超过3s或者是达到交换阈值时就执行交换将数据刷新到磁盘中
-            cond_consumer_.wait_for(lock,std::chrono::seconds(3),[this](){
+        return productorBytes()>0||(ring_&&!ring_->isEmpty());
+    }
+
+    inline bool isAllEmpty()const
+    {
+        if(productor_chunks_&&!(productor_chunks_->isEmpty()&&consumer_chunks_->isEmpty())) return false;
+        if(!full_buffers_.empty()) return false;
+        return consumer_buffer_.isEmpty()&&productor_buffer_.isEmpty()&&(!ring_||ring_->isEmpty());
+    }
+
+    inline size_t productorBytes()const
+    {
+        return productor_chunks_ ? productor_chunks_->readableBytes() : productor_buffer_.readableBytes();
+    }
+
+    inline size_t consumerBytes()const
+    {
+        return productor_chunks_ ? consumer_chunks_->readableBytes() : consumer_buffer_.readableBytes();
+    }
+
+    //等待下一次刷新，调用者需要持有mtx_
+    void waitForFlush(std::unique_lock<std::mutex>& lock)
+    {
+        if(!scheduler_)
+        {
+            //超过max_latency_或者是达到交换阈值时就执行交换将数据刷新到磁盘中
+            cond_consumer_.wait_for(lock,max_latency_,[this](){
                 return !started||needSwap();
             });
+            return;
+        }
 
-            //如果停止同时缓冲区中无数据的话，退出
-            if(!started&&consumer_buffer_.isEmpty()&&productor_buffer_.isEmpty()) break;
-            
+        //没有数据时最多等待max_latency_，有数据之后最多再等待调度器给出的时间
+        cond_consumer_.wait_for(lock,max_latency_,[this](){
+            return !started||needSwap()||hasProductorData();
+        });
+        cond_consumer_.wait_for(lock,scheduler_->interval(),[this](){
+            return !started||needSwap();
+        });
+    }
+
+    //交换生产者和消费者缓冲区，调用者需要持有mtx_
+    void swapBuffers()
+    {
+        if(ring_)
+        {
+            /* 先取出环形缓冲区中在持锁期间已经预留的记录，再追加溢出到生产者缓冲区的数据，
+            溢出期间生产者都走慢路径，所以同一线程的日志不会乱序 */
+            if(productor_chunks_)
+            {
+                ring_->drainTo(*consumer_chunks_,ring_->reservedPos());
+                consumer_chunks_->splice(*productor_chunks_);
+            }
+            else
+            {
+                ring_->drainTo(consumer_buffer_,ring_->reservedPos());
+                if(!productor_buffer_.isEmpty())
+                {
+                    consumer_buffer_.push(productor_buffer_.peek(),productor_buffer_.readableBytes());
+                    productor_buffer_.reset();
+                }
+            }
+            overflow_.store(false,std::memory_order_release);
+        }
+        else if(productor_chunks_)
+        {
+            productor_chunks_->swap(*consumer_chunks_);
+        }
+        else
+        {
             productor_buffer_.swap(consumer_buffer_);
+        }
+        records_.clear();
+    }
 
-            lock.unlock();
+    /* 分段模式下连续缓冲区只在没有chunk_functor时用于拼接数据，初始大小不需要buffer_size_，
+    避免每个日志器都固定占用两个buffer_size_大小的缓冲区 */
+    static Util::JsonUtil::JsonData contiguousConfig(const Util::JsonUtil::JsonData& config_data)
+    {
+        Util::JsonUtil::JsonData ret=config_data;
+        if(ret.chunk_size_>0) ret.buffer_size_=std::min<size_t>(ret.buffer_size_,kSegmentedBufferSize);
+        return ret;
+    }
 
-            functor_(consumer_buffer_);
-            consumer_buffer_.reset();
-       }
+    /* 缓冲区队列模式下当前生产者缓冲区放不下len时，把它放入full_buffers_并换上一个空闲缓冲区，
+    没有空闲缓冲区时返回false，按照原来的策略扩容或者拒绝，调用者需要持有mtx_ */
+    bool rotateBuffer(size_t len)
+    {
+        if(free_buffers_.empty()||productor_buffer_.isEmpty()) return false;
+        if(productor_buffer_.writeableBytes()>=len) return false;
+        full_buffers_.push_back(std::move(free_buffers_.back()));
+        free_buffers_.pop_back();
+        full_buffers_.back()->swap(productor_buffer_);
+        records_.clear();
+        return true;
     }
-    
-public:
-    AsyncWorker(const Util::JsonUtil::JsonData&config_data,Functor functor,
-        BufferPolicy buffer_policy=BufferPolicy::UNLIMITED,size_t max_buffer_bytes=16*1024)
-        :buffer_policy_(buffer_policy)
-        ,max_buffer_bytes_(max_buffer_bytes)
-        ,functor_(std::move(functor))
-        ,productor_buffer_(config_data)
-        ,consumer_buffer_(config_data)
-        ,started(false)
-    {}
-    ~AsyncWorker()
+
+    inline static size_t levelIndex(LogLevel::value level){return static_cast<size_t>(level);}
+
+    //记录被丢弃的n条某个等级的日志，调用者需要持有mtx_
+    void countDrop(LogLevel::value level,uint64_t n=1)
     {
-        stop();
-        if(thread_&&thread_->joinable())
+        if(n==0) return;
+        dropped_[levelIndex(level)].fetch_add(n,std::memory_order_relaxed);
+        unreported_[levelIndex(level)]+=n;
+        dropping_=true;
+    }
+
+    //counts不为空时是被丢弃的一批数据中每个等级的条数，否则只丢弃了一条level等级的日志
+    void countDrop(LogLevel::value level,const DropCounts* counts)
+    {
+        if(counts==nullptr) return countDrop(level);
+        for(size_t i=0;i<counts->size();++i) countDrop(static_cast<LogLevel::value>(i),(*counts)[i]);
+    }
+
+    /* EVICT_LOW策略下从最早的记录开始丢弃DEBUG/INFO日志，直到腾出need字节，
+    低等级的日志不够时不丢弃任何日志并返回false，调用者需要持有mtx_ */
+    bool evictLow(size_t need)
+    {
+        size_t freed=0;
+        std::vector<bool>evict(records_.size(),false);
+        for(size_t i=0;i<records_.size()&&freed<need;++i)
         {
-            thread_->join();
+            if(records_[i].level_<=LogLevel::value::INFO)
+            {
+                evict[i]=true;
+                freed+=records_[i].len_;
+            }
+        }
+        if(freed<need) return false;
+
+        //把保留下来的记录按顺序重新写入生产者缓冲区
+        std::string kept;
+        kept.reserve(productor_buffer_.readableBytes()-freed);
+        std::deque<RecordInfo>records;
+        const char* base=productor_buffer_.peek();
+        for(size_t i=0;i<records_.size();++i)
+        {
+            RecordInfo& info=records_[i];
+            if(evict[i])
+            {
+                countDrop(LogLevel::value::DEBUG,info.debug_count_);
+                countDrop(LogLevel::value::INFO,info.info_count_);
+                continue;
+            }
+            records.push_back(info);
+            records.back().offset_=kept.size();
+            kept.append(base+info.offset_,info.len_);
         }
+        productor_buffer_.reset();
+        productor_buffer_.push(kept.data(),kept.size());
+        records_.swap(records);
+        return true;
     }
 
-    //线程安全
-    bool push(const char* data,size_t len)
+    //LIMIT_SIZE模式下判断是否接受一条len字节、等级为level的日志，调用者需要持有mtx_
+    bool admit(std::unique_lock<std::mutex>& lock,size_t len,LogLevel::value level)
+    {
+        if(len>max_buffer_bytes_) return false;
+        auto fits=[this,len](size_t limit){return productorBytes()+len<=limit;};
+
+        switch (overflow_policy_)
+        {
+        case OverflowPolicy::BLOCK:
+        {
+            if(fits(max_buffer_bytes_)) return true;
+            //后台线程回收暂存区或者汇报丢弃时也会写入，它自己等待只会等到超时，直接按REJECT处理
+            if(std::this_thread::get_id()==consumer_id_) return false;
+            //有生产者等待时needSwap为true，消费者会立即交换缓冲区
+            ++blocked_;
+            cond_consumer_.notify_one();
+            cond_productor_.wait_for(lock,block_timeout_,[&fits,this](){
+                return !started||fits(max_buffer_bytes_);
+            });
+            --blocked_;
+            return fits(max_buffer_bytes_);
+        }
+        case OverflowPolicy::DROP_LOW:
+        {
+            if(level==LogLevel::value::DEBUG) return fits(max_buffer_bytes_/2);
+            if(level==LogLevel::value::INFO) return fits(max_buffer_bytes_/4*3);
+            return fits(max_buffer_bytes_);
+        }
+        case OverflowPolicy::EVICT_LOW:
+        {
+            if(fits(max_buffer_bytes_)) return true;
+            if(level<=LogLevel::value::INFO||productor_chunks_) return false;
+            return evictLow(productorBytes()+len-max_buffer_bytes_);
+        }
+        default:
+            return fits(max_buffer_bytes_);
+        }
+    }
+
+    //处理消费者缓冲区中的数据，不持有mtx_
+    void consume()
+    {
+        if(!productor_chunks_)
+        {
+            functor_(consumer_buffer_);
+            consumer_buffer_.reset();
+            return;
+        }
+
+        if(chunk_functor_)
+        {
+            chunk_functor_(*consumer_chunks_);
+        }
+        else
+        {
+            consumer_chunks_->appendTo(consumer_buffer_);
+            functor_(consumer_buffer_);
+            consumer_buffer_.reset();
+        }
+        consumer_chunks_->reset();
+        //后台线程至少每max_latency_执行一次，空闲时也会释放块池中长时间没有使用的块
+        ChunkPool::getInstance().trim();
+    }
+
+    //functor进行一次刷盘应该将缓冲区的数据全部刷入磁盘
+    void ThreadEntry()
+    {
+       auto last_flush=std::chrono::steady_clock::now();
+       bool final_report=false;    //停止之后只汇报一次，避免汇报的日志本身被丢弃时反复汇报
+       {
+            std::lock_guard<std::mutex>lock(mtx_);
+            consumer_id_=std::this_thread::get_id();
+       }
+       while(1)
+       {
+            {
+                std::unique_lock<std::mutex>lock(mtx_);
+                waitForFlush(lock);
+            }
+
+            //回收外部暂存的数据，回收时会调用pushStaged，所以不能持有锁
+            if(collector_) collector_();
+
+            std::unique_lock<std::mutex>lock(mtx_);
+            //如果停止同时缓冲区中无数据(并且丢弃条数已经汇报)的话，退出
+            bool pending=drop_reporter_&&unreported_!=DropCounts{}&&!final_report;
+            if(!started&&ring_writers_.load()==0&&isAllEmpty()&&!pending&&sync_requested_==sync_covered_) break;
+
+            //写满的缓冲区比生产者缓冲区中的数据更早，先处理
+            std::vector<std::unique_ptr<Buffer>>full;
+            full.swap(full_buffers_);
+            swapBuffers();
+            //在这之前登记的sync请求的数据都在这次交换出来的缓冲区中
+            uint64_t sync_target= sync_requested_>sync_covered_ ? sync_requested_ : 0;
+            sync_covered_=sync_requested_;
+
+            //上一次交换之后没有再发生丢弃，说明压力已经消退，汇报累计的丢弃条数，停止时不再等待
+            DropCounts report{};
+            bool need_report=false;
+            if(dropping_&&started)
+            {
+                dropping_=false;
+            }
+            else if(pending)
+            {
+                report=unreported_;
+                unreported_=DropCounts{};
+                dropping_=false;
+                need_report=true;
+                if(!started) final_report=true;
+            }
+            lock.unlock();
+            if(overflow_policy_==OverflowPolicy::BLOCK) cond_productor_.notify_all();
+            if(need_report) drop_reporter_(report);
+
+            size_t bytes=consumerBytes();
+            auto sink_begin=std::chrono::steady_clock::now();
+            for(auto& buf:full)
+            {
+                bytes+=buf->readableBytes();
+                functor_(*buf);
+                buf->reset();
+            }
+            consume();
+            if(sync_target>0&&sync_functor_) sync_functor_();
+            auto now=std::chrono::steady_clock::now();
+
+            if(!full.empty()||scheduler_||sync_target>0)
+            {
+                lock.lock();
+                for(auto& buf:full) free_buffers_.push_back(std::move(buf));
+                if(scheduler_)
+                {
+                    scheduler_->record(bytes,now-last_flush,now-sink_begin);
+                    swap_threshold_=scheduler_->threshold();
+                }
+                if(sync_target>0)
+                {
+                    sync_done_=sync_target;
+                    cond_sync_.notify_all();
+                }
+            }
+            last_flush=now;
+       }
+    }
+
+    /* force为true时即使已经stop也接受数据
+    counts不为空时data是一批数据，counts为其中每个等级的条数，level为其中最高的等级 */
+    bool doPush(const char* data,size_t len,LogLevel::value level,bool force,const DropCounts* counts=nullptr)
     {
         if(data==nullptr) return false;
         bool need_notify=false;
+
+        //无锁快路径，只有环形缓冲区已满或者存在溢出数据时才加锁
+        if(ring_&&!overflow_.load(std::memory_order_acquire))
+        {
+            /* 先登记再检查started，后台线程在started为false并且没有登记的生产者时才退出，
+            所以检查通过的生产者写入的数据一定会在退出之前被取出 */
+            ring_writers_.fetch_add(1);
+            if(!started&&!force)
+            {
+                ring_writers_.fetch_sub(1);
+                return false;
+            }
+            //自适应刷新模式下第一条数据需要唤醒消费者开始计时
+            bool was_empty=scheduler_&&ring_->isEmpty();
+            bool pushed=ring_->tryPush(data,len);
+            ring_writers_.fetch_sub(1);
+            if(pushed)
+            {
+                if(was_empty||ring_->usedBytes()>ring_->capacity()*swap_factor) cond_consumer_.notify_one();
+                return true;
+            }
+        }
+
          {
-            std::lock_guard<std::mutex>lock(mtx_);
-            if(!started) return false;
+            std::unique_lock<std::mutex>lock(mtx_);
+            lock_count_.fetch_add(1,std::memory_order_relaxed);
+            if(!started&&!force) return false;
+
+            //队列模式下先换上空闲缓冲区，避免扩容或者拒绝
+            if(!free_buffers_.empty()&&rotateBuffer(len))
+            {
+                need_notify=true;
+            }
+            //自适应刷新模式下第一条数据需要唤醒消费者开始计时
+            if(scheduler_&&productorBytes()==0)
+            {
+                need_notify=true;
+            }
 
             if(buffer_policy_==BufferPolicy::LIMIT_SIZE)
             {
-                if(productor_buffer_.readableBytes()+len>max_buffer_bytes_)
+                if(!admit(lock,len,level))
                 {
+                    countDrop(level,counts);
                     return false;
                 }   
             }
             //写入日志
-            productor_buffer_.push(data,len);
+            if(productor_chunks_)
+            {
+                //块池达到内存上限，和其它拒绝的情况一样按等级计入丢弃条数
+                if(!productor_chunks_->push(data,len))
+                {
+                    countDrop(level,counts);
+                    return false;
+                }
+            }
+            else
+            {
+                if(overflow_policy_==OverflowPolicy::EVICT_LOW)
+                {
+                    RecordInfo info{productor_buffer_.readableBytes(),len,level,0,0};
+                    if(counts)
+                    {
+                        info.debug_count_=static_cast<uint32_t>((*counts)[levelIndex(LogLevel::value::DEBUG)]);
+                        info.info_count_=static_cast<uint32_t>((*counts)[levelIndex(LogLevel::value::INFO)]);
+                    }
+                    else if(level==LogLevel::value::DEBUG) info.debug_count_=1;
+                    else if(level==LogLevel::value::INFO) info.info_count_=1;
+                    records_.push_back(info);
+                }
+                productor_buffer_.push(data,len);
+            }
+            //写入成功之后才标记溢出，之后的生产者也走加锁的路径，保证顺序
+            if(ring_)
+            {
+                overflow_.store(true,std::memory_order_release);
+                need_notify=true;
+            }
 
             //检查是否需要消费者消费
             if(needSwap())
@@ -119,6 +530,130 @@ public:
         if(need_notify) cond_consumer_.notify_one();
         return true;
     }
+    
+public:
+    /* config_data.chunk_size_大于0时使用分段缓冲区链，扩容时追加块而不是拷贝整个缓冲区，
+    chunk_functor不为空时直接处理块链(例如以iovec的形式写入)，否则拷贝为连续的Buffer交给functor */
+    AsyncWorker(const Util::JsonUtil::JsonData&config_data,Functor functor,
+        BufferPolicy buffer_policy=BufferPolicy::UNLIMITED,size_t max_buffer_bytes=16*1024,
+        ChunkFunctor chunk_functor=nullptr)
+        :buffer_policy_(buffer_policy)
+        ,max_buffer_bytes_(max_buffer_bytes)
+        ,functor_(std::move(functor))
+        ,productor_buffer_(contiguousConfig(config_data))
+        ,consumer_buffer_(contiguousConfig(config_data))
+        ,started(false)
+        ,overflow_(false)
+        ,ring_writers_(0)
+        ,lock_count_(0)
+        ,chunk_functor_(std::move(chunk_functor))
+        ,chunk_swap_bytes_(config_data.buffer_size_*swap_factor)
+        ,max_latency_(config_data.flush_max_latency_ms_)
+        ,swap_threshold_(0)
+        ,overflow_policy_(OverflowPolicy::REJECT)
+        ,block_timeout_(config_data.overflow_block_ms_)
+        ,blocked_(0)
+        ,dropped_{}
+        ,unreported_{}
+        ,dropping_(false)
+        ,sync_requested_(0)
+        ,sync_covered_(0)
+        ,sync_done_(0)
+    {
+        if(!overflowPolicyFromString(config_data.overflow_policy_,overflow_policy_))
+        {
+            overflow_policy_=OverflowPolicy::REJECT;
+        }
+        if(config_data.adaptive_flush_)
+        {
+            size_t max_batch=config_data.flush_max_batch_bytes_ ? config_data.flush_max_batch_bytes_ : config_data.buffer_size_;
+            scheduler_=std::make_unique<FlushScheduler>(max_latency_,max_batch);
+            swap_threshold_=scheduler_->threshold();
+        }
+        if(config_data.chunk_size_>0)
+        {
+            ChunkPool::getInstance().limit(config_data.pool_max_bytes_,
+                std::chrono::milliseconds(config_data.pool_idle_ms_));
+            productor_chunks_=std::make_unique<ChunkBuffer>(config_data);
+            consumer_chunks_=std::make_unique<ChunkBuffer>(config_data);
+        }
+        else if(buffer_policy_!=BufferPolicy::LOCK_FREE)
+        {
+            //除了生产者和消费者缓冲区之外，预先分配buffer_count-2个空闲缓冲区
+            for(size_t i=2;i<config_data.buffer_count_;++i)
+            {
+                free_buffers_.push_back(std::make_unique<Buffer>(config_data));
+            }
+        }
+        if(buffer_policy_==BufferPolicy::LOCK_FREE)
+        {
+            ring_=std::make_unique<MpscRingBuffer>(config_data.buffer_size_);
+        }
+    }
+    ~AsyncWorker()
+    {
+        stop();
+        join();
+    }
+
+    //线程安全，level用于缓冲区满时按等级丢弃
+    bool push(const char* data,size_t len,LogLevel::value level=LogLevel::value::INFO)
+    {
+        return doPush(data,len,level,false);
+    }
+
+    //提交一条外部暂存的数据，stop之后仍然接受，保证后台线程退出前回收的数据不会丢失
+    bool pushStaged(const char* data,size_t len,LogLevel::value level=LogLevel::value::INFO)
+    {
+        return doPush(data,len,level,true);
+    }
+
+    /* 提交外部暂存的一批数据，counts为这批数据中每个等级的条数
+    缓冲区满时按其中最高的等级决定是否接受，被拒绝或者被挤出时按等级分别计入丢弃条数 */
+    bool pushStaged(const char* data,size_t len,const std::array<uint64_t,5>& counts)
+    {
+        LogLevel::value level=LogLevel::value::DEBUG;
+        for(size_t i=0;i<counts.size();++i)
+        {
+            if(counts[i]>0) level=static_cast<LogLevel::value>(i);
+        }
+        return doPush(data,len,level,true,&counts);
+    }
+
+    //设置汇报丢弃条数的函数，由后台线程在压力消退之后调用，需要在start之前调用
+    void setDropReporter(DropReporter reporter){drop_reporter_=std::move(reporter);}
+
+    //累计被丢弃的某个等级的日志条数
+    inline uint64_t droppedCount(LogLevel::value level)const
+    {
+        return dropped_[levelIndex(level)].load(std::memory_order_relaxed);
+    }
+
+    //设置回收外部暂存数据的函数，需要在start之前调用
+    void setCollector(Collector collector){collector_=std::move(collector);}
+
+    //设置落盘函数，由后台线程在处理sync请求时调用，需要在start之前调用
+    void setSyncFunctor(SyncFunctor functor){sync_functor_=std::move(functor);}
+
+    /* 让后台线程立即交换缓冲区，把之前写入的数据全部刷新并落盘，阻塞直到完成或者超时
+    多个线程同时调用时共享同一次落盘，已经stop或者超时返回false */
+    bool sync(std::chrono::milliseconds timeout=std::chrono::milliseconds::max())
+    {
+        std::unique_lock<std::mutex>lock(mtx_);
+        if(!started) return false;
+        uint64_t ticket=++sync_requested_;
+        cond_consumer_.notify_one();
+
+        auto done=[this,ticket](){return sync_done_>=ticket;};
+        if(timeout==std::chrono::milliseconds::max())
+        {
+            cond_sync_.wait(lock,done);
+            return true;
+        }
+        return cond_sync_.wait_for(lock,timeout,done);
+    }
+
+    inline size_t lockCount()const {return lock_count_.load(std::memory_order_relaxed);}
 
     void start()
     {
@@ -130,6 +665,16 @@ public:
     {
         started.store(false);
         cond_consumer_.notify_all();
+        cond_productor_.notify_all();
+    }
+
+    //等待后台线程处理完剩余的数据并退出，需要先调用stop
+    void join()
+    {
+        if(thread_&&thread_->joinable())
+        {
+            thread_->join();
+        }
     }
 };
 
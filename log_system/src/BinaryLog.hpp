@@ -0,0 +1,671 @@
+#pragma once
+
+#include <pthread.h>
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <cerrno>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Level.hpp"
+#include "Format.hpp"
+#include "Util.hpp"
+
+namespace asynclog
+{
+
+class SuppressedCounter;
+
+/* 一条日志语句的静态信息，由宏在第一次执行时构造并注册，二进制记录中只保存它的id
+之后每次执行直接引用这里的文件名和格式串，不再构造字符串 */
+struct CallSite
+{
+    CallSite(LogLevel::value level,const char* file,size_t line,const char* format);
+
+    //运行时开关，关闭之后和等级不够时一样不求值参数
+    inline bool enabled()const {return enabled_.load(std::memory_order_relaxed);}
+    inline void setEnabled(bool enabled)const {enabled_.store(enabled,std::memory_order_relaxed);}
+
+    LogLevel::value level_;
+    const char* file_;
+    size_t line_;
+    const char* format_;
+    uint32_t id_;       //为0说明注册失败，记录中会内联保存这些信息
+    mutable std::atomic_bool enabled_;  //不属于调用点的静态信息，const的调用点也可以修改
+};
+
+//全局的调用点表，id从1开始分配，注册之后不会删除
+class CallSiteRegistry
+{
+private:
+    static constexpr size_t kChunkSize=1024;
+    static constexpr size_t kMaxChunks=1024;
+
+    std::mutex mtx_;
+    uint32_t count_;
+    //按块分配，已经分配的块不会移动，读取时不需要加锁
+    std::unique_ptr<const CallSite*[]>chunks_[kMaxChunks];
+    //被限流过的调用点和它的限流器，由日志器的后台线程定期输出被限流的条数
+    std::vector<std::pair<const CallSite*,SuppressedCounter*>>limited_;
+
+    CallSiteRegistry():count_(0){}
+public:
+    CallSiteRegistry(const CallSiteRegistry&)=delete;
+    CallSiteRegistry& operator=(const CallSiteRegistry&)=delete;
+
+    static CallSiteRegistry& getInstance()
+    {
+        static CallSiteRegistry instance;
+        return instance;
+    }
+
+    uint32_t add(const CallSite* site)
+    {
+        std::lock_guard<std::mutex>lock(mtx_);
+        size_t idx=count_;
+        if(idx>=kChunkSize*kMaxChunks) return 0;
+        auto& chunk=chunks_[idx/kChunkSize];
+        if(!chunk) chunk=std::make_unique<const CallSite*[]>(kChunkSize);
+        chunk[idx%kChunkSize]=site;
+        ++count_;
+        return idx+1;
+    }
+
+    //已经注册的调用点个数，id的范围是[1,size()]
+    uint32_t size()
+    {
+        std::lock_guard<std::mutex>lock(mtx_);
+        return count_;
+    }
+
+    /* 打开或者关闭文件名以file结尾(__FILE__可能是完整路径)、行号为line的调用点，line为0时匹配文件中所有的调用点
+    只影响已经执行过的调用点，返回修改的个数 */
+    size_t setEnabled(std::string_view file,size_t line,bool enabled)
+    {
+        std::lock_guard<std::mutex>lock(mtx_);
+        size_t n=0;
+        for(size_t idx=0;idx<count_;++idx)
+        {
+            const CallSite* site=chunks_[idx/kChunkSize][idx%kChunkSize];
+            std::string_view site_file(site->file_);
+            if(line!=0&&site->line_!=line) continue;
+            if(site_file.size()<file.size()||site_file.compare(site_file.size()-file.size(),file.size(),file)!=0) continue;
+            site->setEnabled(enabled);
+            ++n;
+        }
+        return n;
+    }
+
+    //调用点第一次被限流时登记，限流器和调用点一样是静态变量，登记之后不会删除
+    void addLimited(const CallSite* site,SuppressedCounter* counter)
+    {
+        std::lock_guard<std::mutex>lock(mtx_);
+        limited_.emplace_back(site,counter);
+    }
+
+    //持有锁调用fn(site,counter)，fn中不能再调用注册表
+    template<typename F>
+    void forEachLimited(F&& fn)
+    {
+        std::lock_guard<std::mutex>lock(mtx_);
+        for(auto& [site,counter]:limited_) fn(site,counter);
+    }
+
+    /* 记录是在注册之后写入缓冲区的，消费者通过缓冲区的同步已经能看到注册的结果，
+    所以这里不需要加锁 */
+    const CallSite* get(uint32_t id)const
+    {
+        if(id==0||id>kChunkSize*kMaxChunks) return nullptr;
+        size_t idx=id-1;
+        auto& chunk=chunks_[idx/kChunkSize];
+        if(!chunk) return nullptr;
+        return chunk[idx%kChunkSize];
+    }
+};
+
+inline CallSite::CallSite(LogLevel::value level,const char* file,size_t line,const char* format)
+    :level_(level)
+    ,file_(file)
+    ,line_(line)
+    ,format_(format)
+    ,id_(0)
+    ,enabled_(true)
+{
+    id_=CallSiteRegistry::getInstance().add(this);
+}
+
+namespace Binary
+{
+
+/* 二进制记录的格式:
+[RecordHeader][内联的调用点信息(仅site_id_为0时)][参数...]
+内联的调用点信息: uint8 level, uint32 line, uint16 file_len, file, uint16 fmt_len, fmt
+参数按照格式串中转换说明的顺序保存，整数8字节，浮点数8字节(long double为sizeof(long double))，
+字符串为uint32长度加内容，'*'指定的宽度和精度为int32 */
+struct RecordHeader
+{
+    uint32_t len_;          //整条记录的长度
+    uint32_t site_id_;
+    int64_t time_;          //纳秒级的墙上时间，精度由编码时的TimePrecision决定
+    uint64_t tid_;
+};
+
+enum class ArgKind
+{
+    NONE,           //%%
+    INT,
+    UINT,
+    DOUBLE,
+    LONG_DOUBLE,
+    STRING,
+    POINTER,
+    RENDERED,       //不支持延迟格式化的转换(%ls %lc %m)，在调用线程渲染后按字符串保存
+    SKIP            //%n
+};
+
+enum class LengthMod
+{
+    NONE,HH,H,L,LL,Z,J,T,BIG_L
+};
+
+//一个转换说明，例如 %-08.3lld
+struct FormatSpec
+{
+    const char* flags_begin_;
+    const char* flags_end_;
+    int width_;             //-1表示没有指定
+    bool width_star_;
+    int precision_;         //-1表示没有指定
+    bool precision_star_;
+    LengthMod length_;
+    char conv_;
+    ArgKind kind_;
+};
+
+//p指向'%'，解析成功返回转换说明之后的位置，失败返回nullptr
+inline const char* parseSpec(const char* p,FormatSpec& spec)
+{
+    ++p;
+    spec.flags_begin_=p;
+    while(*p=='-'||*p=='+'||*p==' '||*p=='#'||*p=='0'||*p=='\'') ++p;
+    spec.flags_end_=p;
+
+    spec.width_=-1;
+    spec.width_star_=false;
+    if(*p=='*')
+    {
+        spec.width_star_=true;
+        ++p;
+    }
+    else if(*p>='0'&&*p<='9')
+    {
+        spec.width_=0;
+        while(*p>='0'&&*p<='9') spec.width_=spec.width_*10+(*p++-'0');
+    }
+
+    spec.precision_=-1;
+    spec.precision_star_=false;
+    if(*p=='.')
+    {
+        ++p;
+        if(*p=='*')
+        {
+            spec.precision_star_=true;
+            ++p;
+        }
+        else
+        {
+            spec.precision_=0;
+            while(*p>='0'&&*p<='9') spec.precision_=spec.precision_*10+(*p++-'0');
+        }
+    }
+
+    spec.length_=LengthMod::NONE;
+    switch(*p)
+    {
+    case 'h':
+        if(p[1]=='h'){spec.length_=LengthMod::HH;p+=2;}
+        else{spec.length_=LengthMod::H;++p;}
+        break;
+    case 'l':
+        if(p[1]=='l'){spec.length_=LengthMod::LL;p+=2;}
+        else{spec.length_=LengthMod::L;++p;}
+        break;
+    case 'q': spec.length_=LengthMod::LL;++p;break;
+    case 'z': spec.length_=LengthMod::Z;++p;break;
+    case 'j': spec.length_=LengthMod::J;++p;break;
+    case 't': spec.length_=LengthMod::T;++p;break;
+    case 'L': spec.length_=LengthMod::BIG_L;++p;break;
+    default: break;
+    }
+
+    spec.conv_=*p;
+    switch(*p)
+    {
+    case '%': spec.kind_=ArgKind::NONE;break;
+    case 'd': case 'i': spec.kind_=ArgKind::INT;break;
+    case 'u': case 'o': case 'x': case 'X': spec.kind_=ArgKind::UINT;break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        spec.kind_= spec.length_==LengthMod::BIG_L ? ArgKind::LONG_DOUBLE : ArgKind::DOUBLE;
+        break;
+    case 'c': spec.kind_= spec.length_==LengthMod::L ? ArgKind::RENDERED : ArgKind::INT;break;
+    case 's': spec.kind_= spec.length_==LengthMod::L ? ArgKind::RENDERED : ArgKind::STRING;break;
+    case 'p': spec.kind_=ArgKind::POINTER;break;
+    case 'm': spec.kind_=ArgKind::RENDERED;break;
+    case 'n': spec.kind_=ArgKind::SKIP;break;
+    default: return nullptr;
+    }
+    return p+1;
+}
+
+//把转换说明重新拼成printf可用的格式串，'*'替换为具体的数值
+inline void buildSpec(char* out,size_t size,const FormatSpec& spec,int width,int precision)
+{
+    static const char* kLength[]={"","hh","h","l","ll","z","j","t","L"};
+    std::string flags(spec.flags_begin_,spec.flags_end_);
+    char w[16]={0};
+    char pr[16]={0};
+    if(width>=0||spec.width_star_) snprintf(w,sizeof(w),"%d",width);
+    if(precision>=0) snprintf(pr,sizeof(pr),".%d",precision);
+    snprintf(out,size,"%%%s%s%s%s%c",flags.c_str(),w,pr,kLength[static_cast<int>(spec.length_)],spec.conv_);
+}
+
+template<typename T>
+inline void appendPod(std::string& out,const T& value)
+{
+    out.append(reinterpret_cast<const char*>(&value),sizeof(T));
+}
+
+template<typename T>
+inline bool readPod(const char*& p,const char* end,T& value)
+{
+    if(end-p<static_cast<ptrdiff_t>(sizeof(T))) return false;
+    std::memcpy(&value,p,sizeof(T));
+    p+=sizeof(T);
+    return true;
+}
+
+inline void appendString(std::string& out,const char* s,size_t len)
+{
+    appendPod(out,static_cast<uint32_t>(len));
+    out.append(s,len);
+}
+
+//按照格式串的长度修饰符取出整数参数
+inline int64_t fetchInt(LengthMod length,va_list& ap)
+{
+    switch(length)
+    {
+    case LengthMod::L: return va_arg(ap,long);
+    case LengthMod::LL: return va_arg(ap,long long);
+    case LengthMod::Z: return va_arg(ap,ssize_t);
+    case LengthMod::J: return va_arg(ap,intmax_t);
+    case LengthMod::T: return va_arg(ap,ptrdiff_t);
+    default: return va_arg(ap,int);
+    }
+}
+
+inline uint64_t fetchUInt(LengthMod length,va_list& ap)
+{
+    switch(length)
+    {
+    case LengthMod::L: return va_arg(ap,unsigned long);
+    case LengthMod::LL: return va_arg(ap,unsigned long long);
+    case LengthMod::Z: return va_arg(ap,size_t);
+    case LengthMod::J: return va_arg(ap,uintmax_t);
+    case LengthMod::T: return va_arg(ap,ptrdiff_t);
+    default: return va_arg(ap,unsigned int);
+    }
+}
+
+inline uint64_t currentTid()
+{
+    return static_cast<uint64_t>(pthread_self());
+}
+
+/* 在调用线程把一条日志编码为二进制记录追加到out中，只拷贝参数，不做格式化
+site为nullptr或者没有注册成功时，把等级、文件名、行号和格式串内联到记录中 */
+inline void encode(std::string& out,const CallSite* site,LogLevel::value level,
+    const char* file,size_t line,const char* format,va_list ap,TimePrecision precision=TimePrecision::SECOND)
+{
+    size_t begin=out.size();
+    RecordHeader header;
+    header.len_=0;
+    header.site_id_= site ? site->id_ : 0;
+    Timestamp ts=Clock::now(precision);
+    header.time_=int64_t(ts.sec_)*1000000000LL+ts.nsec_;
+    header.tid_=currentTid();
+    appendPod(out,header);
+
+    if(header.site_id_==0)
+    {
+        if(site)
+        {
+            level=site->level_;
+            file=site->file_;
+            line=site->line_;
+            format=site->format_;
+        }
+        uint16_t file_len=static_cast<uint16_t>(std::min<size_t>(strlen(file),UINT16_MAX));
+        uint16_t fmt_len=static_cast<uint16_t>(std::min<size_t>(strlen(format),UINT16_MAX));
+        appendPod(out,static_cast<uint8_t>(level));
+        appendPod(out,static_cast<uint32_t>(line));
+        appendPod(out,file_len);
+        out.append(file,file_len);
+        appendPod(out,fmt_len);
+        out.append(format,fmt_len);
+    }
+    else
+    {
+        format=site->format_;
+    }
+
+    va_list args;
+    va_copy(args,ap);
+    int saved_errno=errno;
+    FormatSpec spec;
+    for(const char* p=format;*p;)
+    {
+        if(*p!='%')
+        {
+            ++p;
+            continue;
+        }
+        const char* next=parseSpec(p,spec);
+        //无法识别的转换说明，之后的内容按原样输出，不再读取参数
+        if(next==nullptr) break;
+        p=next;
+
+        int width=spec.width_;
+        int precision=spec.precision_;
+        if(spec.width_star_)
+        {
+            width=va_arg(args,int);
+            appendPod(out,static_cast<int32_t>(width));
+        }
+        if(spec.precision_star_)
+        {
+            precision=va_arg(args,int);
+            appendPod(out,static_cast<int32_t>(precision));
+        }
+
+        switch(spec.kind_)
+        {
+        case ArgKind::NONE:
+            break;
+        case ArgKind::INT:
+            appendPod(out,fetchInt(spec.length_,args));
+            break;
+        case ArgKind::UINT:
+            appendPod(out,fetchUInt(spec.length_,args));
+            break;
+        case ArgKind::DOUBLE:
+            appendPod(out,va_arg(args,double));
+            break;
+        case ArgKind::LONG_DOUBLE:
+            appendPod(out,va_arg(args,long double));
+            break;
+        case ArgKind::POINTER:
+            appendPod(out,reinterpret_cast<uint64_t>(va_arg(args,void*)));
+            break;
+        case ArgKind::STRING:
+        {
+            const char* s=va_arg(args,const char*);
+            if(s==nullptr) s="(null)";
+            size_t len= precision>=0 ? strnlen(s,precision) : strlen(s);
+            appendString(out,s,len);
+            break;
+        }
+        case ArgKind::RENDERED:
+        {
+            char spec_buf[64];
+            char buf[512];
+            buildSpec(spec_buf,sizeof(spec_buf),spec,width,precision);
+            int n;
+            errno=saved_errno;
+            if(spec.conv_=='m') n=snprintf(buf,sizeof(buf),spec_buf,0);
+            else if(spec.conv_=='c') n=snprintf(buf,sizeof(buf),spec_buf,va_arg(args,wint_t));
+            else n=snprintf(buf,sizeof(buf),spec_buf,va_arg(args,const wchar_t*));
+            appendString(out,buf,n<0 ? 0 : std::min<size_t>(n,sizeof(buf)-1));
+            break;
+        }
+        case ArgKind::SKIP:
+            va_arg(args,void*);
+            break;
+        }
+    }
+    va_end(args);
+
+    uint32_t len=static_cast<uint32_t>(out.size()-begin);
+    std::memcpy(&out[begin],&len,sizeof(len));
+}
+
+//渲染一个转换说明，参数从p中读取
+inline bool renderSpec(std::string& out,const FormatSpec& spec,const char*& p,const char* end)
+{
+    int32_t width=spec.width_;
+    int32_t precision=spec.precision_;
+    if(spec.width_star_&&!readPod(p,end,width)) return false;
+    if(spec.precision_star_&&!readPod(p,end,precision)) return false;
+
+    char spec_buf[64];
+    char buf[512];
+    int n=0;
+    switch(spec.kind_)
+    {
+    case ArgKind::NONE:
+        out.push_back('%');
+        return true;
+    case ArgKind::SKIP:
+        return true;
+    case ArgKind::STRING:
+    case ArgKind::RENDERED:
+    {
+        uint32_t len;
+        if(!readPod(p,end,len)||end-p<static_cast<ptrdiff_t>(len)) return false;
+        //字符串以保存的长度作为精度输出，这样不需要结尾的'\0'
+        FormatSpec str_spec=spec;
+        str_spec.length_=LengthMod::NONE;
+        str_spec.conv_='s';
+        buildSpec(spec_buf,sizeof(spec_buf),str_spec,width,static_cast<int>(len));
+        n=snprintf(buf,sizeof(buf),spec_buf,p);
+        if(n>=static_cast<int>(sizeof(buf)))
+        {
+            std::string large(n+1,'\0');
+            snprintf(large.data(),large.size(),spec_buf,p);
+            out.append(large.data(),n);
+            p+=len;
+            return true;
+        }
+        p+=len;
+        break;
+    }
+    case ArgKind::INT:
+    {
+        int64_t v;
+        if(!readPod(p,end,v)) return false;
+        buildSpec(spec_buf,sizeof(spec_buf),spec,width,precision);
+        switch(spec.length_)
+        {
+        case LengthMod::L: n=snprintf(buf,sizeof(buf),spec_buf,static_cast<long>(v));break;
+        case LengthMod::LL: n=snprintf(buf,sizeof(buf),spec_buf,static_cast<long long>(v));break;
+        case LengthMod::Z: n=snprintf(buf,sizeof(buf),spec_buf,static_cast<ssize_t>(v));break;
+        case LengthMod::J: n=snprintf(buf,sizeof(buf),spec_buf,static_cast<intmax_t>(v));break;
+        case LengthMod::T: n=snprintf(buf,sizeof(buf),spec_buf,static_cast<ptrdiff_t>(v));break;
+        default: n=snprintf(buf,sizeof(buf),spec_buf,static_cast<int>(v));break;
+        }
+        break;
+    }
+    case ArgKind::UINT:
+    {
+        uint64_t v;
+        if(!readPod(p,end,v)) return false;
+        buildSpec(spec_buf,sizeof(spec_buf),spec,width,precision);
+        switch(spec.length_)
+        {
+        case LengthMod::L: n=snprintf(buf,sizeof(buf),spec_buf,static_cast<unsigned long>(v));break;
+        case LengthMod::LL: n=snprintf(buf,sizeof(buf),spec_buf,static_cast<unsigned long long>(v));break;
+        case LengthMod::Z: n=snprintf(buf,sizeof(buf),spec_buf,static_cast<size_t>(v));break;
+        case LengthMod::J: n=snprintf(buf,sizeof(buf),spec_buf,static_cast<uintmax_t>(v));break;
+        case LengthMod::T: n=snprintf(buf,sizeof(buf),spec_buf,static_cast<ptrdiff_t>(v));break;
+        default: n=snprintf(buf,sizeof(buf),spec_buf,static_cast<unsigned int>(v));break;
+        }
+        break;
+    }
+    case ArgKind::DOUBLE:
+    {
+        double v;
+        if(!readPod(p,end,v)) return false;
+        buildSpec(spec_buf,sizeof(spec_buf),spec,width,precision);
+        n=snprintf(buf,sizeof(buf),spec_buf,v);
+        break;
+    }
+    case ArgKind::LONG_DOUBLE:
+    {
+        long double v;
+        if(!readPod(p,end,v)) return false;
+        buildSpec(spec_buf,sizeof(spec_buf),spec,width,precision);
+        n=snprintf(buf,sizeof(buf),spec_buf,v);
+        break;
+    }
+    case ArgKind::POINTER:
+    {
+        uint64_t v;
+        if(!readPod(p,end,v)) return false;
+        buildSpec(spec_buf,sizeof(spec_buf),spec,width,precision);
+        n=snprintf(buf,sizeof(buf),spec_buf,reinterpret_cast<void*>(v));
+        break;
+    }
+    }
+    if(n>0) out.append(buf,std::min<size_t>(n,sizeof(buf)-1));
+    return true;
+}
+
+//读取记录的调用点信息，调用点未知或者内联的信息损坏时返回false
+inline bool readSite(const RecordHeader& header,const char*& p,const char* end,LogLevel::value& level,
+    std::string_view& file_view,uint32_t& line,std::string_view& format)
+{
+    if(header.site_id_!=0)
+    {
+        const CallSite* site=CallSiteRegistry::getInstance().get(header.site_id_);
+        if(site==nullptr) return false;
+        level=site->level_;
+        file_view=site->file_;
+        line=site->line_;
+        format=site->format_;
+        return true;
+    }
+    uint8_t lv;
+    uint16_t file_len,fmt_len;
+    if(!readPod(p,end,lv)||!readPod(p,end,line)||!readPod(p,end,file_len)||end-p<file_len) return false;
+    file_view=std::string_view(p,file_len);
+    p+=file_len;
+    if(!readPod(p,end,fmt_len)||end-p<fmt_len) return false;
+    format=std::string_view(p,fmt_len);
+    p+=fmt_len;
+    if(lv>static_cast<uint8_t>(LogLevel::value::FATAL)) return false;
+    level=static_cast<LogLevel::value>(lv);
+    return true;
+}
+
+/* 把data中的二进制记录渲染为和LogMessage::format相同格式的文本追加到out中，
+on_record在每条记录渲染完成之后调用，参数为等级和这条记录的文本
+调用点未知或者内容损坏的记录按照长度跳过，长度损坏或者不完整时无法继续，丢弃剩余的数据，
+有数据被丢弃时在最后追加一条WARN诊断日志说明丢弃的字节数
+返回解析和跳过的记录的字节数 */
+inline size_t decode(const char* data,size_t len,const std::string& logger_name,std::string& out,
+    const std::function<void(LogLevel::value,const char*,size_t)>& on_record=nullptr,
+    TimePrecision precision=TimePrecision::SECOND)
+{
+    const char* cur=data;
+    const char* data_end=data+len;
+    size_t discarded=0;
+
+    while(data_end-cur>=static_cast<ptrdiff_t>(sizeof(RecordHeader)))
+    {
+        RecordHeader header;
+        std::memcpy(&header,cur,sizeof(header));
+        if(header.len_<sizeof(header)||header.len_>static_cast<size_t>(data_end-cur)) break;
+
+        const char* p=cur+sizeof(header);
+        const char* end=cur+header.len_;
+
+        LogLevel::value level;
+        std::string_view file_view;
+        uint32_t line;
+        std::string_view format;
+        if(!readSite(header,p,end,level,file_view,line,format))
+        {
+            discarded+=header.len_;
+            cur+=header.len_;
+            continue;
+        }
+
+        size_t line_begin=out.size();
+        char tid[24];
+        auto [tid_end,ec]=std::to_chars(tid,tid+sizeof(tid),header.tid_);
+        Timestamp ts{static_cast<time_t>(header.time_/1000000000LL),static_cast<uint32_t>(header.time_%1000000000LL)};
+        Fmt::writeHeader(out,ts,precision,std::string_view(tid,tid_end-tid),
+            level,logger_name,file_view,line);
+
+        //格式串以'\0'结尾(内联的格式串需要拷贝一份)
+        std::string inline_format;
+        const char* f=format.data();
+        if(header.site_id_==0)
+        {
+            inline_format.assign(format);
+            f=inline_format.c_str();
+        }
+        FormatSpec spec;
+        const char* literal=f;
+        while(*f)
+        {
+            if(*f!='%')
+            {
+                ++f;
+                continue;
+            }
+            out.append(literal,f);
+            const char* next=parseSpec(f,spec);
+            if(next==nullptr)
+            {
+                literal=f;
+                f+=strlen(f);
+                break;
+            }
+            if(!renderSpec(out,spec,p,end)) break;
+            f=next;
+            literal=f;
+        }
+        out.append(literal,f);
+        out.push_back('\n');
+
+        if(on_record) on_record(level,out.data()+line_begin,out.size()-line_begin);
+        cur+=header.len_;
+    }
+
+    discarded+=data_end-cur;
+    if(discarded>0)
+    {
+        Fmt::writeHeader(out,Clock::now(precision),precision,Fmt::threadIdText(),LogLevel::value::WARN,
+            logger_name,__FILE__,__LINE__);
+        char msg[96];
+        int n=snprintf(msg,sizeof(msg),"binary log: %zu bytes of corrupt records discarded\n",discarded);
+        out.append(msg,std::min<size_t>(n,sizeof(msg)-1));
+    }
+    return cur-data;
+}
+
+} // namespace Binary
+
+} // namespace asynclog
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "AsyncBuffer.hpp"
+#include "ChunkPool.hpp"
+#include "Util.hpp"
+
+namespace asynclog
+{
+
+/* 由固定大小的块组成的缓冲区链
+写满一个块之后从进程共享的ChunkPool借用一个新块追加到链尾，不需要像Buffer那样移动数据或者resize拷贝整个缓冲区，
+读取时把每个块作为一个iovec交给落地方向，reset时把块归还给ChunkPool，由所有日志器复用 */
+class ChunkBuffer
+{
+private:
+    size_t chunk_size_;                         //每个块的大小
+    std::vector<std::unique_ptr<Chunk>>chunks_; //按写入顺序排列的块
+    size_t readable_;                           //所有块中已写入的字节数
+
+public:
+    static constexpr size_t kDefaultChunkSize=64*1024;
+
+    explicit ChunkBuffer(const Util::JsonUtil::JsonData& config_data)
+        :chunk_size_(config_data.chunk_size_ ? config_data.chunk_size_ : kDefaultChunkSize)
+        ,readable_(0)
+    {}
+
+    ~ChunkBuffer(){reset();}
+
+    ChunkBuffer(const ChunkBuffer&)=delete;
+    ChunkBuffer& operator=(const ChunkBuffer&)=delete;
+
+    inline size_t readableBytes()const {return readable_;}
+    inline bool isEmpty()const {return readable_==0;}
+    inline size_t chunkSize()const {return chunk_size_;}
+    inline size_t chunkCount()const {return chunks_.size();}
+
+    /* 写入数据，当前块写满时追加新块，大于一个块的数据会跨多个块
+    需要的块会先全部借到，ChunkPool达到内存上限时不写入任何数据并返回false */
+    bool push(const char* data,size_t len)
+    {
+        if(data==nullptr) return false;
+        if(len==0) return true;
+        size_t room= chunks_.empty() ? 0 : chunk_size_-chunks_.back()->used_;
+        size_t old_count=chunks_.size();
+        //从最后一个块(如果还有空间)开始写
+        size_t idx= room>0 ? old_count-1 : old_count;
+        if(len>room)
+        {
+            size_t need=(len-room+chunk_size_-1)/chunk_size_;
+            for(size_t i=0;i<need;++i)
+            {
+                auto chunk=ChunkPool::getInstance().acquire(chunk_size_);
+                if(!chunk)
+                {
+                    while(chunks_.size()>old_count)
+                    {
+                        ChunkPool::getInstance().release(std::move(chunks_.back()));
+                        chunks_.pop_back();
+                    }
+                    return false;
+                }
+                chunks_.push_back(std::move(chunk));
+            }
+        }
+
+        readable_+=len;
+        while(len>0)
+        {
+            Chunk& chunk=*chunks_[idx++];
+            size_t n=std::min(len,chunk_size_-chunk.used_);
+            std::memcpy(chunk.data_.get()+chunk.used_,data,n);
+            chunk.used_+=n;
+            data+=n;
+            len-=n;
+        }
+        return true;
+    }
+
+    //清空数据，块归还给ChunkPool
+    void reset()
+    {
+        for(auto& chunk:chunks_)
+        {
+            ChunkPool::getInstance().release(std::move(chunk));
+        }
+        chunks_.clear();
+        readable_=0;
+    }
+
+    void swap(ChunkBuffer& other)
+    {
+        chunks_.swap(other.chunks_);
+        std::swap(readable_,other.readable_);
+    }
+
+    //把other中的块按顺序移动到链尾，不拷贝数据
+    void splice(ChunkBuffer& other)
+    {
+        for(auto& chunk:other.chunks_)
+        {
+            chunks_.push_back(std::move(chunk));
+        }
+        readable_+=other.readable_;
+        other.chunks_.clear();
+        other.readable_=0;
+    }
+
+    //把每个块中的数据作为一个iovec追加到iov中，返回追加的个数
+    size_t toIovec(std::vector<struct iovec>& iov)const
+    {
+        for(auto& chunk:chunks_)
+        {
+            iov.push_back(iovec{chunk->data_.get(),chunk->used_});
+        }
+        return chunks_.size();
+    }
+
+    //把所有数据拷贝到连续的缓冲区中
+    void appendTo(Buffer& out)const
+    {
+        for(auto& chunk:chunks_)
+        {
+            out.push(chunk->data_.get(),chunk->used_);
+        }
+    }
+};
+
+} // namespace asynclog
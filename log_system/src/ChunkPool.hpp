@@ -0,0 +1,168 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace asynclog
+{
+
+//分段缓冲区中的一个块
+struct Chunk
+{
+    explicit Chunk(size_t capacity)
+        :data_(new char[capacity])  //不需要清零
+        ,capacity_(capacity)
+        ,used_(0)
+    {}
+
+    std::unique_ptr<char[]>data_;
+    size_t capacity_;
+    size_t used_;
+};
+
+/* 进程内所有日志器共享的块池
+ChunkBuffer写满一个块时从这里借用新块，刷新之后归还，空闲的块可以被其它日志器复用，
+max_bytes_限制所有块(包括正在使用的和空闲的)占用的总内存，超过时借用失败，
+空闲超过idle_time_的块在trim时释放，避免突发写入之后一直占用内存 */
+class ChunkPool
+{
+private:
+    using Clock=std::chrono::steady_clock;
+    struct FreeChunk
+    {
+        std::unique_ptr<Chunk>chunk_;
+        Clock::time_point release_time_;    //归还的时间
+    };
+
+    std::mutex mtx_;
+    //按块大小分开的空闲链表，尾部是最近归还的块，头部是空闲最久的块
+    std::unordered_map<size_t,std::deque<FreeChunk>>free_;
+    size_t max_bytes_;          //所有块占用内存的上限，为0时不限制
+    Clock::duration idle_time_; //空闲块保留的时间
+    size_t total_bytes_;        //已经分配的块占用的内存
+    size_t free_bytes_;         //空闲链表中的块占用的内存
+
+    ChunkPool()
+        :max_bytes_(0)
+        ,idle_time_(std::chrono::seconds(30))
+        ,total_bytes_(0)
+        ,free_bytes_(0)
+    {}
+
+    friend struct ChunkPoolTestAccess;
+
+    //直接覆盖之前的设置，只用于测试之间恢复全局的设置，日志器通过limit合并设置
+    void configure(size_t max_bytes,std::chrono::milliseconds idle_time)
+    {
+        std::lock_guard<std::mutex>lock(mtx_);
+        max_bytes_=max_bytes;
+        idle_time_=idle_time;
+    }
+
+public:
+    ChunkPool(const ChunkPool&)=delete;
+    ChunkPool& operator=(const ChunkPool&)=delete;
+
+    static ChunkPool& getInstance()
+    {
+        static ChunkPool instance;
+        return instance;
+    }
+
+    /* 合并一个日志器的设置，由使用分段缓冲区的日志器在创建时调用
+    内存上限取非0的最小值，空闲时间取最小值，后创建的日志器只能收紧限制，不会取消或者放宽已有的上限 */
+    void limit(size_t max_bytes,std::chrono::milliseconds idle_time)
+    {
+        std::lock_guard<std::mutex>lock(mtx_);
+        if(max_bytes>0&&(max_bytes_==0||max_bytes<max_bytes_)) max_bytes_=max_bytes;
+        if(idle_time<idle_time_) idle_time_=idle_time;
+    }
+
+    //借用一个块，超过内存上限时返回nullptr
+    std::unique_ptr<Chunk> acquire(size_t capacity)
+    {
+        {
+            std::lock_guard<std::mutex>lock(mtx_);
+            auto it=free_.find(capacity);
+            if(it!=free_.end()&&!it->second.empty())
+            {
+                auto chunk=std::move(it->second.back().chunk_);
+                it->second.pop_back();
+                free_bytes_-=capacity;
+                chunk->used_=0;
+                return chunk;
+            }
+            //只有其它大小的空闲块时，先释放它们腾出空间
+            if(max_bytes_>0&&total_bytes_+capacity>max_bytes_)
+            {
+                for(auto& [size,chunks]:free_)
+                {
+                    while(!chunks.empty()&&total_bytes_+capacity>max_bytes_)
+                    {
+                        chunks.pop_front();
+                        total_bytes_-=size;
+                        free_bytes_-=size;
+                    }
+                }
+                if(total_bytes_+capacity>max_bytes_) return nullptr;
+            }
+            total_bytes_+=capacity;
+        }
+        return std::make_unique<Chunk>(capacity);
+    }
+
+    //归还块
+    void release(std::unique_ptr<Chunk> chunk)
+    {
+        if(!chunk) return;
+        std::lock_guard<std::mutex>lock(mtx_);
+        size_t capacity=chunk->capacity_;
+        free_[capacity].push_back(FreeChunk{std::move(chunk),Clock::now()});
+        free_bytes_+=capacity;
+    }
+
+    //释放空闲超过idle_time_的块，由日志器的后台线程定期调用
+    void trim()
+    {
+        std::vector<std::unique_ptr<Chunk>>expired;
+        {
+            std::lock_guard<std::mutex>lock(mtx_);
+            auto deadline=Clock::now()-idle_time_;
+            for(auto& [size,chunks]:free_)
+            {
+                while(!chunks.empty()&&chunks.front().release_time_<=deadline)
+                {
+                    expired.push_back(std::move(chunks.front().chunk_));
+                    chunks.pop_front();
+                    total_bytes_-=size;
+                    free_bytes_-=size;
+                }
+            }
+        }
+        //在锁外释放内存
+    }
+
+    size_t totalBytes()
+    {
+        std::lock_guard<std::mutex>lock(mtx_);
+        return total_bytes_;
+    }
+
+    size_t maxBytes()
+    {
+        std::lock_guard<std::mutex>lock(mtx_);
+        return max_bytes_;
+    }
+
+    size_t freeBytes()
+    {
+        std::lock_guard<std::mutex>lock(mtx_);
+        return free_bytes_;
+    }
+};
+
+} // namespace asynclog
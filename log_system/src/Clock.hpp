@@ -0,0 +1,204 @@
+#pragma once
+
+#include <time.h>
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <chrono>
+
+#if defined(__x86_64__)||defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define ASYNCLOG_HAS_TSC 1
+#else
+#define ASYNCLOG_HAS_TSC 0
+#endif
+
+namespace asynclog
+{
+
+//日志时间戳的精度
+enum class TimePrecision
+{
+    SECOND,     //秒，使用time(nullptr)
+    MILLI,      //毫秒
+    MICRO,      //微秒
+    NANO        //纳秒
+};
+
+//时间戳: 秒和秒内的纳秒
+struct Timestamp
+{
+    time_t sec_;
+    uint32_t nsec_;
+};
+
+namespace Clock
+{
+
+//配置中的"s"/"ms"/"us"/"ns"转换为时间戳精度，无法识别时返回false
+inline bool precisionFromString(std::string_view str,TimePrecision& precision)
+{
+    if(str=="s") precision=TimePrecision::SECOND;
+    else if(str=="ms") precision=TimePrecision::MILLI;
+    else if(str=="us") precision=TimePrecision::MICRO;
+    else if(str=="ns") precision=TimePrecision::NANO;
+    else return false;
+    return true;
+}
+
+//精度对应的小数位数
+inline constexpr int fractionDigits(TimePrecision precision)
+{
+    switch (precision)
+    {
+    case TimePrecision::MILLI: return 3;
+    case TimePrecision::MICRO: return 6;
+    case TimePrecision::NANO: return 9;
+    default: return 0;
+    }
+}
+
+inline uint64_t realtimeNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME,&ts);
+    return uint64_t(ts.tv_sec)*1000000000ULL+ts.tv_nsec;
+}
+
+/* 基于TSC的高精度时钟，读取一次只需要一条rdtsc和一次乘法
+启动时用CLOCK_MONOTONIC_RAW标定每个tick对应的纳秒数，再以一对(tsc,墙上时间)作为锚点换算，
+后台线程定期调用resync重新对齐锚点，避免和系统时间(NTP调整)之间的偏差累积
+CPU不支持不变TSC(invariant TSC)或者不是x86时退化为clock_gettime */
+class TscClock
+{
+private:
+    static constexpr uint32_t kShift=32;
+    static constexpr auto kCalibrateTime=std::chrono::milliseconds(10);
+
+    bool use_tsc_;
+    uint64_t mult_;                     //每个tick对应的纳秒数左移kShift位
+    std::mutex resync_mtx_;             //保证同时只有一个线程更新锚点
+    std::atomic<uint32_t> seq_;         //顺序锁，为奇数时说明正在更新锚点
+    std::atomic<uint64_t> base_tsc_;
+    std::atomic<uint64_t> base_ns_;
+
+    static inline uint64_t readTsc()
+    {
+#if ASYNCLOG_HAS_TSC
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    static bool invariantTsc()
+    {
+#if ASYNCLOG_HAS_TSC
+        unsigned int eax,ebx,ecx,edx;
+        if(__get_cpuid(0x80000000,&eax,&ebx,&ecx,&edx)==0||eax<0x80000007) return false;
+        __get_cpuid(0x80000007,&eax,&ebx,&ecx,&edx);
+        return (edx&(1u<<8))!=0;
+#else
+        return false;
+#endif
+    }
+
+    static uint64_t monotonicNs()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_RAW,&ts);
+        return uint64_t(ts.tv_sec)*1000000000ULL+ts.tv_nsec;
+    }
+
+    TscClock()
+        :use_tsc_(invariantTsc())
+        ,mult_(0)
+        ,seq_(0)
+        ,base_tsc_(0)
+        ,base_ns_(0)
+    {
+        if(!use_tsc_) return;
+
+        uint64_t ns0=monotonicNs();
+        uint64_t tsc0=readTsc();
+        std::this_thread::sleep_for(kCalibrateTime);
+        uint64_t ns1=monotonicNs();
+        uint64_t tsc1=readTsc();
+        if(tsc1<=tsc0)
+        {
+            use_tsc_=false;
+            return;
+        }
+        mult_=static_cast<uint64_t>((static_cast<unsigned __int128>(ns1-ns0)<<kShift)/(tsc1-tsc0));
+        resync();
+    }
+
+public:
+    TscClock(const TscClock&)=delete;
+    TscClock& operator=(const TscClock&)=delete;
+
+    static TscClock& getInstance()
+    {
+        static TscClock instance;
+        return instance;
+    }
+
+    inline bool usingTsc()const {return use_tsc_;}
+
+    //当前的墙上时间(纳秒)
+    uint64_t nowNs()const
+    {
+        if(!use_tsc_) return realtimeNs();
+
+        uint64_t tsc=readTsc();
+        while(true)
+        {
+            uint32_t seq=seq_.load(std::memory_order_acquire);
+            uint64_t base_tsc=base_tsc_.load(std::memory_order_relaxed);
+            uint64_t base_ns=base_ns_.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if((seq&1)==0&&seq_.load(std::memory_order_relaxed)==seq)
+            {
+                //锚点更新之前读到的tsc可能比base_tsc小
+                if(tsc<base_tsc) return base_ns;
+                return base_ns+static_cast<uint64_t>((static_cast<unsigned __int128>(tsc-base_tsc)*mult_)>>kShift);
+            }
+        }
+    }
+
+    //重新对齐锚点，由后台线程调用，其它线程正在更新时直接返回
+    void resync()
+    {
+        if(!use_tsc_) return;
+        std::unique_lock<std::mutex>lock(resync_mtx_,std::try_to_lock);
+        if(!lock.owns_lock()) return;
+
+        uint64_t ns=realtimeNs();
+        uint64_t tsc=readTsc();
+        seq_.fetch_add(1,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        base_tsc_.store(tsc,std::memory_order_relaxed);
+        base_ns_.store(ns,std::memory_order_relaxed);
+        seq_.fetch_add(1,std::memory_order_release);
+    }
+};
+
+//按照精度获取当前时间，秒级精度保持原来time(nullptr)的行为
+inline Timestamp now(TimePrecision precision)
+{
+    if(precision==TimePrecision::SECOND)
+    {
+        return Timestamp{time(nullptr),0};
+    }
+    uint64_t ns=TscClock::getInstance().nowNs();
+    return Timestamp{static_cast<time_t>(ns/1000000000ULL),static_cast<uint32_t>(ns%1000000000ULL)};
+}
+
+} // namespace Clock
+
+} // namespace asynclog
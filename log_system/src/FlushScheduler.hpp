@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+namespace asynclog
+{
+
+/* 自适应的刷新调度，由AsyncWorker的后台线程使用
+根据观察到的写入速率和落地方向的耗时决定下一次刷新的等待时间和交换阈值:
+等待时间取落地耗时的kLatencyFactor倍，保证落地方向最多一半的时间在工作，
+流量小、落地快时很快就会刷新，落地变慢(突发写入导致批次变大)时自动拉长间隔、攒更大的批次，
+交换阈值取等待时间内预计写入的数据量，达到阈值时提前刷新，两者都不超过配置的上限 */
+class FlushScheduler
+{
+private:
+    using Duration=std::chrono::nanoseconds;
+
+    static constexpr double kAlpha=0.2;             //指数加权平均的权重
+    static constexpr double kLatencyFactor=2.0;
+    static constexpr size_t kMinBatchBytes=4096;    //交换阈值的下限，避免过于频繁的小批次
+    static constexpr Duration kMinInterval=std::chrono::milliseconds(1);
+
+    Duration max_latency_;      //日志在缓冲区中停留的最长时间
+    size_t max_batch_bytes_;    //每批数据的上限
+    double rate_;               //写入速率(字节/秒)的加权平均
+    double sink_ns_;            //每次落地耗时(纳秒)的加权平均
+    bool has_sample_;
+
+    inline double ewma(double old_value,double sample)const
+    {
+        return has_sample_ ? old_value+(sample-old_value)*kAlpha : sample;
+    }
+
+public:
+    FlushScheduler(std::chrono::milliseconds max_latency,size_t max_batch_bytes)
+        :max_latency_(max_latency)
+        ,max_batch_bytes_(std::max(max_batch_bytes,kMinBatchBytes))
+        ,rate_(0)
+        ,sink_ns_(0)
+        ,has_sample_(false)
+    {}
+
+    /* 记录一次刷新: bytes为这一批的数据量，elapsed为距离上一次刷新的时间，sink_time为落地耗时
+    空的批次只说明当前没有流量，速率按照0衰减，不更新落地耗时 */
+    void record(size_t bytes,Duration elapsed,Duration sink_time)
+    {
+        double seconds=std::max<double>(std::chrono::duration<double>(elapsed).count(),1e-6);
+        if(bytes==0)
+        {
+            rate_=ewma(rate_,0);
+            return;
+        }
+        rate_=ewma(rate_,bytes/seconds);
+        sink_ns_=ewma(sink_ns_,static_cast<double>(sink_time.count()));
+        has_sample_=true;
+    }
+
+    //从第一条数据写入到刷新之间最多等待的时间
+    Duration interval()const
+    {
+        Duration wait(static_cast<Duration::rep>(sink_ns_*kLatencyFactor));
+        return std::clamp(wait,kMinInterval,std::max(max_latency_,kMinInterval));
+    }
+
+    //生产者缓冲区中的数据超过该值时提前刷新
+    size_t threshold()const
+    {
+        double expected=rate_*std::chrono::duration<double>(interval()).count();
+        return std::clamp(static_cast<size_t>(expected),kMinBatchBytes,max_batch_bytes_);
+    }
+
+    inline Duration maxLatency()const {return max_latency_;}
+    inline double rate()const {return rate_;}
+};
+
+} // namespace asynclog
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <source_location>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+#include "Level.hpp"
+#include "Clock.hpp"
+
+namespace asynclog
+{
+
+namespace Fmt
+{
+
+//先写入栈上的缓冲区，只有单条日志超过kInlineSize时才使用堆内存
+class LineWriter
+{
+public:
+    static constexpr size_t kInlineSize=1024;
+
+    LineWriter():size_(0){}
+    LineWriter(const LineWriter&)=delete;
+    LineWriter& operator=(const LineWriter&)=delete;
+
+    void append(const char* data,size_t len)
+    {
+        if(!overflow_.empty()||size_+len>kInlineSize)
+        {
+            if(overflow_.empty()) overflow_.assign(inline_,size_);
+            overflow_.append(data,len);
+            return;
+        }
+        std::memcpy(inline_+size_,data,len);
+        size_+=len;
+    }
+
+    void append(std::string_view sv){append(sv.data(),sv.size());}
+
+    void push(char c){append(&c,1);}
+
+    inline const char* data()const {return overflow_.empty() ? inline_ : overflow_.data();}
+    inline size_t size()const {return overflow_.empty() ? size_ : overflow_.size();}
+
+private:
+    char inline_[kInlineSize];
+    size_t size_;
+    std::string overflow_;
+};
+
+template<typename T>
+void writeArg(LineWriter& w,const T& value)
+{
+    using U=std::remove_cvref_t<T>;
+    if constexpr(std::is_same_v<U,bool>)
+    {
+        w.append(value ? std::string_view("true") : std::string_view("false"));
+    }
+    else if constexpr(std::is_same_v<U,char>)
+    {
+        w.push(value);
+    }
+    else if constexpr(std::is_integral_v<U>||std::is_floating_point_v<U>)
+    {
+        char buf[64];
+        auto [end,ec]=std::to_chars(buf,buf+sizeof(buf),value);
+        w.append(buf,end-buf);
+    }
+    else if constexpr(std::is_enum_v<U>)
+    {
+        writeArg(w,static_cast<std::underlying_type_t<U>>(value));
+    }
+    else if constexpr(std::is_convertible_v<const T&,std::string_view>)
+    {
+        //const char*为空时按"(null)"输出，和printf保持一致，数组和字面量不可能为空
+        if constexpr(std::is_same_v<U,const char*>||std::is_same_v<U,char*>)
+        {
+            if(value==nullptr)
+            {
+                w.append("(null)");
+                return;
+            }
+        }
+        w.append(std::string_view(value));
+    }
+    else
+    {
+        static_assert(std::is_pointer_v<std::decay_t<T>>,"unsupported argument type");
+        char buf[32]={'0','x'};
+        auto [end,ec]=std::to_chars(buf+2,buf+sizeof(buf),reinterpret_cast<uintptr_t>(value),16);
+        w.append(buf,end-buf);
+    }
+}
+
+//当前线程id的文本，每个线程只格式化一次
+inline std::string_view threadIdText()
+{
+    static thread_local std::string text=[](){
+        std::stringstream ss;
+        ss<<std::this_thread::get_id();
+        return ss.str();
+    }();
+    return text;
+}
+
+//格式化时间，每个线程缓存上一次的结果，同一秒内的日志不再调用localtime_r和strftime
+inline std::string_view dateText(time_t t)
+{
+    struct Cache
+    {
+        time_t sec_=-1;
+        char buf_[32];
+        size_t len_=0;
+    };
+    static thread_local Cache cache;
+    if(cache.sec_!=t)
+    {
+        struct tm tm_;
+        localtime_r(&t,&tm_);
+        cache.len_=strftime(cache.buf_,sizeof(cache.buf_),"%Y-%m-%d %H:%M:%S",&tm_);
+        cache.sec_=t;
+    }
+    return std::string_view(cache.buf_,cache.len_);
+}
+
+/* 把日志头"[时间][线程id][等级][日志器名][文件:行号]\t"直接写入out，不产生临时字符串
+precision不是秒时在时间后追加对应位数的小数部分，如"2025-03-03 14:30:00.123456"
+Out需要提供append(const char*,size_t)，如std::string和LineWriter */
+template<typename Out>
+void writeHeader(Out& out,Timestamp ts,TimePrecision precision,std::string_view tid,LogLevel::value level,
+    std::string_view name,std::string_view file,size_t line)
+{
+    std::string_view date=dateText(ts.sec_);
+    std::string_view level_str=LogLevel::toString(level);
+    char num[24];
+    auto [num_end,ec]=std::to_chars(num,num+sizeof(num),line);
+
+    out.append("[",1);
+    out.append(date.data(),date.size());
+    if(int digits=Clock::fractionDigits(precision))
+    {
+        char frac[10];
+        uint32_t value=ts.nsec_;
+        for(int i=digits;i<9;++i) value/=10;
+        frac[0]='.';
+        for(int i=digits;i>0;--i)
+        {
+            frac[i]=static_cast<char>('0'+value%10);
+            value/=10;
+        }
+        out.append(frac,digits+1);
+    }
+    out.append("][",2);
+    out.append(tid.data(),tid.size());
+    out.append("][",2);
+    out.append(level_str.data(),level_str.size());
+    out.append("][",2);
+    out.append(name.data(),name.size());
+    out.append("][",2);
+    out.append(file.data(),file.size());
+    out.append(":",1);
+    out.append(num,num_end-num);
+    out.append("]\t",2);
+}
+
+} // namespace Fmt
+
+/* 编译期检查的格式串，只支持{}占位符，{{和}}分别输出{和}
+构造时统计占位符的数量并和参数个数比较，同时预先计算好每一段字面量的位置，
+调用点的文件名和行号通过std::source_location获取，格式串错误时consteval构造函数中的throw会导致编译失败 */
+template<typename... Args>
+class FormatString
+{
+public:
+    //字面量片段，arg_为true说明这一段之后紧跟着一个参数
+    struct Piece
+    {
+        uint32_t offset_;
+        uint32_t len_;
+        bool arg_;
+    };
+    static constexpr size_t kMaxEscapes=8;
+
+    template<size_t N>
+    consteval FormatString(const char (&str)[N],std::source_location loc=std::source_location::current())
+        :str_(str,N-1)
+        ,pieces_{}
+        ,count_(0)
+        ,loc_(loc)
+    {
+        size_t args=0;
+        size_t begin=0;
+        for(size_t i=0;i<N-1;++i)
+        {
+            if(str[i]=='{')
+            {
+                if(i+1<N-1&&str[i+1]=='{')
+                {
+                    //{{输出一个{，把第一个{放进当前片段，跳过第二个
+                    addPiece(begin,i+1-begin,false);
+                    begin=i+2;
+                    ++i;
+                }
+                else if(i+1<N-1&&str[i+1]=='}')
+                {
+                    addPiece(begin,i-begin,true);
+                    ++args;
+                    begin=i+2;
+                    ++i;
+                }
+                else
+                {
+                    throw "only {} placeholders are supported";
+                }
+            }
+            else if(str[i]=='}')
+            {
+                if(i+1<N-1&&str[i+1]=='}')
+                {
+                    addPiece(begin,i+1-begin,false);
+                    begin=i+2;
+                    ++i;
+                }
+                else
+                {
+                    throw "unmatched '}' in format string";
+                }
+            }
+        }
+        addPiece(begin,N-1-begin,false);
+        if(args!=sizeof...(Args))
+        {
+            throw "the number of {} does not match the number of arguments";
+        }
+    }
+
+    constexpr std::string_view str()const {return str_;}
+    inline const std::source_location& location()const {return loc_;}
+
+    //按照预先计算好的片段把参数写入w
+    template<typename... A>
+    void format(Fmt::LineWriter& w,const A&... args)const
+    {
+        size_t idx=0;
+        auto write_until_arg=[&](){
+            while(idx<count_)
+            {
+                const Piece& piece=pieces_[idx++];
+                w.append(str_.data()+piece.offset_,piece.len_);
+                if(piece.arg_) return;
+            }
+        };
+        ((write_until_arg(),Fmt::writeArg(w,args)),...);
+        write_until_arg();
+    }
+
+private:
+    consteval void addPiece(size_t offset,size_t len,bool arg)
+    {
+        if(count_>=pieces_.size())
+        {
+            throw "too many escaped braces in format string";
+        }
+        pieces_[count_++]=Piece{static_cast<uint32_t>(offset),static_cast<uint32_t>(len),arg};
+    }
+
+    std::string_view str_;
+    std::array<Piece,sizeof...(Args)+1+kMaxEscapes>pieces_;
+    size_t count_;
+    std::source_location loc_;
+};
+
+//参数类型不参与FormatString的推导
+template<typename... Args>
+using FormatStringFor=FormatString<std::type_identity_t<Args>...>;
+
+} // namespace asynclog
@@ -1,6 +1,9 @@
 #pragma once
+#include <sys/types.h>
+#include <sys/uio.h>
 #include <cstdio>
 #include <string>
+#include <vector>
 #include <ctime>
 #include <cstdarg>
 
@@ -15,6 +18,17 @@ public:
     virtual int fileno(FILE* stream) = 0;
     virtual int fsync(int fd) = 0;
     virtual int ferror(FILE* stream) = 0;
+
+    //直接操作文件描述符，绕过stdio的缓冲区
+    virtual int open(const char* path, int flags, mode_t mode) = 0;
+    virtual int close(int fd) = 0;
+    virtual ssize_t writev(int fd, const struct iovec* iov, int iovcnt) = 0;
+    virtual ssize_t pwritev2(int fd, const struct iovec* iov, int iovcnt, off_t offset, int flags) = 0;
+    virtual int fdatasync(int fd) = 0;
+
+    virtual int rename(const char* old_path, const char* new_path) = 0;
+    virtual int remove(const char* path) = 0;
+    virtual std::vector<std::string> listDirectory(const std::string& path) = 0; // 目录中所有文件的名字
     
     virtual void perror(const char* s) = 0;
 
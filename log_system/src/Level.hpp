@@ -1,5 +1,12 @@
 #pragma once
 
+#include <string_view>
+
+//编译期的最低日志等级(0:DEBUG 1:INFO 2:WARN 3:ERROR 4:FATAL)，低于该等级的日志宏会被完全编译掉
+#ifndef ASYNCLOG_MIN_LEVEL
+#define ASYNCLOG_MIN_LEVEL 0
+#endif
+
 namespace asynclog
 {
 
@@ -27,6 +34,24 @@ public:
 
         return "UNKNOW";
     }
+
+    //字符串转换为日志等级，无法识别时返回false
+    static bool fromString(std::string_view str,value& level)
+    {
+        if(str=="DEBUG") level=value::DEBUG;
+        else if(str=="INFO") level=value::INFO;
+        else if(str=="WARN") level=value::WARN;
+        else if(str=="ERROR") level=value::ERROR;
+        else if(str=="FATAL") level=value::FATAL;
+        else return false;
+        return true;
+    }
+
+    //该等级是否在编译期被保留
+    static constexpr bool enabled(value level)
+    {
+        return static_cast<int>(level)>=ASYNCLOG_MIN_LEVEL;
+    }
 };
     
     
@@ -1,5 +1,16 @@
 #pragma once
 
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <atomic>
+#include <vector>
 #include <memory>
 #include <string>
 #include <fstream>
@@ -8,9 +19,17 @@
 #include <chrono>
 #include <iomanip>
 #include <concepts>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <string_view>
+#include <ctime>
+#include <filesystem>
 
 #include "Util.hpp"
 #include "ISystemOps.h"
+#include "Task.hpp"
+#include "Retention.hpp"
 
 namespace asynclog
 {
@@ -25,6 +44,27 @@ public:
     int fileno(FILE* stream)override{return ::fileno(stream);}
     int fsync(int fd)override{return ::fsync(fd);}
     int ferror(FILE* stream)override{return ::ferror(stream);}
+
+    int open(const char* path, int flags, mode_t mode)override{return ::open(path,flags,mode);}
+    int close(int fd)override{return ::close(fd);}
+    ssize_t writev(int fd, const struct iovec* iov, int iovcnt)override{return ::writev(fd,iov,iovcnt);}
+    ssize_t pwritev2(int fd, const struct iovec* iov, int iovcnt, off_t offset, int flags)override
+    {
+        return ::pwritev2(fd,iov,iovcnt,offset,flags);
+    }
+    int fdatasync(int fd)override{return ::fdatasync(fd);}
+    int rename(const char* old_path, const char* new_path)override{return ::rename(old_path,new_path);}
+    int remove(const char* path)override{return ::remove(path);}
+    std::vector<std::string> listDirectory(const std::string& path)override
+    {
+        std::vector<std::string>names;
+        std::error_code ec;
+        for(auto it=std::filesystem::directory_iterator(path,ec);!ec&&it!=std::filesystem::directory_iterator();it.increment(ec))
+        {
+            names.push_back(it->path().filename().string());
+        }
+        return names;
+    }
     
     void perror(const char* s)override{return ::perror(s);}
 
@@ -41,6 +81,18 @@ class LogFlush
 public:
     using ptr=std::shared_ptr<LogFlush>;
     virtual void flush(const char* data,size_t len) = 0;
+    //一次写入多段数据(例如分段缓冲区的每个块)，默认逐段调用flush，子类可以重写以减少刷新次数
+    virtual void flushv(const struct iovec* iov,int cnt)
+    {
+        for(int i=0;i<cnt;++i)
+        {
+            flush(static_cast<const char*>(iov[i].iov_base),iov[i].iov_len);
+        }
+    }
+    //把之前写入的数据落盘，由AsyncLogger::sync调用，默认什么都不做
+    virtual void sync(){}
+    //日志器构造时传入它的线程池，需要后台任务的落地方向保存下来，默认忽略
+    virtual void setThreadPool(std::shared_ptr<Executor>){}
     virtual ~LogFlush()=default;
 };
 
@@ -51,6 +103,10 @@ public:
     {
         std::cout.write(data,len);
     }
+    void sync() override
+    {
+        std::cout.flush();
+    }
     ~StdOutFlush()override =default;
 };
 
@@ -61,6 +117,52 @@ private:
     FILE* file_;
     size_t flush_log_;
     std::unique_ptr<ISystemOps>ops_;
+
+    //写入数据，文件没有打开或者fwrite出错时返回false
+    bool writeData(const char* data,size_t len)
+    {
+        if(file_==NULL) return false;
+        const char* data_ptr=data;
+        size_t remaining=len;
+        while(remaining>0)
+        {
+            size_t n = ops_->fwrite(data_ptr,1,remaining,file_);
+            if(n==0)
+            {
+                if(ops_->ferror(file_))
+                {
+                    ops_->perror("ops_->fwrite failed: ");
+                    return false;
+                }
+                break;
+            }
+            data_ptr+=n;
+            remaining-=n;
+        }
+        return true;
+    }
+
+    //按照flush_log的策略刷新，正常写入时使用flush_log_，sync时使用2
+    void syncData(size_t flush_log)
+    {
+        //如果flush_log是1，则将日志从用户缓冲区刷新到内核缓冲区
+        if(flush_log==1||flush_log==2)
+        {
+            if(ops_->fflush(file_)==EOF)
+            {
+                ops_->perror("ops_->fflush failed: ");
+                return;
+            }
+            //如果flush_log为2，则进一步将日志刷新到磁盘中
+            if(flush_log==2)
+            {
+                if(ops_->fsync(ops_->fileno(file_))!=0)
+                {
+                    ops_->perror("ops_->fsync failed: ");
+                }
+            }
+        }
+    }
 public:
     FileFlush(std::string file_path,const Util::JsonUtil::JsonData&json_data,std::unique_ptr<ISystemOps>ops=nullptr)
         :file_path_(file_path)
@@ -92,91 +194,316 @@ public:
 
     void flush(const char* data,size_t len) override
     {
-        const char* data_ptr=data;
-        size_t remaining=len;
-        while(remaining>0)
-        {
-            size_t n = ops_->fwrite(data_ptr,1,remaining,file_);
-            if(n==0)
-            {
-                if(ops_->ferror(file_))
-                {
-                    ops_->perror("ops_->fwrite failed: ");
-                    return;
-                }
-                break;
-            }
-            data_ptr+=n;
-            remaining-=n;
-        }
+        if(!writeData(data,len)) return;
+        syncData(flush_log_);
+    }
 
-        //如果flush_log_是1，则将日志从用户缓冲区刷新到内核缓冲区
-        if(flush_log_==1||flush_log_==2)
+    //所有数据写入之后只刷新一次
+    void flushv(const struct iovec* iov,int cnt) override
+    {
+        for(int i=0;i<cnt;++i)
         {
-            if(ops_->fflush(file_)==EOF)
-            {
-                ops_->perror("ops_->fflush failed: ");
-                return;
-            }
-            //如果flush_log_为2，则进一步将日志刷新到磁盘中
-            if(flush_log_==2)
-            {
-                if(ops_->fsync(ops_->fileno(file_))!=0)
-                {
-                    ops_->perror("ops_->fsync failed: ");
-                }
-            }
+            if(!writeData(static_cast<const char*>(iov[i].iov_base),iov[i].iov_len)) return;
         }
+        syncData(flush_log_);
+    }
+
+    void sync() override
+    {
+        if(file_) syncData(2);
     }
 };
 
+//按时间滚动的周期
+enum class RollInterval
+{
+    NONE,   //只按大小滚动
+    HOUR,   //每个整点滚动
+    DAY     //每天零点滚动
+};
+
+//配置中的"none"/"hour"/"day"转换为滚动周期，无法识别时返回false
+inline bool rollIntervalFromString(std::string_view str,RollInterval& interval)
+{
+    if(str=="none") interval=RollInterval::NONE;
+    else if(str=="hour") interval=RollInterval::HOUR;
+    else if(str=="day") interval=RollInterval::DAY;
+    else return false;
+    return true;
+}
+
+/* 按大小和(或)时间滚动的文件输出
+max_size_为0时不按大小滚动，interval_不为NONE时在整点或者零点滚动，两者同时设置时先满足哪个条件就滚动哪个
+开启预打开(roll_preopen_)时辅助线程提前以临时文件名打开下一个文件、在后台关闭旧文件，
+后台线程滚动时只需要rename临时文件，不会阻塞在打开和关闭文件上
+文件名末尾的序号在启动时扫描目录中已有的文件之后接着递增 */
 class RollFileFlush: public LogFlush
 {
 private:
+    static constexpr const char* kTempPrefix=".LOG_next_";   //预打开的临时文件名的前缀
+    static constexpr size_t kMaxUnsyncedFiles=16;           //等待sync落盘的已关闭文件的上限
+
     size_t cnt_;            //滚动文件的序号
     size_t cur_cnt_;        //当前文件写入的大小
-    size_t max_size_;       //每个日志文件允许的最大的大小
+    size_t max_size_;       //每个日志文件允许的最大的大小，为0时不按大小滚动
     FILE* file_;
     std::string folder_path_;//存放日志文件的目录
     size_t flush_log_;      //日志的刷新策略
+    std::string cur_path_;  //当前文件的路径
+    std::vector<std::string>unsynced_files_;   //已经滚动关闭但是还没有落盘的文件，sync时落盘
+    RollInterval interval_; //按时间滚动的周期
+    time_t next_roll_time_; //下一次按时间滚动的时间
+    std::shared_ptr<RetentionManager>retention_;   //滚动关闭的文件的压缩和清理，没有配置时为空
     std::unique_ptr<ISystemOps>ops_;
 
-    //初始化日志文件
-    void initLogFile()
+    //预打开，以下成员除了preopen_都由helper_mtx_保护
+    bool preopen_;
+    std::thread helper_;
+    std::mutex helper_mtx_;
+    std::condition_variable helper_cond_;
+    FILE* next_file_;                   //已经打开的下一个文件
+    std::string next_tmp_path_;         //下一个文件的临时文件名
+    bool need_next_;                    //需要打开下一个文件
+    std::vector<FILE*>to_close_;        //等待辅助线程关闭的旧文件
+    bool helper_stop_;
+
+    //辅助线程: 关闭旧文件，打开下一个文件
+    void helperEntry()
     {
-        //如果没有文件或者是当前文件达到最大，创建一个新文件
-        if(file_== NULL || cur_cnt_>max_size_)
+        std::unique_lock<std::mutex>lock(helper_mtx_);
+        while(true)
         {
-            if(file_ != NULL)
+            helper_cond_.wait(lock,[this](){return helper_stop_||need_next_||!to_close_.empty();});
+            std::vector<FILE*>to_close;
+            to_close.swap(to_close_);
+            bool open_next=need_next_&&!helper_stop_&&next_file_==nullptr;
+            need_next_=false;
+            std::string tmp_path=folder_path_+kTempPrefix+std::to_string(::getpid())+"_"+std::to_string(nextTempSeq())+".tmp";
+            if(helper_stop_&&to_close.empty()) return;
+            lock.unlock();
+
+            for(FILE* f:to_close) ops_->fclose(f);
+            FILE* next=nullptr;
+            if(open_next)
             {
-                ops_->fclose(file_);
-                file_ = NULL;
+                next=ops_->fopen(tmp_path.c_str(),"ab");
+                if(next==NULL) ops_->perror("ops_->fopen failed: ");
             }
 
-            //创建日志的路径
-            std::string file_path_ =folder_path_+createFileName();
-            
-            file_=ops_->fopen(file_path_.c_str(),"ab");
-            if(file_ == NULL)
+            lock.lock();
+            if(next)
             {
-                throw std::runtime_error("new file open failed "+file_path_);
+                next_file_=next;
+                next_tmp_path_=tmp_path;
             }
-            cur_cnt_=0;
         }
     }
 
+    //计算t之后的下一个整点或者零点
+    time_t nextRollTime(time_t t)const
+    {
+        struct tm tm;
+        ::localtime_r(&t,&tm);
+        tm.tm_sec=0;
+        tm.tm_min=0;
+        if(interval_==RollInterval::HOUR)
+        {
+            tm.tm_hour+=1;
+        }
+        else
+        {
+            tm.tm_hour=0;
+            tm.tm_mday+=1;
+        }
+        tm.tm_isdst=-1;
+        return ::mktime(&tm);
+    }
+
+    //临时文件名的序号，进程内所有实例共享，同一个目录中的多个实例不会使用相同的临时文件
+    static size_t nextTempSeq()
+    {
+        static std::atomic<size_t>seq{0};
+        return seq.fetch_add(1,std::memory_order_relaxed);
+    }
+
+    /* 临时文件名的格式为.LOG_next_<进程号>_<序号>.tmp，只有进程已经退出时才是没有用到的临时文件
+    其它进程或者本进程中共享目录的其它实例可能已经预打开了它们的临时文件，不能删除，本实例的临时文件在析构时删除 */
+    static bool staleTempFile(const std::string& name)
+    {
+        const char* begin=name.c_str()+std::char_traits<char>::length(kTempPrefix);
+        char* end=nullptr;
+        long pid=std::strtol(begin,&end,10);
+        if(end==begin||*end!='_'||pid<=0||pid==::getpid()) return false;
+        return ::kill(static_cast<pid_t>(pid),0)!=0&&errno==ESRCH;
+    }
+
+    //启动时扫描目录，序号从已有文件的最大序号之后开始，同时删除已经退出的进程没有用到的临时文件
+    void resumeCounter()
+    {
+        for(auto& name:ops_->listDirectory(folder_path_))
+        {
+            if(name.rfind(kTempPrefix,0)==0)
+            {
+                if(staleTempFile(name)) ops_->remove((folder_path_+name).c_str());
+                continue;
+            }
+            //文件名的格式为LOG_<时间>-<序号>.log
+            if(name.rfind("LOG_",0)!=0||name.size()<4||name.compare(name.size()-4,4,".log")!=0) continue;
+            size_t dash=name.find_last_of('-');
+            if(dash==std::string::npos||dash+1>=name.size()-4) continue;
+            std::string_view num(name.data()+dash+1,name.size()-4-dash-1);
+            if(num.find_first_not_of("0123456789")!=std::string_view::npos) continue;
+            size_t n=std::stoul(std::string(num));
+            if(n>=cnt_) cnt_=n+1;
+        }
+    }
+
+    //是否需要滚动
+    bool needRoll()
+    {
+        if(file_==NULL) return true;
+        if(max_size_>0&&cur_cnt_>max_size_) return true;
+        return interval_!=RollInterval::NONE&&ops_->now()>=next_roll_time_;
+    }
+
+    //初始化日志文件
+    void initLogFile()
+    {
+        //如果没有文件或者是当前文件达到最大(或者到达滚动的时间)，创建一个新文件
+        if(!needRoll()) return;
+
+        time_t now=ops_->now();
+        //创建日志的路径
+        std::string file_path_ =folder_path_+createFileName(now);
+
+        //优先使用辅助线程预先打开的文件
+        FILE* next=NULL;
+        std::string tmp_path;
+        if(preopen_)
+        {
+            std::lock_guard<std::mutex>lock(helper_mtx_);
+            next=next_file_;
+            tmp_path=next_tmp_path_;
+            next_file_=nullptr;
+        }
+        if(next!=NULL&&ops_->rename(tmp_path.c_str(),file_path_.c_str())!=0)
+        {
+            ops_->perror("ops_->rename failed: ");
+            ops_->fclose(next);
+            ops_->remove(tmp_path.c_str());
+            next=NULL;
+        }
+        if(next==NULL) next=ops_->fopen(file_path_.c_str(),"ab");
+        if(next == NULL)
+        {
+            throw std::runtime_error("new file open failed "+file_path_);
+        }
+
+        FILE* old=file_;
+        if(old != NULL&&flush_log_!=2)
+        {
+            //一直不调用sync时列表会无限增长，达到上限时先在滚动时落盘已经记录的文件
+            if(unsynced_files_.size()>=kMaxUnsyncedFiles) syncClosedFiles();
+            unsynced_files_.push_back(cur_path_);
+        }
+        file_=next;
+        cur_path_=file_path_;
+        cur_cnt_=0;
+        if(interval_!=RollInterval::NONE) next_roll_time_=nextRollTime(now);
+
+        if(preopen_)
+        {
+            //旧文件的stdio缓冲区在这里写入内核，保证sync时重新打开落盘可以看到全部数据
+            if(old != NULL) ops_->fflush(old);
+            std::lock_guard<std::mutex>lock(helper_mtx_);
+            if(old != NULL) to_close_.push_back(old);
+            need_next_=true;
+            helper_cond_.notify_one();
+        }
+        else if(old != NULL)
+        {
+            ops_->fclose(old);
+        }
+
+        //序号小于当前文件的都已经关闭，交给线程池压缩和清理
+        if(old != NULL&&retention_) retention_->schedule(cnt_-1);
+    }
+
+    //重新打开并落盘已经滚动关闭的文件，已经被压缩或者清理的文件直接跳过
+    void syncClosedFiles()
+    {
+        for(auto& path:unsynced_files_)
+        {
+            int fd=ops_->open(path.c_str(),O_WRONLY|O_CLOEXEC,0);
+            if(fd<0) continue;
+            if(ops_->fsync(fd)!=0)
+            {
+                ops_->perror("ops_->fsync failed: ");
+            }
+            ops_->close(fd);
+        }
+        unsynced_files_.clear();
+    }
+
     //创建日志文件的名字
-    std::string createFileName()
+    std::string createFileName(time_t t)
     {
-        time_t t = ops_->now();
         struct tm tm;
-        
         ::localtime_r(&t,&tm);
 
-        std::stringstream ss;
-        ss<<std::put_time(&tm,"LOG_%Y-%m-%d_%H:%M%S");
-        ss<<"-"<<cnt_++<<".log";
-        return ss.str();
+        char time_str[64];
+        size_t n=::strftime(time_str,sizeof(time_str),"LOG_%Y-%m-%d_%H:%M%S",&tm);
+        std::string name(time_str,n);
+        name+="-";
+        name+=std::to_string(cnt_++);
+        name+=".log";
+        return name;
+    }
+
+    //写入数据，文件没有打开或者fwrite出错时返回false
+    bool writeData(const char* data,size_t len)
+    {
+        if(file_==NULL) return false;
+        const char* data_ptr=data;
+        size_t remaining=len;
+        while(remaining>0)
+        {
+            size_t n = ops_->fwrite(data_ptr,1,remaining,file_);
+            if(n==0)
+            {
+                if(ops_->ferror(file_))
+                {
+                    ops_->perror("ops_->fwrite failed: ");
+                    return false;
+                }
+                break;
+            }
+            data_ptr+=n;
+            remaining-=n;
+        }
+        return true;
+    }
+
+    //按照flush_log的策略刷新，正常写入时使用flush_log_，sync时使用2
+    void syncData(size_t flush_log)
+    {
+        //如果flush_log是1，则将日志从用户缓冲区刷新到内核缓冲区
+        if(flush_log==1||flush_log==2)
+        {
+            if(ops_->fflush(file_)==EOF)
+            {
+                ops_->perror("ops_->fflush failed: ");
+                return;
+            }
+            //如果flush_log为2，则进一步将日志刷新到磁盘中
+            if(flush_log==2)
+            {
+                if(ops_->fsync(ops_->fileno(file_))!=0)
+                {
+                    ops_->perror("ops_->fsync failed: ");
+                }
+            }
+        }
     }
 public:
     RollFileFlush(const std::string& folder_path,size_t per_file_max_size,
@@ -187,6 +514,12 @@ public:
         ,file_(NULL)
         ,folder_path_(folder_path)
         ,flush_log_(json_data.flush_log_)
+        ,interval_(RollInterval::NONE)
+        ,next_roll_time_(0)
+        ,preopen_(json_data.roll_preopen_)
+        ,next_file_(nullptr)
+        ,need_next_(false)
+        ,helper_stop_(false)
     {
         if(ops)
         {
@@ -196,6 +529,10 @@ public:
         {
             ops_=std::make_unique<RSystemOps>();
         }
+        if(!rollIntervalFromString(json_data.roll_interval_,interval_))
+        {
+            interval_=RollInterval::NONE;
+        }
 
         ops_->createDirectory(folder_path_);
         std::string opt;
@@ -209,9 +546,40 @@ public:
         {
             folder_path_+=opt;
         }
+
+        resumeCounter();
+        if(RetentionManager::enabled(json_data))
+        {
+            retention_=std::make_shared<RetentionManager>(folder_path_,json_data);
+            //上次运行留下的文件在设置线程池之后处理
+            retention_->schedule(cnt_);
+        }
+        if(preopen_)
+        {
+            helper_=std::thread([this](){helperEntry();});
+            //提前打开第一次滚动要用的文件
+            std::lock_guard<std::mutex>lock(helper_mtx_);
+            need_next_=true;
+            helper_cond_.notify_one();
+        }
     }
     ~RollFileFlush()
     {
+        if(helper_.joinable())
+        {
+            {
+                std::lock_guard<std::mutex>lock(helper_mtx_);
+                helper_stop_=true;
+                helper_cond_.notify_one();
+            }
+            helper_.join();
+            //没有用到的预打开文件
+            if(next_file_!=nullptr)
+            {
+                ops_->fclose(next_file_);
+                ops_->remove(next_tmp_path_.c_str());
+            }
+        }
         if(file_ != NULL)
         {
             ops_->fclose(file_);
@@ -221,47 +589,174 @@ public:
     //测试使用
     inline size_t getFileNum()const {return cnt_-1;}
 
+    void setThreadPool(std::shared_ptr<Executor>pool)override
+    {
+        if(retention_) retention_->setThreadPool(pool);
+    }
+
     void flush(const char* data,size_t len)override
     {
         initLogFile();
 
-        const char* data_ptr=data;
-        size_t remaining=len;
-        while(remaining>0)
+        if(!writeData(data,len)) return;
+        cur_cnt_+=len;
+
+        syncData(flush_log_);
+    }
+
+    //所有数据写入同一个文件之后只刷新一次
+    void flushv(const struct iovec* iov,int cnt)override
+    {
+        initLogFile();
+
+        for(int i=0;i<cnt;++i)
         {
-            size_t n = ops_->fwrite(data_ptr,1,remaining,file_);
-            if(n==0)
+            if(!writeData(static_cast<const char*>(iov[i].iov_base),iov[i].iov_len)) return;
+            cur_cnt_+=iov[i].iov_len;
+        }
+
+        syncData(flush_log_);
+    }
+
+    //落盘当前的文件和上次sync之后滚动关闭的文件
+    void sync()override
+    {
+        syncClosedFiles();
+        if(file_) syncData(2);
+    }
+};
+
+/* 直接写文件描述符的文件输出，绕过stdio的用户态缓冲区，数据只从日志缓冲区拷贝一次到内核
+每批数据(连续缓冲区或者分段缓冲区的所有块)用一次writev写入，
+flush_log_为2时使用pwritev2的RWF_DSYNC标志在写入的同时落盘，不再单独调用fsync，内核不支持时退化为writev+fdatasync */
+class WritevFileFlush: public LogFlush
+{
+private:
+#ifdef IOV_MAX
+    static constexpr int kMaxIov=IOV_MAX;
+#else
+    static constexpr int kMaxIov=1024;
+#endif
+
+    std::string file_path_;
+    int fd_;
+    size_t flush_log_;
+    bool use_dsync_;                //是否使用RWF_DSYNC
+    std::vector<struct iovec>iov_;  //剩余未写入的数据，部分写入时在这里调整偏移
+    std::unique_ptr<ISystemOps>ops_;
+
+    //写入iov_中的所有数据，处理部分写入和EINTR，出错时返回false
+    bool writeAll()
+    {
+        size_t idx=0;
+        while(idx<iov_.size())
+        {
+            //跳过空的段
+            if(iov_[idx].iov_len==0)
             {
-                if(ops_->ferror(file_))
+                ++idx;
+                continue;
+            }
+            int cnt=static_cast<int>(std::min<size_t>(iov_.size()-idx,kMaxIov));
+            ssize_t n= use_dsync_ ? ops_->pwritev2(fd_,&iov_[idx],cnt,-1,RWF_DSYNC)
+                                  : ops_->writev(fd_,&iov_[idx],cnt);
+            if(n<0)
+            {
+                if(errno==EINTR) continue;
+                if(use_dsync_&&(errno==ENOSYS||errno==EOPNOTSUPP))
                 {
-                    ops_->perror("ops_->fwrite failed: ");
-                    return;
+                    //内核不支持pwritev2或者RWF_DSYNC，改为写入之后调用fdatasync
+                    use_dsync_=false;
+                    continue;
                 }
-                break;
+                ops_->perror("ops_->writev failed: ");
+                return false;
             }
-            data_ptr+=n;
-            remaining-=n;
-        }
-        cur_cnt_+=len;
-
-        //如果flush_log_是1，则将日志从用户缓冲区刷新到内核缓冲区
-        if(flush_log_==1||flush_log_==2)
-        {
-            if(ops_->fflush(file_)==EOF)
+            if(n==0)
             {
-                ops_->perror("ops_->fflush failed: ");
-                return;
+                ops_->perror("ops_->writev wrote nothing: ");
+                return false;
             }
-            //如果flush_log_为2，则进一步将日志刷新到磁盘中
-            if(flush_log_==2)
+
+            //部分写入时跳过已经写完的段，调整写了一半的段的起始位置
+            size_t written=static_cast<size_t>(n);
+            while(written>0)
             {
-                if(ops_->fsync(ops_->fileno(file_))!=0)
+                struct iovec& v=iov_[idx];
+                if(written>=v.iov_len)
                 {
-                    ops_->perror("ops_->fsync failed: ");
+                    written-=v.iov_len;
+                    ++idx;
                 }
+                else
+                {
+                    v.iov_base=static_cast<char*>(v.iov_base)+written;
+                    v.iov_len-=written;
+                    written=0;
+                }
+            }
+        }
+        return true;
+    }
+
+public:
+    WritevFileFlush(std::string file_path,const Util::JsonUtil::JsonData&json_data,std::unique_ptr<ISystemOps>ops=nullptr)
+        :file_path_(file_path)
+        ,fd_(-1)
+        ,flush_log_(json_data.flush_log_)
+        ,use_dsync_(json_data.flush_log_==2)
+    {
+        if(ops)
+        {
+            ops_=std::move(ops);
+        }
+        else
+        {
+            ops_=std::make_unique<RSystemOps>();
+        }
+
+        ops_->createDirectory(Util::File::folderPath(file_path));
+        fd_=ops_->open(file_path.c_str(),O_WRONLY|O_CREAT|O_APPEND|O_CLOEXEC,0644);
+        if(fd_<0)
+        {
+            ops_->perror("ops_->open failed: ");
+        }
+    }
+    ~WritevFileFlush()override
+    {
+        if(fd_>=0) ops_->close(fd_);
+    }
+
+    void flush(const char* data,size_t len)override
+    {
+        struct iovec iov{const_cast<char*>(data),len};
+        flushv(&iov,1);
+    }
+
+    void flushv(const struct iovec* iov,int cnt)override
+    {
+        if(fd_<0) return;
+        iov_.assign(iov,iov+cnt);
+        if(!writeAll()) return;
+
+        //没有写入内核缓冲区之外的用户态缓冲区，flush_log_为1时不需要额外操作
+        if(flush_log_==2&&!use_dsync_)
+        {
+            if(ops_->fdatasync(fd_)!=0)
+            {
+                ops_->perror("ops_->fdatasync failed: ");
             }
         }
     }
+
+    void sync()override
+    {
+        if(fd_<0) return;
+        if(ops_->fdatasync(fd_)!=0)
+        {
+            ops_->perror("ops_->fdatasync failed: ");
+        }
+    }
 };
 
 
@@ -1,22 +1,68 @@
 #pragma once
+#include <atomic>
+#include <deque>
 #include <unordered_map>
+#include <vector>
 
 #include "AsyncLogger.hpp"
 
 namespace asynclog
 {
 
+/* 按名字查找到的日志器的固定句柄，由Manager持有，地址在Manager的生命周期内不变
+调用点可以把引用缓存在static变量中，之后每次使用只需要一次原子读取，不加锁也不修改引用计数
+日志器在句柄创建之后才注册或者被替换时，句柄自动指向新的日志器 */
+class LoggerHandle
+{
+private:
+    friend class Manager;
+
+    //指向Manager中保存的shared_ptr，这些shared_ptr注册之后不会被释放
+    std::atomic<const std::shared_ptr<AsyncLogger>*>logger_;
+
+    static const std::shared_ptr<AsyncLogger>& null()
+    {
+        static const std::shared_ptr<AsyncLogger>empty;
+        return empty;
+    }
+
+public:
+    LoggerHandle():logger_(&null()){}
+    LoggerHandle(const LoggerHandle&)=delete;
+    LoggerHandle& operator=(const LoggerHandle&)=delete;
+
+    //日志器没有注册时返回空的shared_ptr，返回的引用在Manager的生命周期内有效
+    inline const std::shared_ptr<AsyncLogger>& shared()const {return *logger_.load(std::memory_order_acquire);}
+    inline AsyncLogger* get()const {return shared().get();}
+    inline AsyncLogger* operator->()const {return get();}
+    inline explicit operator bool()const {return get()!=nullptr;}
+};
+
+/* 日志器的注册表，读多写少
+名字到句柄的映射是不可变的快照，注册新名字时复制一份再原子地替换，查找不加锁
+旧的快照和被替换的日志器保留到Manager析构，保证无锁的读者拿到的指针一直有效，
+日志器的数量很少，这部分内存可以忽略
+被替换的日志器的后台线程继续运行，读者在替换之后写入的日志照常落地，Manager析构时刷新剩余的日志 */
 class Manager
 {
 private:
-    std::unordered_map<std::string,std::shared_ptr<AsyncLogger>>loggers_;
-    std::mutex mtx_;
+    using Registry=std::unordered_map<std::string,LoggerHandle*>;
+
+    std::atomic<const Registry*>registry_;  //当前的快照
+    std::mutex mtx_;                        //只在注册时加锁
+    std::vector<std::unique_ptr<const Registry>>registries_;    //所有的快照，最后一个是当前的快照
+    std::deque<LoggerHandle>handles_;       //deque在尾部插入时元素地址不变
+    std::deque<std::shared_ptr<AsyncLogger>>loggers_;    //所有注册过的日志器，包括被替换的
     std::shared_ptr<AsyncLogger>default_logger_;
-    std::shared_ptr<ThreadPool>default_pool_;
+    std::shared_ptr<WorkStealingPool>default_pool_;
 
     Manager()
+        :registry_(nullptr)
     {
-        default_pool_=std::make_shared<ThreadPool>(2,100);
+        registries_.push_back(std::make_unique<const Registry>());
+        registry_.store(registries_.back().get(),std::memory_order_release);
+
+        default_pool_=std::make_shared<WorkStealingPool>(2,100);
         AsyncLoggerBuilder builder;
         builder.setLoggerName("default");
 
@@ -26,6 +72,27 @@ private:
 
         default_logger_=builder.build(default_pool_);
     }
+
+    //在当前快照中查找，不加锁
+    LoggerHandle* find(const std::string& name)const
+    {
+        const Registry* registry=registry_.load(std::memory_order_acquire);
+        auto it=registry->find(name);
+        return it==registry->end() ? nullptr : it->second;
+    }
+
+    //调用者持有mtx_，名字不存在时创建句柄并发布新的快照
+    LoggerHandle& findOrCreate(const std::string& name)
+    {
+        if(LoggerHandle* handle=find(name)) return *handle;
+        LoggerHandle& handle=handles_.emplace_back();
+        auto registry=std::make_unique<Registry>(*registries_.back());
+        registry->emplace(name,&handle);
+        registries_.push_back(std::move(registry));
+        registry_.store(registries_.back().get(),std::memory_order_release);
+        return handle;
+    }
+
 public:
     ~Manager()=default;
     Manager& operator =(const Manager&) = delete;
@@ -37,30 +104,38 @@ public:
         return instance;
     }
 
-    std::shared_ptr<AsyncLogger>getDefaultLogger(){return default_logger_;}
+    const std::shared_ptr<AsyncLogger>& getDefaultLogger()const {return default_logger_;}
 
+    //注册日志器，同名的日志器已经存在时替换，已有的句柄指向新的日志器
     void addLogger(std::shared_ptr<AsyncLogger>logger)
     {
         std::lock_guard<std::mutex>lock(mtx_);
-        loggers_[logger->name()] = logger;
+        LoggerHandle& handle=findOrCreate(logger->name());
+        const std::shared_ptr<AsyncLogger>& slot=loggers_.emplace_back(std::move(logger));
+        handle.logger_.store(&slot,std::memory_order_release);
     }
 
-    bool exist(std::string name)
+    bool exist(const std::string& name)const
     {
-        std::lock_guard<std::mutex>lock(mtx_);
-        return loggers_.find(name)!=loggers_.end();
+        LoggerHandle* handle=find(name);
+        return handle!=nullptr&&*handle;
+    }
+
+    //不存在时返回空的shared_ptr，返回的引用在Manager的生命周期内有效
+    const std::shared_ptr<AsyncLogger>& getLogger(const std::string& name)const
+    {
+        LoggerHandle* handle=find(name);
+        return handle ? handle->shared() : LoggerHandle::null();
     }
 
-    std::shared_ptr<AsyncLogger>getLogger(std::string name)
+    /* 获取名字对应的句柄，日志器还没有注册时也会创建，注册之后句柄自动生效
+    用法: static asynclog::LoggerHandle& logger=asynclog::Manager::getInstance().handle("name"); */
+    LoggerHandle& handle(const std::string& name)
     {
+        if(LoggerHandle* handle=find(name)) return *handle;
         std::lock_guard<std::mutex>lock(mtx_);
-        if(loggers_.find(name)!=loggers_.end())
-        {
-            return loggers_[name];
-        }
-        return nullptr;
+        return findOrCreate(name);
     }
-    
 };
 
 } // namespace asynclog
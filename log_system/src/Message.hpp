@@ -6,6 +6,7 @@
 
 #include <Util.hpp>
 #include <Level.hpp>
+#include <Format.hpp>
 
 
 namespace asynclog
@@ -16,31 +17,46 @@ struct LogMessage
     using ptr = std::shared_ptr<LogMessage>;
     LogMessage() = default;
     LogMessage(LogLevel::value level,size_t line,std::string file,
-        std::string name,std::string pay_load)
+        std::string name,std::string pay_load,TimePrecision precision=TimePrecision::SECOND)
         :line_(line)
-        ,ctime_(Util::Date::now())
         ,file_name_(std::move(file))
         ,name_(std::move(name))
         ,pay_load_(std::move(pay_load))
         ,tid_(std::this_thread::get_id())
         ,level_(level)
-    {}
-
-    std::string format()
+        ,precision_(precision)
     {
-        struct tm tm_;
-        localtime_r(&ctime_,&tm_);
-        char buf[128] = {0};
-        strftime(buf,sizeof(buf),"%Y-%m-%d %H:%M:%S",&tm_);
+        Timestamp ts=Clock::now(precision_);
+        ctime_=ts.sec_;
+        nsec_=ts.nsec_;
+    }
 
-        std::string tem1 = '['+std::string(buf)+"][";
-        std::string tem2 = "]["+ std::string(LogLevel::toString(level_))+"]["+name_+"]["+file_name_+':'+std::to_string(line_)+"]\t"+pay_load_+'\n';
+    std::string format()const
+    {
+        std::string ret;
+        ret.reserve(64+name_.size()+file_name_.size()+pay_load_.size());
+        formatTo(ret);
+        return ret;
+    }
 
-        std::stringstream ret;
-        ret<<tem1<<tid_<<tem2;
-        return ret.str();
+    //直接把日志写入out，时间和当前线程的id使用线程本地的缓存
+    template<typename Out>
+    void formatTo(Out& out)const
+    {
+        if(tid_==std::this_thread::get_id())
+        {
+            Fmt::writeHeader(out,Timestamp{ctime_,nsec_},precision_,Fmt::threadIdText(),level_,name_,file_name_,line_);
+        }
+        else
+        {
+            std::stringstream ss;
+            ss<<tid_;
+            Fmt::writeHeader(out,Timestamp{ctime_,nsec_},precision_,ss.str(),level_,name_,file_name_,line_);
+        }
+        out.append(pay_load_.data(),pay_load_.size());
+        out.append("\n",1);
     }
-    
+
 
 
     size_t line_; //行号
@@ -50,5 +66,7 @@ struct LogMessage
     std::string pay_load_; //信息体
     std::thread::id tid_; //线程名
     LogLevel::value level_; //日志等级
+    uint32_t nsec_=0; //秒内的纳秒，precision_不是秒时有效
+    TimePrecision precision_=TimePrecision::SECOND; //时间戳的精度
 };
 } // namespace asynclog
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "LogFlush.hpp"
+#include "Util.hpp"
+
+namespace asynclog
+{
+
+/* 基于内存映射的追加写文件输出
+用fallocate预先扩展文件并映射一个窗口，后台线程直接把每批数据memcpy到映射中，写满窗口之后映射下一个窗口，
+数据写入映射之后就在页缓存中，进程崩溃时也不会丢失，只有机器掉电才需要落盘:
+flush_log_为1时用sync_file_range启动异步回写，为2时用msync等待回写完成
+正常关闭时把文件截断到实际写入的长度，崩溃之后重新打开时跳过文件末尾预分配的0字节继续追加
+映射窗口之前必须真正分配磁盘块，否则磁盘满时写入映射会触发SIGBUS，
+所以文件系统不支持fallocate或者打开文件失败时退化为FileFlush，不用ftruncate扩展出稀疏文件 */
+class MmapFileFlush: public LogFlush
+{
+private:
+    std::string file_path_;
+    size_t flush_log_;
+    int fd_;
+    size_t window_size_;    //映射窗口的大小，页大小的整数倍
+    char* window_;          //当前映射的窗口
+    uint64_t window_off_;   //当前窗口在文件中的偏移
+    uint64_t offset_;       //下一个字节写入的位置
+    uint64_t synced_;       //之前的数据已经按照flush_log_的策略同步
+    std::unique_ptr<FileFlush>fallback_;    //不能安全地使用内存映射时使用
+
+    static size_t pageSize()
+    {
+        static const size_t page=static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return page;
+    }
+
+    //崩溃之后文件末尾是预分配的0字节，从后往前找到最后一个非0字节
+    uint64_t dataLength(uint64_t file_size)
+    {
+        char block[64*1024];
+        uint64_t end=file_size;
+        while(end>0)
+        {
+            uint64_t begin= end>sizeof(block) ? end-sizeof(block) : 0;
+            ssize_t n=::pread(fd_,block,end-begin,begin);
+            if(n<=0) return end;
+            for(ssize_t i=n;i>0;--i)
+            {
+                if(block[i-1]!='\0') return begin+i;
+            }
+            end=begin;
+        }
+        return 0;
+    }
+
+    //按照flush_log_的策略同步[synced_,offset_)之间的数据
+    void syncData()
+    {
+        if(offset_==synced_) return;
+        if(flush_log_==1)
+        {
+            //只启动回写，不等待完成
+            if(::sync_file_range(fd_,synced_,offset_-synced_,SYNC_FILE_RANGE_WRITE)!=0)
+            {
+                ::perror("sync_file_range failed: ");
+            }
+        }
+        else if(flush_log_==2&&window_)
+        {
+            //只有当前窗口中的数据还没有同步，切换窗口之前已经同步了旧窗口
+            uint64_t begin=std::max(synced_,window_off_)/pageSize()*pageSize();
+            if(::msync(window_+(begin-window_off_),offset_-begin,MS_SYNC)!=0)
+            {
+                ::perror("msync failed: ");
+            }
+        }
+        synced_=offset_;
+    }
+
+    void unmapWindow()
+    {
+        if(!window_) return;
+        if(flush_log_==2) syncData();
+        ::munmap(window_,window_size_);
+        window_=nullptr;
+    }
+
+    //映射包含pos的窗口，必要时扩展文件
+    bool mapWindow(uint64_t pos)
+    {
+        unmapWindow();
+        uint64_t off=pos/window_size_*window_size_;
+        //分配失败(例如磁盘已满)时不映射，这批数据被丢弃
+        if(::fallocate(fd_,0,off,window_size_)!=0)
+        {
+            ::perror("fallocate failed: ");
+            return false;
+        }
+        void* addr=::mmap(nullptr,window_size_,PROT_READ|PROT_WRITE,MAP_SHARED,fd_,off);
+        if(addr==MAP_FAILED)
+        {
+            ::perror("mmap failed: ");
+            return false;
+        }
+        window_=static_cast<char*>(addr);
+        window_off_=off;
+        return true;
+    }
+
+    void write(const char* data,size_t len)
+    {
+        while(len>0)
+        {
+            if(!window_||offset_>=window_off_+window_size_)
+            {
+                if(!mapWindow(offset_)) return;
+            }
+            size_t n=std::min<uint64_t>(len,window_off_+window_size_-offset_);
+            std::memcpy(window_+(offset_-window_off_),data,n);
+            offset_+=n;
+            data+=n;
+            len-=n;
+        }
+    }
+
+public:
+    MmapFileFlush(std::string file_path,const Util::JsonUtil::JsonData&json_data)
+        :file_path_(file_path)
+        ,flush_log_(json_data.flush_log_)
+        ,fd_(-1)
+        ,window_size_(0)
+        ,window_(nullptr)
+        ,window_off_(0)
+        ,offset_(0)
+        ,synced_(0)
+    {
+        size_t window=std::max<size_t>(json_data.mmap_window_size_,1);
+        window_size_=(window+pageSize()-1)/pageSize()*pageSize();
+
+        Util::File::createDirectory(Util::File::folderPath(file_path));
+        fd_=::open(file_path.c_str(),O_RDWR|O_CREAT|O_CLOEXEC,0644);
+        if(fd_<0)
+        {
+            ::perror("open failed: ");
+            fallback_=std::make_unique<FileFlush>(file_path,json_data);
+            return;
+        }
+        struct stat st;
+        if(::fstat(fd_,&st)==0)
+        {
+            offset_=synced_=dataLength(static_cast<uint64_t>(st.st_size));
+        }
+        //预先分配第一个窗口，同时检查文件系统是否支持fallocate
+        if(::fallocate(fd_,0,offset_/window_size_*window_size_,window_size_)!=0&&(errno==EOPNOTSUPP||errno==ENOSYS))
+        {
+            ::close(fd_);
+            fd_=-1;
+            fallback_=std::make_unique<FileFlush>(file_path,json_data);
+        }
+    }
+
+    ~MmapFileFlush()override
+    {
+        if(fd_<0) return;
+        unmapWindow();
+        //去掉预分配但是没有写入的部分
+        if(::ftruncate(fd_,offset_)!=0)
+        {
+            ::perror("ftruncate failed: ");
+        }
+        ::close(fd_);
+    }
+
+    //是否在使用内存映射
+    inline bool usingMmap()const {return fallback_==nullptr;}
+
+    void flush(const char* data,size_t len)override
+    {
+        if(fallback_)
+        {
+            fallback_->flush(data,len);
+            return;
+        }
+        if(fd_<0) return;
+        write(data,len);
+        syncData();
+    }
+
+    //等待当前窗口的回写完成，之前的窗口中的数据由fdatasync落盘
+    void sync()override
+    {
+        if(fallback_)
+        {
+            fallback_->sync();
+            return;
+        }
+        if(fd_<0) return;
+        if(window_&&offset_>window_off_)
+        {
+            if(::msync(window_,offset_-window_off_,MS_SYNC)!=0)
+            {
+                ::perror("msync failed: ");
+            }
+        }
+        if(::fdatasync(fd_)!=0)
+        {
+            ::perror("fdatasync failed: ");
+        }
+        synced_=offset_;
+    }
+
+    //所有数据写入映射之后只同步一次
+    void flushv(const struct iovec* iov,int cnt)override
+    {
+        if(fallback_)
+        {
+            fallback_->flushv(iov,cnt);
+            return;
+        }
+        if(fd_<0) return;
+        for(int i=0;i<cnt;++i)
+        {
+            write(static_cast<const char*>(iov[i].iov_base),iov[i].iov_len);
+        }
+        syncData();
+    }
+};
+
+} // namespace asynclog
@@ -3,24 +3,82 @@
 #include <sstream>
 #include <any>
 #include "Manager.hpp"
+#include "RateLimit.hpp"
 
-std::shared_ptr<asynclog::AsyncLogger> DefaultLogger()
+inline const std::shared_ptr<asynclog::AsyncLogger>& DefaultLogger()
 {
     return asynclog::Manager::getInstance().getDefaultLogger();
 }
 
 
-#define LogDebug(logger,fmt,...) logger->debug(__FILE__,__LINE__,fmt,##__VA_ARGS__)
-#define LogWarn(logger,fmt,...) logger->warn(__FILE__,__LINE__,fmt,##__VA_ARGS__)
-#define LogInfo(logger,fmt,...) logger->info(__FILE__,__LINE__,fmt,##__VA_ARGS__)
-#define LogError(logger,fmt,...) logger->error(__FILE__,__LINE__,fmt,##__VA_ARGS__)
-#define LogFatal(logger,fmt,...) logger->fatal(__FILE__,__LINE__,fmt,##__VA_ARGS__)
+/* 先检查日志等级再求值参数，低于ASYNCLOG_MIN_LEVEL的日志在编译期被去掉，
+低于日志器运行时等级的日志不会求值参数也不会格式化
+宏展开为if-else语句，logger只求值一次，可以安全地放在if/else的分支中 */
+#define ASYNCLOG_LOG_IF(logger,level) \
+    if(auto&& _asynclog_logger=(logger);!(asynclog::LogLevel::enabled(level)&&_asynclog_logger->shouldLog(level))) {} \
+    else
 
-#define LogDefaultDebug(fmt,...) DefaultLogger->debug(__FILE__,__LINE__,fmt,##__VA_ARGS__)
-#define LogDefaultWarn(fmt,...) DefaultLogger->warn(__FILE__,__LINE__,fmt,##__VA_ARGS__)
-#define LogDefaultInfo(fmt,...) DefaultLogger->info(__FILE__,__LINE__,fmt,##__VA_ARGS__)
-#define LogDefaultError(fmt,...) DefaultLogger->error(__FILE__,__LINE__,fmt,##__VA_ARGS__)
-#define LogDefaultFatal(fmt,...) DefaultLogger->fatal(__FILE__,__LINE__,fmt,##__VA_ARGS__)
+/* 调用点的文件名、行号、等级和格式串保存在宏生成的静态CallSite中，只在第一次执行时构造并注册，
+之后每次执行只传递它的指针，不再构造字符串，二进制日志中只保存调用点的id，fmt必须是字符串字面量
+调用点可以通过CallSiteRegistry在运行时关闭，关闭之后不求值参数 */
+#define ASYNCLOG_SITE_LOG(logger,level,fmt,...) \
+    ASYNCLOG_LOG_IF(logger,level) \
+    if(static const asynclog::CallSite _asynclog_site(level,__FILE__,__LINE__,"" fmt);!_asynclog_site.enabled()) {} \
+    else _asynclog_logger->logSite(&_asynclog_site,##__VA_ARGS__)
+
+#define LogDebug(logger,fmt,...) ASYNCLOG_SITE_LOG(logger,asynclog::LogLevel::value::DEBUG,fmt,##__VA_ARGS__)
+#define LogWarn(logger,fmt,...) ASYNCLOG_SITE_LOG(logger,asynclog::LogLevel::value::WARN,fmt,##__VA_ARGS__)
+#define LogInfo(logger,fmt,...) ASYNCLOG_SITE_LOG(logger,asynclog::LogLevel::value::INFO,fmt,##__VA_ARGS__)
+#define LogError(logger,fmt,...) ASYNCLOG_SITE_LOG(logger,asynclog::LogLevel::value::ERROR,fmt,##__VA_ARGS__)
+#define LogFatal(logger,fmt,...) ASYNCLOG_SITE_LOG(logger,asynclog::LogLevel::value::FATAL,fmt,##__VA_ARGS__)
+
+/* 限流的日志宏，limiter是限流器的构造表达式，只在第一次执行时求值，状态保存在调用点的静态对象中
+被限流的调用不求值参数，之后第一条输出的日志之前先输出一条被丢弃条数的汇总记录，
+调用点之后一直没有输出时由日志器的后台线程定期输出汇总记录 */
+#define ASYNCLOG_LIMITED_LOG(logger,level,limiter,fmt,...) \
+    ASYNCLOG_LOG_IF(logger,level) \
+    if(static const asynclog::CallSite _asynclog_site(level,__FILE__,__LINE__,"" fmt);!_asynclog_site.enabled()) {} \
+    else if(static auto _asynclog_limiter=limiter;!_asynclog_limiter.allow()) _asynclog_logger->trackSuppressed(&_asynclog_site,_asynclog_limiter); \
+    else _asynclog_logger->logSuppressed(&_asynclog_site,_asynclog_limiter.takeSuppressed()), \
+        _asynclog_logger->logSite(&_asynclog_site,##__VA_ARGS__)
+
+//每n次输出一次
+#define LogDebugEvery(logger,n,fmt,...) ASYNCLOG_LIMITED_LOG(logger,asynclog::LogLevel::value::DEBUG,asynclog::EveryNLimiter(n),fmt,##__VA_ARGS__)
+#define LogInfoEvery(logger,n,fmt,...) ASYNCLOG_LIMITED_LOG(logger,asynclog::LogLevel::value::INFO,asynclog::EveryNLimiter(n),fmt,##__VA_ARGS__)
+#define LogWarnEvery(logger,n,fmt,...) ASYNCLOG_LIMITED_LOG(logger,asynclog::LogLevel::value::WARN,asynclog::EveryNLimiter(n),fmt,##__VA_ARGS__)
+#define LogErrorEvery(logger,n,fmt,...) ASYNCLOG_LIMITED_LOG(logger,asynclog::LogLevel::value::ERROR,asynclog::EveryNLimiter(n),fmt,##__VA_ARGS__)
+
+//每秒最多输出per_sec条
+#define LogDebugRateLimited(logger,per_sec,fmt,...) ASYNCLOG_LIMITED_LOG(logger,asynclog::LogLevel::value::DEBUG,asynclog::RateLimiter(per_sec),fmt,##__VA_ARGS__)
+#define LogInfoRateLimited(logger,per_sec,fmt,...) ASYNCLOG_LIMITED_LOG(logger,asynclog::LogLevel::value::INFO,asynclog::RateLimiter(per_sec),fmt,##__VA_ARGS__)
+#define LogWarnRateLimited(logger,per_sec,fmt,...) ASYNCLOG_LIMITED_LOG(logger,asynclog::LogLevel::value::WARN,asynclog::RateLimiter(per_sec),fmt,##__VA_ARGS__)
+#define LogErrorRateLimited(logger,per_sec,fmt,...) ASYNCLOG_LIMITED_LOG(logger,asynclog::LogLevel::value::ERROR,asynclog::RateLimiter(per_sec),fmt,##__VA_ARGS__)
+
+//令牌桶，平均每秒rate条，最多连续输出burst条
+#define LogDebugTokenBucket(logger,rate,burst,fmt,...) ASYNCLOG_LIMITED_LOG(logger,asynclog::LogLevel::value::DEBUG,asynclog::TokenBucketLimiter(rate,burst),fmt,##__VA_ARGS__)
+#define LogInfoTokenBucket(logger,rate,burst,fmt,...) ASYNCLOG_LIMITED_LOG(logger,asynclog::LogLevel::value::INFO,asynclog::TokenBucketLimiter(rate,burst),fmt,##__VA_ARGS__)
+#define LogWarnTokenBucket(logger,rate,burst,fmt,...) ASYNCLOG_LIMITED_LOG(logger,asynclog::LogLevel::value::WARN,asynclog::TokenBucketLimiter(rate,burst),fmt,##__VA_ARGS__)
+#define LogErrorTokenBucket(logger,rate,burst,fmt,...) ASYNCLOG_LIMITED_LOG(logger,asynclog::LogLevel::value::ERROR,asynclog::TokenBucketLimiter(rate,burst),fmt,##__VA_ARGS__)
+
+//类型安全的日志宏，fmt使用{}占位符，占位符个数在编译期检查
+#define LogDebugFmt(logger,fmt,...) ASYNCLOG_LOG_IF(logger,asynclog::LogLevel::value::DEBUG) _asynclog_logger->debugFmt(fmt,##__VA_ARGS__)
+#define LogWarnFmt(logger,fmt,...) ASYNCLOG_LOG_IF(logger,asynclog::LogLevel::value::WARN) _asynclog_logger->warnFmt(fmt,##__VA_ARGS__)
+#define LogInfoFmt(logger,fmt,...) ASYNCLOG_LOG_IF(logger,asynclog::LogLevel::value::INFO) _asynclog_logger->infoFmt(fmt,##__VA_ARGS__)
+#define LogErrorFmt(logger,fmt,...) ASYNCLOG_LOG_IF(logger,asynclog::LogLevel::value::ERROR) _asynclog_logger->errorFmt(fmt,##__VA_ARGS__)
+#define LogFatalFmt(logger,fmt,...) ASYNCLOG_LOG_IF(logger,asynclog::LogLevel::value::FATAL) _asynclog_logger->fatalFmt(fmt,##__VA_ARGS__)
+
+//二进制日志宏，和LogDebug等宏相同，日志器开启binary_log时记录中只保存调用点的id和参数
+#define LogBinDebug(logger,fmt,...) LogDebug(logger,fmt,##__VA_ARGS__)
+#define LogBinWarn(logger,fmt,...) LogWarn(logger,fmt,##__VA_ARGS__)
+#define LogBinInfo(logger,fmt,...) LogInfo(logger,fmt,##__VA_ARGS__)
+#define LogBinError(logger,fmt,...) LogError(logger,fmt,##__VA_ARGS__)
+#define LogBinFatal(logger,fmt,...) LogFatal(logger,fmt,##__VA_ARGS__)
+
+#define LogDefaultDebug(fmt,...) LogDebug(DefaultLogger(),fmt,##__VA_ARGS__)
+#define LogDefaultWarn(fmt,...) LogWarn(DefaultLogger(),fmt,##__VA_ARGS__)
+#define LogDefaultInfo(fmt,...) LogInfo(DefaultLogger(),fmt,##__VA_ARGS__)
+#define LogDefaultError(fmt,...) LogError(DefaultLogger(),fmt,##__VA_ARGS__)
+#define LogDefaultFatal(fmt,...) LogFatal(DefaultLogger(),fmt,##__VA_ARGS__)
 
 enum class LogLevel {
     DEBUG = 1,
@@ -34,11 +92,17 @@ struct LOG
 {
     std::stringstream ss_;
     std::shared_ptr<asynclog::AsyncLogger>logger_;
-    LogLevel level_;
+    ::LogLevel level_;
     const char* file_;
     size_t line_;
 
-    LOG(std::shared_ptr<asynclog::AsyncLogger>logger,LogLevel level,const char* file, int line)
+    //转换为日志系统内部的日志等级
+    static constexpr asynclog::LogLevel::value toLevel(::LogLevel level)
+    {
+        return static_cast<asynclog::LogLevel::value>(static_cast<int>(level)-static_cast<int>(::LogLevel::DEBUG));
+    }
+
+    LOG(std::shared_ptr<asynclog::AsyncLogger>logger,::LogLevel level,const char* file, int line)
         :logger_(logger)
         ,level_(level)
         ,file_(file)
@@ -48,34 +112,34 @@ struct LOG
     {
         switch (level_)
         {
-        case LogLevel::DEBUG:
+        case ::LogLevel::DEBUG:
         {
-            logger_->debug(file_,line_,ss_.str());
+            logger_->debug(file_,line_,"%s",ss_.str().c_str());
             break;
         }
-        case LogLevel::INFO:
+        case ::LogLevel::INFO:
         {
-            logger_->info(file_,line_,ss_.str());
+            logger_->info(file_,line_,"%s",ss_.str().c_str());
             break;
         }
-        case LogLevel::WARN:
+        case ::LogLevel::WARN:
         {
-            logger_->warn(file_,line_,ss_.str());
+            logger_->warn(file_,line_,"%s",ss_.str().c_str());
             break;
         }
-        case LogLevel::ERROR:
+        case ::LogLevel::ERROR:
         {
-            logger_->error(file_,line_,ss_.str());
+            logger_->error(file_,line_,"%s",ss_.str().c_str());
             break;
         }
-        case LogLevel::FATAL:
+        case ::LogLevel::FATAL:
         {
-            logger_->fatal(file_,line_,ss_.str());
+            logger_->fatal(file_,line_,"%s",ss_.str().c_str());
             break;
         }
         default:
         {
-            logger_->info(file_,line_,ss_.str());
+            logger_->info(file_,line_,"%s",ss_.str().c_str());
             break;
         }
         }
@@ -90,4 +154,4 @@ struct LOG
 
 };
 
-#define MYLOG(logger,level) LOG(logger,level,__FILE__,__LINE__)
+#define MYLOG(logger,level) ASYNCLOG_LOG_IF(logger,LOG::toLevel(level)) LOG(_asynclog_logger,level,__FILE__,__LINE__)
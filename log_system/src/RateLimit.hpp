@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace asynclog
+{
+
+/* 日志调用点的限流器，由LogXxxEvery、LogXxxRateLimited、LogXxxTokenBucket宏为每个调用点生成一个静态对象
+状态都保存在原子变量中，不加锁，被限流的调用只读取状态和增加计数，不会在日志风暴中反复写同一个状态
+allow返回true时调用takeSuppressed取出之前被限流的条数，由日志器输出一条汇总记录 */
+namespace RateLimit
+{
+    inline int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+} // namespace RateLimit
+
+//每n次输出一次(第1、n+1、2n+1...次)，被跳过的条数是确定的，所以不输出汇总记录
+class EveryNLimiter
+{
+private:
+    std::atomic<uint64_t>count_;
+    uint64_t n_;
+public:
+    explicit EveryNLimiter(uint64_t n)
+        :count_(0)
+        ,n_(n==0 ? 1 : n)
+    {}
+
+    inline bool allow()
+    {
+        return count_.fetch_add(1,std::memory_order_relaxed)%n_==0;
+    }
+
+    inline uint64_t takeSuppressed(){return 0;}
+};
+
+/* 被限流的条数，allow返回true的调用取出并清零
+调用点在日志风暴之后一直没有再输出时，计数由最近使用的日志器(owner_)的后台线程定期取出并输出汇总记录 */
+class SuppressedCounter
+{
+protected:
+    std::atomic<uint64_t>suppressed_;
+    std::atomic<const void*>owner_;     //最近一次被限流时使用的日志器，只用于比较，不会解引用
+    std::atomic_bool registered_;       //是否已经登记到CallSiteRegistry
+
+    inline bool suppress()
+    {
+        suppressed_.fetch_add(1,std::memory_order_relaxed);
+        return false;
+    }
+
+public:
+    SuppressedCounter():suppressed_(0),owner_(nullptr),registered_(false){}
+
+    //大部分时候没有被限流的记录，先读取，避免每次都执行读改写
+    inline uint64_t takeSuppressed()
+    {
+        if(suppressed_.load(std::memory_order_relaxed)==0) return 0;
+        return suppressed_.exchange(0,std::memory_order_relaxed);
+    }
+
+    //被限流时记录使用的日志器，日志风暴中大部分调用只有两次读取，第一次调用返回true，由调用者登记
+    inline bool track(const void* owner)
+    {
+        if(owner_.load(std::memory_order_relaxed)!=owner) owner_.store(owner,std::memory_order_relaxed);
+        return !registered_.load(std::memory_order_relaxed)&&!registered_.exchange(true,std::memory_order_relaxed);
+    }
+
+    inline const void* owner()const {return owner_.load(std::memory_order_relaxed);}
+
+    //日志器析构时解除关联，之后的计数等下一次被限流的日志器输出
+    inline void release(const void* owner)
+    {
+        owner_.compare_exchange_strong(owner,nullptr,std::memory_order_relaxed);
+    }
+};
+
+/* 每秒最多输出per_sec条，按照固定的一秒窗口计数
+窗口编号(高32位)和窗口内的条数(低32位)放在同一个原子变量中，一次CAS同时完成换窗口和计数 */
+class RateLimiter: public SuppressedCounter
+{
+private:
+    static constexpr int64_t kWindowNs=1000000000LL;
+    std::atomic<uint64_t>state_;
+    uint32_t per_sec_;
+public:
+    explicit RateLimiter(uint32_t per_sec)
+        :state_(0)
+        ,per_sec_(per_sec)
+    {}
+
+    bool allow(int64_t now_ns)
+    {
+        if(per_sec_==0) return suppress();
+        //窗口编号从1开始，初始状态0不会和任何窗口相同
+        uint64_t window=static_cast<uint32_t>(now_ns/kWindowNs+1);
+        uint64_t state=state_.load(std::memory_order_relaxed);
+        while(true)
+        {
+            uint64_t next;
+            if(state>>32!=window) next=(window<<32)|1;
+            else if((state&0xffffffffu)<per_sec_) next=state+1;
+            else return suppress();
+
+            if(state_.compare_exchange_weak(state,next,std::memory_order_relaxed)) return true;
+        }
+    }
+
+    inline bool allow(){return allow(RateLimit::nowNs());}
+};
+
+/* 令牌桶: 平均每秒rate条，最多连续输出burst条，rate不大于0时不输出
+使用GCRA算法，只保存下一条记录理论上的到达时间tat_，令牌数由tat_和当前时间的差值推算，
+tat_超过当前时间(burst-1)个间隔时说明令牌已经用完 */
+class TokenBucketLimiter: public SuppressedCounter
+{
+private:
+    std::atomic<int64_t>tat_;
+    int64_t interval_ns_;   //产生一个令牌的时间
+    int64_t tolerance_ns_;  //允许tat_超前当前时间的上限
+public:
+    TokenBucketLimiter(double rate,uint32_t burst)
+        :tat_(0)
+        ,interval_ns_(rate>0 ? static_cast<int64_t>(1e9/rate) : 0)
+        ,tolerance_ns_(rate>0 ? interval_ns_*static_cast<int64_t>(burst>0 ? burst-1 : 0) : -1)
+    {}
+
+    bool allow(int64_t now_ns)
+    {
+        int64_t tat=tat_.load(std::memory_order_relaxed);
+        while(true)
+        {
+            int64_t base= tat>now_ns ? tat : now_ns;
+            if(base-now_ns>tolerance_ns_) return suppress();
+            if(tat_.compare_exchange_weak(tat,base+interval_ns_,std::memory_order_relaxed)) return true;
+        }
+    }
+
+    inline bool allow(){return allow(RateLimit::nowNs());}
+};
+
+} // namespace asynclog
@@ -0,0 +1,294 @@
+#pragma once
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef ASYNCLOG_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "Task.hpp"
+#include "Util.hpp"
+
+namespace asynclog
+{
+
+/* 滚动关闭的日志文件的压缩和保留策略，由RollFileFlush在滚动时调度
+所有工作都在日志器的线程池中执行，不占用后台刷新线程:
+先用zstd把关闭的文件压缩成.log.zst，再按保留时间和总大小删除(或者移动到归档目录)最旧的文件，
+执行期间线程的I/O优先级降为idle，压缩按照retention_cpu_percent_限制CPU占用，不和正在写入的日志争抢资源
+只处理序号小于当前文件的LOG_*-<序号>.log(.zst)，当前正在写入的文件永远不会被改动 */
+class RetentionManager: public std::enable_shared_from_this<RetentionManager>
+{
+private:
+    //一个滚动关闭的日志文件
+    struct Segment
+    {
+        std::filesystem::path path_;
+        size_t seq_;
+        uintmax_t size_;
+        std::filesystem::file_time_type mtime_;
+    };
+
+    //执行期间把当前线程的I/O优先级降为idle，结束时恢复
+    class IdleIoPriority
+    {
+    private:
+        static constexpr int kWhoProcess=1;     //IOPRIO_WHO_PROCESS，pid为0表示当前线程
+        static constexpr int kClassShift=13;
+        static constexpr int kClassIdle=3;
+        int old_;
+    public:
+        IdleIoPriority()
+            :old_(static_cast<int>(::syscall(SYS_ioprio_get,kWhoProcess,0)))
+        {
+            ::syscall(SYS_ioprio_set,kWhoProcess,0,kClassIdle<<kClassShift);
+        }
+        ~IdleIoPriority()
+        {
+            if(old_>=0) ::syscall(SYS_ioprio_set,kWhoProcess,0,old_);
+        }
+    };
+
+    static constexpr size_t kChunkSize=128*1024;   //每次读取和压缩的数据量
+
+    std::string folder_path_;
+    std::weak_ptr<Executor>pool_;
+    bool compress_;
+    int compress_level_;
+    size_t max_total_bytes_;
+    std::chrono::seconds max_age_;
+    std::string archive_dir_;
+    size_t cpu_percent_;
+
+    std::atomic<size_t>limit_;      //序号小于limit_的文件已经滚动关闭
+    std::atomic_bool scheduled_;    //线程池中已经有等待执行的任务
+    std::mutex sweep_mtx_;          //同一时间只有一个任务在处理目录
+
+    //解析LOG_<时间>-<序号>.log和LOG_<时间>-<序号>.log.zst，其它文件返回false
+    static bool parseSeq(std::string_view name,size_t& seq)
+    {
+        if(name.rfind("LOG_",0)!=0) return false;
+        if(name.size()>4&&name.compare(name.size()-4,4,".zst")==0) name.remove_suffix(4);
+        if(name.size()<4||name.compare(name.size()-4,4,".log")!=0) return false;
+        name.remove_suffix(4);
+        size_t dash=name.find_last_of('-');
+        if(dash==std::string_view::npos||dash+1>=name.size()) return false;
+        std::string_view num=name.substr(dash+1);
+        if(num.find_first_not_of("0123456789")!=std::string_view::npos) return false;
+        seq=std::stoul(std::string(num));
+        return true;
+    }
+
+    //列出序号小于limit的文件，按序号从旧到新排列
+    std::vector<Segment> listSegments(size_t limit)
+    {
+        std::vector<Segment>segments;
+        std::error_code ec;
+        for(auto it=std::filesystem::directory_iterator(folder_path_,ec);!ec&&it!=std::filesystem::directory_iterator();it.increment(ec))
+        {
+            size_t seq=0;
+            if(!it->is_regular_file(ec)||!parseSeq(it->path().filename().string(),seq)||seq>=limit) continue;
+            Segment segment{it->path(),seq,it->file_size(ec),it->last_write_time(ec)};
+            if(!ec) segments.push_back(std::move(segment));
+        }
+        std::sort(segments.begin(),segments.end(),[](const Segment& a,const Segment& b){
+            return a.seq_<b.seq_;
+        });
+        return segments;
+    }
+
+    //按照cpu_percent_的限制，在使用了cpu_time的CPU时间之后休眠
+    void throttle(std::chrono::nanoseconds cpu_time)const
+    {
+        if(cpu_percent_==0||cpu_percent_>=100) return;
+        std::this_thread::sleep_for(cpu_time*(100-cpu_percent_)/cpu_percent_);
+    }
+
+    static std::chrono::nanoseconds threadCpuTime()
+    {
+        struct timespec ts;
+        ::clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts);
+        return std::chrono::seconds(ts.tv_sec)+std::chrono::nanoseconds(ts.tv_nsec);
+    }
+
+#ifdef ASYNCLOG_WITH_ZSTD
+    //把segment压缩成.zst文件，先写入临时文件，完成之后再替换原文件，压缩文件保留原文件的修改时间
+    bool compressSegment(Segment& segment)
+    {
+        std::filesystem::path out_path=segment.path_;
+        out_path+=".zst";
+        std::filesystem::path tmp_path=out_path;
+        tmp_path+=".tmp";
+
+        std::ifstream in(segment.path_,std::ios::binary);
+        std::ofstream out(tmp_path,std::ios::binary|std::ios::trunc);
+        if(!in||!out) return false;
+
+        std::unique_ptr<ZSTD_CCtx,size_t(*)(ZSTD_CCtx*)>cctx(ZSTD_createCCtx(),ZSTD_freeCCtx);
+        if(!cctx) return false;
+        ZSTD_CCtx_setParameter(cctx.get(),ZSTD_c_compressionLevel,compress_level_);
+
+        std::vector<char>in_buf(kChunkSize);
+        std::vector<char>out_buf(ZSTD_CStreamOutSize());
+        bool ok=true;
+        while(ok)
+        {
+            auto start=threadCpuTime();
+            in.read(in_buf.data(),in_buf.size());
+            size_t n=static_cast<size_t>(in.gcount());
+            ZSTD_EndDirective mode= in.eof() ? ZSTD_e_end : ZSTD_e_continue;
+            ZSTD_inBuffer input{in_buf.data(),n,0};
+            bool finished=false;
+            while(!finished)
+            {
+                ZSTD_outBuffer output{out_buf.data(),out_buf.size(),0};
+                size_t remaining=ZSTD_compressStream2(cctx.get(),&output,&input,mode);
+                if(ZSTD_isError(remaining))
+                {
+                    ::fprintf(stderr,"retention compress %s failed: %s\n",segment.path_.c_str(),ZSTD_getErrorName(remaining));
+                    ok=false;
+                    break;
+                }
+                out.write(out_buf.data(),output.pos);
+                //e_end要等到帧完全写出，e_continue只需要消耗完输入
+                finished= mode==ZSTD_e_end ? remaining==0 : input.pos==input.size;
+            }
+            throttle(threadCpuTime()-start);
+            if(mode==ZSTD_e_end) break;
+        }
+        out.close();
+
+        std::error_code ec;
+        if(!ok||!out||in.bad())
+        {
+            std::filesystem::remove(tmp_path,ec);
+            return false;
+        }
+        std::filesystem::last_write_time(tmp_path,segment.mtime_,ec);
+        std::filesystem::rename(tmp_path,out_path,ec);
+        if(ec)
+        {
+            std::filesystem::remove(tmp_path,ec);
+            return false;
+        }
+        std::filesystem::remove(segment.path_,ec);
+        segment.path_=out_path;
+        segment.size_=std::filesystem::file_size(out_path,ec);
+        return true;
+    }
+#endif
+
+    //删除文件，配置了归档目录时移动到归档目录中
+    void retire(const Segment& segment)
+    {
+        std::error_code ec;
+        if(archive_dir_.empty())
+        {
+            std::filesystem::remove(segment.path_,ec);
+            return;
+        }
+        std::filesystem::create_directories(archive_dir_,ec);
+        std::filesystem::path target=std::filesystem::path(archive_dir_)/segment.path_.filename();
+        std::filesystem::rename(segment.path_,target,ec);
+        if(ec)
+        {
+            //跨文件系统时rename失败，改为拷贝之后删除
+            ec.clear();
+            std::filesystem::copy_file(segment.path_,target,std::filesystem::copy_options::overwrite_existing,ec);
+            if(!ec) std::filesystem::remove(segment.path_,ec);
+        }
+    }
+
+public:
+    RetentionManager(const std::string& folder_path,const Util::JsonUtil::JsonData& json_data)
+        :folder_path_(folder_path)
+        ,compress_(json_data.retention_compress_)
+        ,compress_level_(json_data.retention_compress_level_)
+        ,max_total_bytes_(json_data.retention_max_total_bytes_)
+        ,max_age_(json_data.retention_max_age_sec_)
+        ,archive_dir_(json_data.retention_archive_dir_)
+        ,cpu_percent_(json_data.retention_cpu_percent_)
+        ,limit_(0)
+        ,scheduled_(false)
+    {}
+
+    //配置中是否开启了任何一项保留策略
+    static bool enabled(const Util::JsonUtil::JsonData& json_data)
+    {
+        return json_data.retention_compress_||json_data.retention_max_total_bytes_>0
+            ||json_data.retention_max_age_sec_>0;
+    }
+
+    //执行任务的线程池，只保存弱引用，线程池销毁之后不再调度
+    void setThreadPool(std::shared_ptr<Executor>pool)
+    {
+        pool_=pool;
+        schedule(limit_.load());
+    }
+
+    /* 序号小于limit的文件已经滚动关闭，在线程池中处理它们
+    线程池中已经有等待执行的任务时只更新limit_，不重复提交，线程池队列已满时等下一次滚动再提交 */
+    void schedule(size_t limit)
+    {
+        size_t old=limit_.load();
+        while(old<limit&&!limit_.compare_exchange_weak(old,limit)){}
+        auto pool=pool_.lock();
+        if(!pool||limit_.load()==0||scheduled_.exchange(true)) return;
+        auto self=shared_from_this();
+        if(!pool->post([self](){
+            self->scheduled_.store(false);
+            self->sweep(self->limit_.load());
+        }))
+        {
+            scheduled_.store(false);
+        }
+    }
+
+    //压缩并清理序号小于limit的文件，可以直接调用(测试使用)
+    void sweep(size_t limit)
+    {
+        std::lock_guard<std::mutex>lock(sweep_mtx_);
+        IdleIoPriority io_priority;
+
+        auto segments=listSegments(limit);
+#ifdef ASYNCLOG_WITH_ZSTD
+        if(compress_)
+        {
+            for(auto& segment:segments)
+            {
+                if(segment.path_.extension()==".log") compressSegment(segment);
+            }
+        }
+#endif
+
+        auto now=std::filesystem::file_time_type::clock::now();
+        uintmax_t total=0;
+        for(auto& segment:segments) total+=segment.size_;
+        //从最旧的文件开始，超过保留时间或者总大小超过上限时清理
+        for(auto& segment:segments)
+        {
+            bool expired=max_age_.count()>0&&now-segment.mtime_>max_age_;
+            bool oversize=max_total_bytes_>0&&total>max_total_bytes_;
+            if(!expired&&!oversize) continue;
+            retire(segment);
+            total-=segment.size_;
+        }
+    }
+};
+
+} // namespace asynclog
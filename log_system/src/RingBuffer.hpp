@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#include "AsyncBuffer.hpp"
+
+namespace asynclog
+{
+
+/* 有界的多生产者单消费者字节环形缓冲区
+生产者通过CAS移动reserve_pos_预留一段空间(reserve)，拷贝完数据之后再写入记录头(commit)，
+消费者按顺序读取已经提交的记录，读取之后推进read_pos_归还空间，整个过程不需要加锁 */
+class MpscRingBuffer
+{
+private:
+    //记录头: 高位为数据长度，低两位为标志位，值为0说明该记录还没有提交
+    static constexpr uint64_t kCommitted=1;
+    static constexpr uint64_t kPadding=2;
+    static constexpr size_t kHeaderSize=sizeof(uint64_t);
+    static constexpr size_t kAlign=8;
+
+    std::unique_ptr<uint64_t[]>storage_;    //使用uint64_t保证记录头8字节对齐
+    char* data_;
+    size_t capacity_;                       //缓冲区的容量(2的幂)
+    size_t mask_;
+
+    alignas(64) std::atomic<uint64_t> reserve_pos_;    //生产者预留到的位置(单调递增)
+    alignas(64) std::atomic<uint64_t> read_pos_;       //消费者读取到的位置(单调递增)
+
+    static inline size_t alignUp(size_t n){return (n+kAlign-1)&~(kAlign-1);}
+
+    inline std::atomic_ref<uint64_t> header(uint64_t pos)
+    {
+        return std::atomic_ref<uint64_t>(*reinterpret_cast<uint64_t*>(data_+(pos&mask_)));
+    }
+
+public:
+    explicit MpscRingBuffer(size_t capacity)
+        :capacity_(4096)
+        ,reserve_pos_(0)
+        ,read_pos_(0)
+    {
+        //容量向上取整为2的幂，方便用掩码计算偏移
+        while(capacity_<capacity)
+        {
+            capacity_*=2;
+        }
+        mask_=capacity_-1;
+        storage_=std::make_unique<uint64_t[]>(capacity_/sizeof(uint64_t));
+        data_=reinterpret_cast<char*>(storage_.get());
+    }
+
+    MpscRingBuffer(const MpscRingBuffer&)=delete;
+    MpscRingBuffer& operator=(const MpscRingBuffer&)=delete;
+
+    inline size_t capacity()const {return capacity_;}
+
+    //已经被预留(包括尚未提交)的字节数
+    inline size_t usedBytes()const
+    {
+        return reserve_pos_.load(std::memory_order_acquire)-read_pos_.load(std::memory_order_acquire);
+    }
+
+    inline bool isEmpty()const {return usedBytes()==0;}
+
+    //当前预留到的位置，消费者可以用它作为本次读取的终点
+    inline uint64_t reservedPos()const {return reserve_pos_.load(std::memory_order_acquire);}
+
+    //线程安全，无锁；空间不足或者单条记录过大时返回false，由调用者走慢路径
+    bool tryPush(const char* data,size_t len)
+    {
+        size_t record=alignUp(kHeaderSize+len);
+        if(data==nullptr||record>capacity_/2) return false;
+
+        uint64_t pos=reserve_pos_.load(std::memory_order_relaxed);
+        size_t need;
+        size_t tail_room;
+        while(true)
+        {
+            //如果尾部放不下这条记录，则用一条填充记录占满尾部，从头开始写
+            tail_room=capacity_-(pos&mask_);
+            need= record<=tail_room ? record : tail_room+record;
+            if(pos+need-read_pos_.load(std::memory_order_acquire)>capacity_)
+            {
+                return false;
+            }
+            if(reserve_pos_.compare_exchange_weak(pos,pos+need,
+                std::memory_order_acq_rel,std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+
+        if(need!=record)
+        {
+            header(pos).store((uint64_t(tail_room)<<2)|kPadding|kCommitted,std::memory_order_release);
+            pos+=tail_room;
+        }
+        std::memcpy(data_+(pos&mask_)+kHeaderSize,data,len);
+        header(pos).store((uint64_t(len)<<2)|kCommitted,std::memory_order_release);
+        return true;
+    }
+
+    /* 只能由消费者线程调用，把[read_pos_,end)之间的记录按顺序写入out(Buffer或者ChunkBuffer)
+    如果某条记录已经预留但还没有提交，说明生产者正在拷贝数据，等待它提交即可 */
+    template<typename Out>
+    size_t drainTo(Out& out,uint64_t end)
+    {
+        uint64_t pos=read_pos_.load(std::memory_order_relaxed);
+        uint64_t start=pos;
+        while(pos<end)
+        {
+            uint64_t h=header(pos).load(std::memory_order_acquire);
+            while(h==0)
+            {
+                std::this_thread::yield();
+                h=header(pos).load(std::memory_order_acquire);
+            }
+
+            size_t len=h>>2;
+            size_t record;
+            if(h&kPadding)
+            {
+                record=len;
+            }
+            else
+            {
+                out.push(data_+(pos&mask_)+kHeaderSize,len);
+                record=alignUp(kHeaderSize+len);
+            }
+            //清空已经读取的区域，保证下一轮在这里预留的记录头在提交之前一定为0
+            std::memset(data_+(pos&mask_),0,record);
+            pos+=record;
+        }
+        read_pos_.store(pos,std::memory_order_release);
+        return pos-start;
+    }
+
+    template<typename Out>
+    size_t drainTo(Out& out){return drainTo(out,reservedPos());}
+};
+
+} // namespace asynclog
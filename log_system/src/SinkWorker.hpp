@@ -0,0 +1,260 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "AsyncBuffer.hpp"
+#include "ChunkBuffer.hpp"
+#include "LogFlush.hpp"
+#include "Util.hpp"
+
+namespace asynclog
+{
+
+/* 交给多个落地线程的一批数据
+后台线程把消费者缓冲区(连续缓冲区、分段缓冲区或者二进制模式下渲染出的文本)交换进来，不拷贝数据，
+所有落地线程共享只读，最后一个引用释放时清空并归还给SinkBatchPool */
+struct SinkBatch
+{
+    explicit SinkBatch(const Util::JsonUtil::JsonData& config_data)
+        :buffer_(config_data)
+        ,chunks_(config_data)
+    {}
+
+    void clear()
+    {
+        buffer_.reset();
+        chunks_.reset();
+        text_.clear();
+        iov_.clear();
+    }
+
+    Buffer buffer_;
+    ChunkBuffer chunks_;
+    std::string text_;
+    std::vector<struct iovec>iov_;  //数据所在的各段，落地线程按顺序写入
+};
+
+//复用SinkBatch，避免每批数据重新分配缓冲区，只保留少量空闲的批次，其余的直接释放
+class SinkBatchPool: public std::enable_shared_from_this<SinkBatchPool>
+{
+private:
+    static constexpr size_t kMaxFree=4;
+
+    std::mutex mtx_;
+    std::vector<std::unique_ptr<SinkBatch>>free_;
+    Util::JsonUtil::JsonData config_data_;
+
+    void release(SinkBatch* batch)
+    {
+        batch->clear();
+        std::lock_guard<std::mutex>lock(mtx_);
+        if(free_.size()<kMaxFree)
+        {
+            free_.emplace_back(batch);
+            return;
+        }
+        delete batch;
+    }
+
+public:
+    explicit SinkBatchPool(const Util::JsonUtil::JsonData& config_data)
+        :config_data_(config_data)
+    {
+        //只有连续缓冲区的文本模式会把消费者缓冲区交换进来，其它模式不需要预先分配buffer_size_
+        if(config_data_.chunk_size_>0||config_data_.binary_log_)
+        {
+            config_data_.buffer_size_=std::min<size_t>(config_data_.buffer_size_,4096);
+        }
+    }
+
+    //取出一个空的批次，引用计数归零时自动归还
+    std::shared_ptr<SinkBatch> acquire()
+    {
+        SinkBatch* batch=nullptr;
+        {
+            std::lock_guard<std::mutex>lock(mtx_);
+            if(!free_.empty())
+            {
+                batch=free_.back().release();
+                free_.pop_back();
+            }
+        }
+        if(!batch) batch=new SinkBatch(config_data_);
+        std::weak_ptr<SinkBatchPool>pool=weak_from_this();
+        return std::shared_ptr<SinkBatch>(batch,[pool](SinkBatch* b){
+            if(auto p=pool.lock())
+            {
+                p->release(b);
+                return;
+            }
+            delete b;
+        });
+    }
+};
+
+//落地线程的队列满时的处理: 阻塞后台线程等待，或者这个落地方向丢弃这一批数据
+enum class SinkOverflow
+{
+    BLOCK,
+    DROP
+};
+
+//配置中的"block"/"drop"转换为枚举，无法识别时返回false
+inline bool sinkOverflowFromString(std::string_view str,SinkOverflow& policy)
+{
+    if(str=="block") policy=SinkOverflow::BLOCK;
+    else if(str=="drop") policy=SinkOverflow::DROP;
+    else return false;
+    return true;
+}
+
+/* 一个落地方向独占的线程
+AsyncLogger的后台线程把每一批数据放入每个SinkWorker的队列之后立即返回，慢的落地方向(远程备份、每批fsync的文件)
+不会拖慢其它落地方向，也不会推迟下一次交换缓冲区，队列长度达到sink_queue_size_时按照SinkOverflow处理
+sync请求和数据一起排队，保证落盘的时候之前的批次已经写入 */
+class SinkWorker
+{
+private:
+    //队列中的一项，batch_为空时表示序号为sync_seq_的sync请求
+    struct Item
+    {
+        std::shared_ptr<const SinkBatch>batch_;
+        uint64_t sync_seq_;
+    };
+
+    std::shared_ptr<LogFlush>sink_;
+    size_t max_queue_;
+    SinkOverflow overflow_;
+
+    std::mutex mtx_;
+    std::condition_variable cond_worker_;   //队列中有数据或者停止
+    std::condition_variable cond_space_;    //队列中有空位或者sync完成
+    std::deque<Item>queue_;
+    size_t batches_;                        //队列中的批次数，不包括sync请求
+    bool stop_;
+    uint64_t sync_requested_;
+    uint64_t sync_done_;
+    std::atomic<uint64_t>dropped_;          //因为队列已满丢弃的批次数
+    std::thread thread_;
+
+    void threadEntry()
+    {
+        std::unique_lock<std::mutex>lock(mtx_);
+        while(true)
+        {
+            cond_worker_.wait(lock,[this](){return stop_||!queue_.empty();});
+            if(queue_.empty()) return;
+            Item item=std::move(queue_.front());
+            queue_.pop_front();
+            bool is_sync=!item.batch_;
+            if(!is_sync) --batches_;
+            lock.unlock();
+            cond_space_.notify_all();
+
+            if(!is_sync)
+            {
+                auto& iov=item.batch_->iov_;
+                sink_->flushv(iov.data(),static_cast<int>(iov.size()));
+                //在锁外释放引用，最后一个落地线程负责回收
+                item.batch_.reset();
+            }
+            else
+            {
+                sink_->sync();
+            }
+
+            lock.lock();
+            if(is_sync&&item.sync_seq_>sync_done_)
+            {
+                sync_done_=item.sync_seq_;
+                cond_space_.notify_all();
+            }
+        }
+    }
+
+public:
+    SinkWorker(std::shared_ptr<LogFlush>sink,const Util::JsonUtil::JsonData& config_data)
+        :sink_(std::move(sink))
+        ,max_queue_(std::max<size_t>(config_data.sink_queue_size_,1))
+        ,overflow_(SinkOverflow::BLOCK)
+        ,batches_(0)
+        ,stop_(false)
+        ,sync_requested_(0)
+        ,sync_done_(0)
+        ,dropped_(0)
+    {
+        if(!sinkOverflowFromString(config_data.sink_overflow_,overflow_))
+        {
+            overflow_=SinkOverflow::BLOCK;
+        }
+        thread_=std::thread([this](){threadEntry();});
+    }
+
+    //写完队列中剩余的数据之后退出
+    ~SinkWorker()
+    {
+        {
+            std::lock_guard<std::mutex>lock(mtx_);
+            stop_=true;
+        }
+        cond_worker_.notify_one();
+        thread_.join();
+    }
+
+    SinkWorker(const SinkWorker&)=delete;
+    SinkWorker& operator=(const SinkWorker&)=delete;
+
+    //放入一批数据，队列已满时按照overflow_阻塞或者丢弃，丢弃时返回false
+    bool push(std::shared_ptr<const SinkBatch>batch)
+    {
+        std::unique_lock<std::mutex>lock(mtx_);
+        if(batches_>=max_queue_)
+        {
+            if(overflow_==SinkOverflow::DROP)
+            {
+                dropped_.fetch_add(1,std::memory_order_relaxed);
+                return false;
+            }
+            cond_space_.wait(lock,[this](){return batches_<max_queue_;});
+        }
+        queue_.push_back(Item{std::move(batch),0});
+        ++batches_;
+        lock.unlock();
+        cond_worker_.notify_one();
+        return true;
+    }
+
+    //登记一次sync请求(不会被丢弃)，返回的序号交给waitSync
+    uint64_t requestSync()
+    {
+        std::unique_lock<std::mutex>lock(mtx_);
+        uint64_t seq=++sync_requested_;
+        queue_.push_back(Item{nullptr,seq});
+        lock.unlock();
+        cond_worker_.notify_one();
+        return seq;
+    }
+
+    //等待之前的批次写入并且落盘
+    void waitSync(uint64_t seq)
+    {
+        std::unique_lock<std::mutex>lock(mtx_);
+        cond_space_.wait(lock,[this,seq](){return sync_done_>=seq;});
+    }
+
+    inline uint64_t dropped()const {return dropped_.load(std::memory_order_relaxed);}
+};
+
+} // namespace asynclog
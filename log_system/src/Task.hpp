@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace asynclog
+{
+
+/* 只能移动的任务，代替std::function<void()>
+可调用对象不超过kInlineSize并且可以无异常移动时直接存放在对象内部，不申请堆内存，
+捕获了packaged_task、unique_ptr等只能移动的对象的lambda也可以放入 */
+class Task
+{
+private:
+    static constexpr size_t kInlineSize=6*sizeof(void*);
+
+    //按照可调用对象的类型生成的操作表
+    struct Ops
+    {
+        void (*invoke_)(void* storage);
+        void (*move_)(void* dst,void* src);     //移动到dst之后析构src
+        void (*destroy_)(void* storage);
+    };
+
+    template<typename F>
+    static constexpr bool kFitsInline=sizeof(F)<=kInlineSize&&alignof(F)<=alignof(std::max_align_t)
+        &&std::is_nothrow_move_constructible_v<F>;
+
+    template<typename F>
+    static const Ops* inlineOps()
+    {
+        static const Ops ops{
+            [](void* s){(*static_cast<F*>(s))();},
+            [](void* dst,void* src){
+                ::new(dst) F(std::move(*static_cast<F*>(src)));
+                static_cast<F*>(src)->~F();
+            },
+            [](void* s){static_cast<F*>(s)->~F();}
+        };
+        return &ops;
+    }
+
+    //放不下时在对象内部只保存指针
+    template<typename F>
+    static const Ops* heapOps()
+    {
+        static const Ops ops{
+            [](void* s){(**static_cast<F**>(s))();},
+            [](void* dst,void* src){*static_cast<F**>(dst)=*static_cast<F**>(src);},
+            [](void* s){delete *static_cast<F**>(s);}
+        };
+        return &ops;
+    }
+
+    alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+    const Ops* ops_;
+
+public:
+    Task():ops_(nullptr){}
+
+    template<typename F,typename D=std::decay_t<F>,
+        typename=std::enable_if_t<!std::is_same_v<D,Task>&&std::is_invocable_v<D&>>>
+    Task(F&& func)
+    {
+        if constexpr(kFitsInline<D>)
+        {
+            ::new(static_cast<void*>(storage_)) D(std::forward<F>(func));
+            ops_=inlineOps<D>();
+        }
+        else
+        {
+            ::new(static_cast<void*>(storage_)) D*(new D(std::forward<F>(func)));
+            ops_=heapOps<D>();
+        }
+    }
+
+    Task(Task&& other)noexcept
+        :ops_(other.ops_)
+    {
+        if(ops_) ops_->move_(storage_,other.storage_);
+        other.ops_=nullptr;
+    }
+
+    Task& operator=(Task&& other)noexcept
+    {
+        if(this!=&other)
+        {
+            reset();
+            ops_=other.ops_;
+            if(ops_) ops_->move_(storage_,other.storage_);
+            other.ops_=nullptr;
+        }
+        return *this;
+    }
+
+    Task(const Task&)=delete;
+    Task& operator=(const Task&)=delete;
+
+    ~Task(){reset();}
+
+    void reset()
+    {
+        if(ops_) ops_->destroy_(storage_);
+        ops_=nullptr;
+    }
+
+    inline explicit operator bool()const {return ops_!=nullptr;}
+
+    void operator()(){ops_->invoke_(storage_);}
+
+    //可调用对象是否直接存放在对象内部(测试使用)
+    template<typename F>
+    static constexpr bool storedInline(){return kFitsInline<std::decay_t<F>>;}
+};
+
+/* 执行任务的线程池的公共接口，日志器和落地方向只需要提交不关心结果的任务
+post不分配future，队列已满或者已经停止时返回false */
+class Executor
+{
+public:
+    virtual bool post(Task task)=0;
+    virtual ~Executor()=default;
+};
+
+} // namespace asynclog
@@ -11,17 +11,19 @@
 #include <memory>
 #include <optional>
 
+#include "Task.hpp"
+
 
 namespace asynclog
 {
-class ThreadPool
+class ThreadPool: public Executor
 {
 private:
     std::mutex mtx_;
     std::condition_variable cv_;
     std::atomic_bool started_;
     std::vector<std::thread>threads_;
-    std::queue<std::function<void()>>tasks_;
+    std::queue<Task>tasks_;
     std::size_t queue_size_;
 public:
     ThreadPool(size_t thread_num,size_t queue_num)
@@ -41,7 +43,7 @@ public:
                     //线程池停止同时所有任务都执行完毕，直接返回
                     if(!started_.load()&&tasks_.empty()) break;
 
-                    std::function<void()>task=tasks_.front();
+                    Task task=std::move(tasks_.front());
                     tasks_.pop();
                     lock.unlock();
                     
@@ -74,23 +76,32 @@ public:
         return started_.load();
     }
 
-    template<typename F,typename... Args>
-    auto enqueue(F&&func,Args&& ... args)->std::optional<std::future<std::invoke_result_t<F,Args...>>>
+    //提交不关心返回值的任务，不分配future
+    bool post(Task task)override
     {
-        using return_type = std::invoke_result_t<F,Args...>;
-
-        auto task = std::make_shared<std::packaged_task<return_type()>>(std::bind(std::forward<F>(func),std::forward<Args>(args)...));
-        std::optional<std::future<return_type>> ret(task->get_future());
-
         {
             std::lock_guard<std::mutex>lock(mtx_);
 
-            //队列已满或者是线程池已停止，返回空对象
-            if(tasks_.size()>=queue_size_||!started_) return std::nullopt;
+            //队列已满或者是线程池已停止
+            if(tasks_.size()>=queue_size_||!started_) return false;
 
-            tasks_.emplace([task](){(*task)();});
-            cv_.notify_one();
+            tasks_.push(std::move(task));
         }
+        cv_.notify_one();
+        return true;
+    }
+
+    template<typename F,typename... Args>
+    auto enqueue(F&&func,Args&& ... args)->std::optional<std::future<std::invoke_result_t<F,Args...>>>
+    {
+        using return_type = std::invoke_result_t<F,Args...>;
+
+        //Task可以保存只能移动的packaged_task，不需要再用shared_ptr包装
+        std::packaged_task<return_type()>task(std::bind(std::forward<F>(func),std::forward<Args>(args)...));
+        std::optional<std::future<return_type>> ret(task.get_future());
+
+        //队列已满或者是线程池已停止，返回空对象
+        if(!post([task=std::move(task)]()mutable{task();})) return std::nullopt;
 
         return ret;
     }
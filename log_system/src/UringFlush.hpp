@@ -0,0 +1,462 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define ASYNCLOG_HAS_IO_URING 1
+#else
+#define ASYNCLOG_HAS_IO_URING 0
+#endif
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "LogFlush.hpp"
+#include "Util.hpp"
+
+namespace asynclog
+{
+
+#if ASYNCLOG_HAS_IO_URING
+/* 最小的io_uring封装，直接使用系统调用，不依赖liburing
+只由一个线程(AsyncWorker的后台线程)使用，所以只需要和内核之间的内存序 */
+class IoUring
+{
+private:
+    int ring_fd_;
+    void* sq_ptr_;
+    size_t sq_size_;
+    void* cq_ptr_;
+    size_t cq_size_;
+    struct io_uring_sqe* sqes_;
+    size_t sqes_size_;
+
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned* sq_mask_;
+    unsigned* sq_array_;
+    unsigned sq_entries_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned* cq_mask_;
+    struct io_uring_cqe* cqes_;
+
+    unsigned local_tail_;   //已经填写的sqe的尾部
+    unsigned submitted_;    //已经提交给内核的sqe的尾部
+
+    void unmap()
+    {
+        if(sqes_) munmap(sqes_,sqes_size_);
+        if(cq_ptr_&&cq_ptr_!=sq_ptr_) munmap(cq_ptr_,cq_size_);
+        if(sq_ptr_) munmap(sq_ptr_,sq_size_);
+        sqes_=nullptr;
+        cq_ptr_=sq_ptr_=nullptr;
+    }
+
+public:
+    explicit IoUring(unsigned entries)
+        :ring_fd_(-1),sq_ptr_(nullptr),sq_size_(0),cq_ptr_(nullptr),cq_size_(0),sqes_(nullptr),sqes_size_(0)
+        ,sq_head_(nullptr),sq_tail_(nullptr),sq_mask_(nullptr),sq_array_(nullptr),sq_entries_(0)
+        ,cq_head_(nullptr),cq_tail_(nullptr),cq_mask_(nullptr),cqes_(nullptr)
+        ,local_tail_(0),submitted_(0)
+    {
+        struct io_uring_params params;
+        std::memset(&params,0,sizeof(params));
+        int fd=static_cast<int>(syscall(__NR_io_uring_setup,entries,&params));
+        if(fd<0) return;
+        //IORING_OP_WRITE和IORING_FEAT_RW_CUR_POS同时在5.6加入，用它判断内核是否支持写操作
+        if(!(params.features&IORING_FEAT_RW_CUR_POS))
+        {
+            ::close(fd);
+            return;
+        }
+
+        sq_size_=params.sq_off.array+params.sq_entries*sizeof(unsigned);
+        cq_size_=params.cq_off.cqes+params.cq_entries*sizeof(struct io_uring_cqe);
+        bool single_mmap=params.features&IORING_FEAT_SINGLE_MMAP;
+        if(single_mmap) sq_size_=cq_size_=std::max(sq_size_,cq_size_);
+
+        sq_ptr_=mmap(nullptr,sq_size_,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,fd,IORING_OFF_SQ_RING);
+        if(sq_ptr_==MAP_FAILED)
+        {
+            sq_ptr_=nullptr;
+            ::close(fd);
+            return;
+        }
+        if(single_mmap)
+        {
+            cq_ptr_=sq_ptr_;
+        }
+        else
+        {
+            cq_ptr_=mmap(nullptr,cq_size_,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,fd,IORING_OFF_CQ_RING);
+            if(cq_ptr_==MAP_FAILED)
+            {
+                cq_ptr_=nullptr;
+                unmap();
+                ::close(fd);
+                return;
+            }
+        }
+        sqes_size_=params.sq_entries*sizeof(struct io_uring_sqe);
+        void* sqes=mmap(nullptr,sqes_size_,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,fd,IORING_OFF_SQES);
+        if(sqes==MAP_FAILED)
+        {
+            unmap();
+            ::close(fd);
+            return;
+        }
+        sqes_=static_cast<struct io_uring_sqe*>(sqes);
+
+        char* sq=static_cast<char*>(sq_ptr_);
+        sq_head_=reinterpret_cast<unsigned*>(sq+params.sq_off.head);
+        sq_tail_=reinterpret_cast<unsigned*>(sq+params.sq_off.tail);
+        sq_mask_=reinterpret_cast<unsigned*>(sq+params.sq_off.ring_mask);
+        sq_array_=reinterpret_cast<unsigned*>(sq+params.sq_off.array);
+        sq_entries_=params.sq_entries;
+        char* cq=static_cast<char*>(cq_ptr_);
+        cq_head_=reinterpret_cast<unsigned*>(cq+params.cq_off.head);
+        cq_tail_=reinterpret_cast<unsigned*>(cq+params.cq_off.tail);
+        cq_mask_=reinterpret_cast<unsigned*>(cq+params.cq_off.ring_mask);
+        cqes_=reinterpret_cast<struct io_uring_cqe*>(cq+params.cq_off.cqes);
+
+        local_tail_=submitted_=*sq_tail_;
+        ring_fd_=fd;
+    }
+
+    ~IoUring()
+    {
+        unmap();
+        if(ring_fd_>=0) ::close(ring_fd_);
+    }
+
+    IoUring(const IoUring&)=delete;
+    IoUring& operator=(const IoUring&)=delete;
+
+    inline bool valid()const {return ring_fd_>=0;}
+
+    //获取一个空闲的sqe，提交队列满时返回nullptr
+    struct io_uring_sqe* getSqe()
+    {
+        unsigned head=__atomic_load_n(sq_head_,__ATOMIC_ACQUIRE);
+        if(local_tail_-head>=sq_entries_) return nullptr;
+        unsigned idx=local_tail_&*sq_mask_;
+        sq_array_[idx]=idx;
+        struct io_uring_sqe* sqe=&sqes_[idx];
+        std::memset(sqe,0,sizeof(*sqe));
+        ++local_tail_;
+        return sqe;
+    }
+
+    //提交所有填写好的sqe，wait_nr大于0时等待至少wait_nr个完成事件，失败时返回-errno
+    int submit(unsigned wait_nr)
+    {
+        __atomic_store_n(sq_tail_,local_tail_,__ATOMIC_RELEASE);
+        unsigned to_submit=local_tail_-submitted_;
+        unsigned flags= wait_nr>0 ? IORING_ENTER_GETEVENTS : 0;
+        while(true)
+        {
+            int ret=static_cast<int>(syscall(__NR_io_uring_enter,ring_fd_,to_submit,wait_nr,flags,nullptr,0));
+            if(ret>=0)
+            {
+                submitted_+=static_cast<unsigned>(ret);
+                return ret;
+            }
+            if(errno!=EINTR) return -errno;
+        }
+    }
+
+    //取出一个完成事件，没有时返回false
+    bool peekCqe(struct io_uring_cqe& out)
+    {
+        unsigned head=*cq_head_;
+        if(head==__atomic_load_n(cq_tail_,__ATOMIC_ACQUIRE)) return false;
+        out=cqes_[head&*cq_mask_];
+        __atomic_store_n(cq_head_,head+1,__ATOMIC_RELEASE);
+        return true;
+    }
+};
+#endif
+
+/* 基于io_uring的文件输出，写入和落盘都以异步请求提交，后台线程不会阻塞在页缓存回写中
+每批数据拷贝到一个槽位之后以IORING_OP_WRITE提交(flush_log_为2时链接一个IORING_OP_FSYNC)，
+最多同时有uring_queue_depth_个槽位在等待内核完成，槽位用完时才等待最早的完成事件，
+完成事件被取出之后槽位才会被回收复用，内核不支持io_uring或者打开文件失败时退化为FileFlush
+写入失败时重新提交，多次失败之后把文件截断到失败的位置，之后的数据从这里接着写，文件中不会留下空洞 */
+class UringFileFlush: public LogFlush
+{
+private:
+    std::unique_ptr<FileFlush>fallback_;    //内核不支持io_uring时使用
+
+#if ASYNCLOG_HAS_IO_URING
+    static constexpr uint64_t kFsyncTag=~0ULL;  //落盘请求的user_data
+    static constexpr uint64_t kNoTruncate=~0ULL;
+    static constexpr int kMaxRetries=3;         //一批数据写入失败时最多重新提交的次数
+
+    struct Slot
+    {
+        std::vector<char>data_;
+        size_t len_=0;          //这一批数据的长度
+        size_t done_=0;         //已经写入的长度
+        uint64_t offset_=0;     //写入文件的偏移
+        int retries_=0;         //写入失败之后已经重新提交的次数
+    };
+
+    std::string file_path_;
+    size_t flush_log_;
+    int fd_;
+    uint64_t offset_;                   //下一批数据写入的偏移
+    std::unique_ptr<IoUring>ring_;
+    std::vector<Slot>slots_;
+    std::vector<size_t>free_slots_;     //空闲的槽位
+    size_t inflight_;                   //等待完成的写请求数
+    size_t pending_fsync_;              //等待完成的落盘请求数
+    uint64_t truncate_at_;              //放弃写入的最小偏移，之后的数据需要截断，没有时为kNoTruncate
+
+    //提交槽位中剩余的数据
+    void submitSlot(size_t idx)
+    {
+        Slot& slot=slots_[idx];
+        struct io_uring_sqe* sqe=ring_->getSqe();
+        //提交队列的大小是槽位数的两倍，每个槽位最多占用两个sqe，所以不会失败
+        sqe->opcode=IORING_OP_WRITE;
+        sqe->fd=fd_;
+        sqe->addr=reinterpret_cast<uint64_t>(slot.data_.data()+slot.done_);
+        sqe->len=static_cast<uint32_t>(slot.len_-slot.done_);
+        sqe->off=slot.offset_+slot.done_;
+        sqe->user_data=idx;
+        if(flush_log_==2)
+        {
+            //写入成功之后才会执行落盘，写入失败或者部分写入时落盘请求以-ECANCELED完成
+            sqe->flags|=IOSQE_IO_LINK;
+            struct io_uring_sqe* fsync_sqe=ring_->getSqe();
+            fsync_sqe->opcode=IORING_OP_FSYNC;
+            fsync_sqe->fd=fd_;
+            fsync_sqe->fsync_flags=IORING_FSYNC_DATASYNC;
+            fsync_sqe->user_data=kFsyncTag;
+            ++pending_fsync_;
+        }
+        int ret=ring_->submit(0);
+        if(ret<0)
+        {
+            errno=-ret;
+            ::perror("io_uring_enter failed: ");
+        }
+    }
+
+    //处理所有已经完成的事件，wait为true时至少等待一个完成事件
+    void reap(bool wait)
+    {
+        if(wait)
+        {
+            int ret=ring_->submit(1);
+            if(ret<0)
+            {
+                errno=-ret;
+                ::perror("io_uring_enter failed: ");
+            }
+        }
+
+        struct io_uring_cqe cqe;
+        while(ring_->peekCqe(cqe))
+        {
+            if(cqe.user_data==kFsyncTag)
+            {
+                //被取消的落盘请求对应的写入会重新提交并链接新的落盘请求，放弃时在截断之后落盘
+                --pending_fsync_;
+                if(cqe.res<0&&cqe.res!=-ECANCELED)
+                {
+                    errno=-cqe.res;
+                    ::perror("io_uring fsync failed: ");
+                }
+                continue;
+            }
+
+            size_t idx=static_cast<size_t>(cqe.user_data);
+            Slot& slot=slots_[idx];
+            if(cqe.res==-EINTR||cqe.res==-EAGAIN)
+            {
+                submitSlot(idx);
+                continue;
+            }
+            if(cqe.res<=0)
+            {
+                errno= cqe.res<0 ? -cqe.res : EIO;
+                ::perror("io_uring write failed: ");
+                if(++slot.retries_<=kMaxRetries)
+                {
+                    submitSlot(idx);
+                    continue;
+                }
+                truncate_at_=std::min<uint64_t>(truncate_at_,slot.offset_+slot.done_);
+            }
+            else
+            {
+                slot.done_+=static_cast<size_t>(cqe.res);
+                //部分写入时继续提交剩余的数据
+                if(slot.done_<slot.len_)
+                {
+                    submitSlot(idx);
+                    continue;
+                }
+            }
+            --inflight_;
+            free_slots_.push_back(idx);
+        }
+    }
+
+    void drain()
+    {
+        while(inflight_>0||pending_fsync_>0)
+        {
+            reap(true);
+        }
+    }
+
+    /* 有一批数据放弃写入时，等待所有请求完成之后把文件截断到它的偏移，
+    之后的批次即使写入成功也一起丢弃，下一批数据从截断的位置接着写 */
+    void truncateFailed()
+    {
+        if(truncate_at_==kNoTruncate) return;
+        drain();
+        if(::ftruncate(fd_,static_cast<off_t>(truncate_at_))!=0)
+        {
+            ::perror("ftruncate failed: ");
+        }
+        else if(flush_log_==2&&::fdatasync(fd_)!=0)
+        {
+            ::perror("fdatasync failed: ");
+        }
+        offset_=truncate_at_;
+        truncate_at_=kNoTruncate;
+    }
+#endif
+
+public:
+    UringFileFlush(std::string file_path,const Util::JsonUtil::JsonData&json_data)
+#if ASYNCLOG_HAS_IO_URING
+        :file_path_(file_path)
+        ,flush_log_(json_data.flush_log_)
+        ,fd_(-1)
+        ,offset_(0)
+        ,inflight_(0)
+        ,pending_fsync_(0)
+        ,truncate_at_(kNoTruncate)
+#endif
+    {
+#if ASYNCLOG_HAS_IO_URING
+        size_t depth=json_data.uring_queue_depth_;
+        if(depth>0)
+        {
+            auto ring=std::make_unique<IoUring>(static_cast<unsigned>(depth*2));
+            if(ring->valid())
+            {
+                Util::File::createDirectory(Util::File::folderPath(file_path));
+                //不使用O_APPEND，每批数据写入显式的偏移，多个写请求同时进行时也不会乱序
+                fd_=::open(file_path.c_str(),O_WRONLY|O_CREAT|O_CLOEXEC,0644);
+                if(fd_>=0)
+                {
+                    offset_=static_cast<uint64_t>(::lseek(fd_,0,SEEK_END));
+                    ring_=std::move(ring);
+                    slots_.resize(depth);
+                    for(size_t i=depth;i>0;--i) free_slots_.push_back(i-1);
+                    return;
+                }
+                ::perror("open failed: ");
+            }
+        }
+#endif
+        fallback_=std::make_unique<FileFlush>(file_path,json_data);
+    }
+
+    ~UringFileFlush()override
+    {
+#if ASYNCLOG_HAS_IO_URING
+        if(ring_)
+        {
+            drain();
+            truncateFailed();
+        }
+        if(fd_>=0) ::close(fd_);
+#endif
+    }
+
+    //是否在使用io_uring
+    inline bool usingUring()const {return fallback_==nullptr;}
+
+    //等待所有写请求完成之后落盘
+    void sync()override
+    {
+        if(fallback_)
+        {
+            fallback_->sync();
+            return;
+        }
+#if ASYNCLOG_HAS_IO_URING
+        if(fd_<0) return;
+        if(ring_)
+        {
+            drain();
+            truncateFailed();
+        }
+        if(::fdatasync(fd_)!=0)
+        {
+            ::perror("fdatasync failed: ");
+        }
+#endif
+    }
+
+    void flush(const char* data,size_t len)override
+    {
+        struct iovec iov{const_cast<char*>(data),len};
+        flushv(&iov,1);
+    }
+
+    //拷贝到空闲的槽位之后提交，返回之后调用者的缓冲区就可以复用
+    void flushv(const struct iovec* iov,int cnt)override
+    {
+        if(fallback_)
+        {
+            fallback_->flushv(iov,cnt);
+            return;
+        }
+#if ASYNCLOG_HAS_IO_URING
+        if(fd_<0) return;
+        size_t total=0;
+        for(int i=0;i<cnt;++i) total+=iov[i].iov_len;
+        if(total==0) return;
+
+        //先回收已经完成的槽位，没有空闲槽位时等待
+        reap(false);
+        while(free_slots_.empty()) reap(true);
+        truncateFailed();
+        size_t idx=free_slots_.back();
+        free_slots_.pop_back();
+
+        Slot& slot=slots_[idx];
+        if(slot.data_.size()<total) slot.data_.resize(total);
+        size_t pos=0;
+        for(int i=0;i<cnt;++i)
+        {
+            std::memcpy(slot.data_.data()+pos,iov[i].iov_base,iov[i].iov_len);
+            pos+=iov[i].iov_len;
+        }
+        slot.len_=total;
+        slot.done_=0;
+        slot.retries_=0;
+        slot.offset_=offset_;
+        offset_+=total;
+        ++inflight_;
+        submitSlot(idx);
+#endif
+    }
+};
+
+} // namespace asynclog
@@ -290,6 +290,42 @@ struct JsonData
     std::string backup_addr_; //备份的服务器的ip地址
     uint16_t backup_port_; //备份服务器的端口号
     size_t thread_count_; //日志系统内部线程池的数量
+    size_t staging_size_; //线程本地暂存区的大小，达到该大小后一次性提交给AsyncWorker，为0时不使用暂存区
+    size_t staging_interval_ms_; //暂存区中最早的日志超过该时间(毫秒)后提交
+    bool binary_log_; //是否使用二进制日志，调用线程只拷贝参数，由后台线程格式化
+    std::string log_level_; //日志器的最低日志等级，低于该等级的日志直接丢弃
+    std::string timestamp_precision_; //时间戳的精度: s/ms/us/ns
+    size_t chunk_size_; //分段缓冲区每个块的大小，为0时使用连续的缓冲区
+    size_t pool_max_bytes_; //所有日志器共享的块池占用内存的上限，为0时不限制，多个日志器的设置不同时取非0的最小值
+    size_t pool_idle_ms_; //块池中的空闲块超过该时间(毫秒)没有使用则释放
+    size_t buffer_count_; //AsyncWorker中缓冲区的个数，大于2时写满的缓冲区排队等待消费者，生产者换上空闲缓冲区继续写
+    bool adaptive_flush_; //是否根据写入速率和落地耗时自适应地决定刷新时机
+    size_t flush_max_latency_ms_; //日志在缓冲区中停留的最长时间(毫秒)
+    size_t flush_max_batch_bytes_; //自适应刷新模式下每批数据的上限，为0时使用buffer_size_
+    std::string overflow_policy_; //LIMIT_SIZE模式下缓冲区满时的策略: reject/block/drop_low/evict_low
+    size_t overflow_block_ms_; //block策略下生产者最长的阻塞时间(毫秒)
+    size_t uring_queue_depth_; //UringFileFlush同时等待内核完成的批次数，为0时不使用io_uring
+    size_t mmap_window_size_; //MmapFileFlush每次映射的窗口大小
+    int zstd_level_;            //ZstdFileFlush的压缩等级
+    int zstd_workers_;          //ZstdFileFlush的压缩线程数，为0时在后台线程中压缩
+    bool zstd_frame_per_batch_; //ZstdFileFlush每批数据结束一个完整的帧，为false时只结束一个块
+    bool sink_threads_;         //每个落地方向是否使用独立的线程
+    size_t sink_queue_size_;    //每个落地线程最多排队的批次数
+    std::string sink_overflow_; //落地线程的队列满时的处理: block/drop
+    bool backup_enabled_;           //是否把ERROR/FATAL日志转发到备份服务器
+    size_t backup_queue_bytes_;     //等待转发的记录占用内存的上限
+    size_t backup_batch_bytes_;     //每批转发的数据量
+    std::string backup_spill_path_; //备份服务器不可用时记录写入的本地文件的前缀，每个客户端加上服务器地址、进程号和序号，为空时直接丢弃
+    size_t backup_spill_max_bytes_; //溢出文件的大小上限
+    size_t backup_retry_max_ms_;    //重连间隔(指数退避)的上限
+    std::string roll_interval_; //RollFileFlush按时间滚动的周期: none/hour/day
+    bool roll_preopen_; //RollFileFlush是否由辅助线程预先打开下一个文件
+    bool retention_compress_;           //是否用zstd压缩滚动关闭的日志文件
+    int retention_compress_level_;      //zstd的压缩等级
+    size_t retention_max_total_bytes_;  //滚动关闭的日志文件的总大小上限，为0时不限制
+    size_t retention_max_age_sec_;      //滚动关闭的日志文件保留的时间，为0时不限制
+    std::string retention_archive_dir_; //超出限制的文件移动到该目录，为空时直接删除
+    size_t retention_cpu_percent_;      //压缩最多占用一个核的CPU时间的百分比，为0或者100时不限制
 
     JsonData()
         :buffer_size_ ( 4 * 1024 * 1024) // 4MB
@@ -299,6 +335,42 @@ struct JsonData
         ,backup_addr_ ( "127.0.0.1")
         ,backup_port_ (8080)
         ,thread_count_ (1)
+        ,staging_size_ (0)
+        ,staging_interval_ms_ (100)
+        ,binary_log_ (false)
+        ,log_level_ ("DEBUG")
+        ,timestamp_precision_ ("s")
+        ,chunk_size_ (0)
+        ,pool_max_bytes_ (0)
+        ,pool_idle_ms_ (30000)
+        ,buffer_count_ (2)
+        ,adaptive_flush_ (false)
+        ,flush_max_latency_ms_ (3000)
+        ,flush_max_batch_bytes_ (0)
+        ,overflow_policy_ ("reject")
+        ,overflow_block_ms_ (100)
+        ,uring_queue_depth_ (4)
+        ,mmap_window_size_ (4*1024*1024)
+        ,zstd_level_ (3)
+        ,zstd_workers_ (0)
+        ,zstd_frame_per_batch_ (false)
+        ,sink_threads_ (false)
+        ,sink_queue_size_ (16)
+        ,sink_overflow_ ("block")
+        ,backup_enabled_ (false)
+        ,backup_queue_bytes_ (1024*1024)
+        ,backup_batch_bytes_ (64*1024)
+        ,backup_spill_path_ ("./backup_spill.bin")
+        ,backup_spill_max_bytes_ (64*1024*1024)
+        ,backup_retry_max_ms_ (5000)
+        ,roll_interval_ ("none")
+        ,roll_preopen_ (false)
+        ,retention_compress_ (false)
+        ,retention_compress_level_ (3)
+        ,retention_max_total_bytes_ (0)
+        ,retention_max_age_sec_ (0)
+        ,retention_archive_dir_ ("")
+        ,retention_cpu_percent_ (25)
     {}
 
     void loadConfig(const std::string&file_path)
@@ -326,6 +398,44 @@ struct JsonData
         backup_addr_=root["backup_addr"].asString();
         backup_port_=root["backup_port"].asUInt();
         thread_count_=root["thread_count"].asUInt64();
+
+        //以下为可选配置项，没有配置时保持默认值
+        if(root.isMember("staging_size")) staging_size_=root["staging_size"].asUInt64();
+        if(root.isMember("staging_interval_ms")) staging_interval_ms_=root["staging_interval_ms"].asUInt64();
+        if(root.isMember("binary_log")) binary_log_=root["binary_log"].asBool();
+        if(root.isMember("log_level")) log_level_=root["log_level"].asString();
+        if(root.isMember("timestamp_precision")) timestamp_precision_=root["timestamp_precision"].asString();
+        if(root.isMember("chunk_size")) chunk_size_=root["chunk_size"].asUInt64();
+        if(root.isMember("pool_max_bytes")) pool_max_bytes_=root["pool_max_bytes"].asUInt64();
+        if(root.isMember("pool_idle_ms")) pool_idle_ms_=root["pool_idle_ms"].asUInt64();
+        if(root.isMember("buffer_count")) buffer_count_=root["buffer_count"].asUInt64();
+        if(root.isMember("adaptive_flush")) adaptive_flush_=root["adaptive_flush"].asBool();
+        if(root.isMember("flush_max_latency_ms")) flush_max_latency_ms_=root["flush_max_latency_ms"].asUInt64();
+        if(root.isMember("flush_max_batch_bytes")) flush_max_batch_bytes_=root["flush_max_batch_bytes"].asUInt64();
+        if(root.isMember("overflow_policy")) overflow_policy_=root["overflow_policy"].asString();
+        if(root.isMember("overflow_block_ms")) overflow_block_ms_=root["overflow_block_ms"].asUInt64();
+        if(root.isMember("uring_queue_depth")) uring_queue_depth_=root["uring_queue_depth"].asUInt64();
+        if(root.isMember("mmap_window_size")) mmap_window_size_=root["mmap_window_size"].asUInt64();
+        if(root.isMember("zstd_level")) zstd_level_=root["zstd_level"].asInt();
+        if(root.isMember("zstd_workers")) zstd_workers_=root["zstd_workers"].asInt();
+        if(root.isMember("zstd_frame_per_batch")) zstd_frame_per_batch_=root["zstd_frame_per_batch"].asBool();
+        if(root.isMember("sink_threads")) sink_threads_=root["sink_threads"].asBool();
+        if(root.isMember("sink_queue_size")) sink_queue_size_=root["sink_queue_size"].asUInt64();
+        if(root.isMember("sink_overflow")) sink_overflow_=root["sink_overflow"].asString();
+        if(root.isMember("backup_enabled")) backup_enabled_=root["backup_enabled"].asBool();
+        if(root.isMember("backup_queue_bytes")) backup_queue_bytes_=root["backup_queue_bytes"].asUInt64();
+        if(root.isMember("backup_batch_bytes")) backup_batch_bytes_=root["backup_batch_bytes"].asUInt64();
+        if(root.isMember("backup_spill_path")) backup_spill_path_=root["backup_spill_path"].asString();
+        if(root.isMember("backup_spill_max_bytes")) backup_spill_max_bytes_=root["backup_spill_max_bytes"].asUInt64();
+        if(root.isMember("backup_retry_max_ms")) backup_retry_max_ms_=root["backup_retry_max_ms"].asUInt64();
+        if(root.isMember("roll_interval")) roll_interval_=root["roll_interval"].asString();
+        if(root.isMember("roll_preopen")) roll_preopen_=root["roll_preopen"].asBool();
+        if(root.isMember("retention_compress")) retention_compress_=root["retention_compress"].asBool();
+        if(root.isMember("retention_compress_level")) retention_compress_level_=root["retention_compress_level"].asInt();
+        if(root.isMember("retention_max_total_bytes")) retention_max_total_bytes_=root["retention_max_total_bytes"].asUInt64();
+        if(root.isMember("retention_max_age_sec")) retention_max_age_sec_=root["retention_max_age_sec"].asUInt64();
+        if(root.isMember("retention_archive_dir")) retention_archive_dir_=root["retention_archive_dir"].asString();
+        if(root.isMember("retention_cpu_percent")) retention_cpu_percent_=root["retention_cpu_percent"].asUInt64();
     }
 };
 
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "Task.hpp"
+
+namespace asynclog
+{
+
+/* 每个线程有自己的任务队列的线程池
+外部线程提交的任务轮流放入各个线程的队列，线程池内部的任务提交的任务放入当前线程的队列，
+线程从自己队列的头部取任务，自己的队列为空时从其它线程队列的尾部窃取，
+不同线程提交和执行任务时锁的是不同的队列，不会都竞争同一把锁
+只有存在休眠的线程时提交任务才需要唤醒，繁忙时提交只需要一次队列的加锁 */
+class WorkStealingPool: public Executor
+{
+private:
+    //一个线程的任务队列
+    struct Worker
+    {
+        std::mutex mtx_;
+        std::deque<Task>tasks_;
+    };
+
+    std::vector<std::unique_ptr<Worker>>workers_;
+    std::vector<std::thread>threads_;
+    std::mutex sleep_mtx_;
+    std::condition_variable cv_;
+    std::atomic<size_t>pending_;    //所有队列中的任务数
+    std::atomic<size_t>sleeping_;   //正在休眠的线程数
+    std::atomic<size_t>next_;       //外部线程提交任务时轮流选择队列
+    std::atomic_bool started_;
+    size_t max_tasks_;              //所有队列中任务数的上限
+
+    //当前线程所属的线程池和队列的下标，外部线程为空
+    static inline thread_local WorkStealingPool* local_pool_=nullptr;
+    static inline thread_local size_t local_index_=0;
+
+    bool popLocal(size_t idx,Task& task)
+    {
+        Worker& w=*workers_[idx];
+        std::lock_guard<std::mutex>lock(w.mtx_);
+        if(w.tasks_.empty()) return false;
+        task=std::move(w.tasks_.front());
+        w.tasks_.pop_front();
+        return true;
+    }
+
+    //从其它线程队列的尾部窃取一个任务
+    bool steal(size_t idx,Task& task)
+    {
+        for(size_t i=1;i<workers_.size();++i)
+        {
+            Worker& w=*workers_[(idx+i)%workers_.size()];
+            std::unique_lock<std::mutex>lock(w.mtx_,std::try_to_lock);
+            if(!lock.owns_lock()||w.tasks_.empty()) continue;
+            task=std::move(w.tasks_.back());
+            w.tasks_.pop_back();
+            return true;
+        }
+        return false;
+    }
+
+    void threadEntry(size_t idx)
+    {
+        local_pool_=this;
+        local_index_=idx;
+        while(true)
+        {
+            Task task;
+            if(popLocal(idx,task)||steal(idx,task))
+            {
+                pending_.fetch_sub(1);
+                task();
+                continue;
+            }
+            //线程池停止同时所有任务都执行完毕，直接返回
+            if(!started_.load()&&pending_.load()==0) break;
+
+            std::unique_lock<std::mutex>lock(sleep_mtx_);
+            sleeping_.fetch_add(1);
+            cv_.wait(lock,[this](){return pending_.load()>0||!started_.load();});
+            sleeping_.fetch_sub(1);
+        }
+        local_pool_=nullptr;
+    }
+
+public:
+    WorkStealingPool(size_t thread_num,size_t max_tasks)
+        :pending_(0)
+        ,sleeping_(0)
+        ,next_(0)
+        ,started_(true)
+        ,max_tasks_(max_tasks)
+    {
+        thread_num=std::max<size_t>(thread_num,1);
+        for(size_t i=0;i<thread_num;++i)
+        {
+            workers_.push_back(std::make_unique<Worker>());
+        }
+        for(size_t i=0;i<thread_num;++i)
+        {
+            threads_.emplace_back([this,i](){threadEntry(i);});
+        }
+    }
+
+    ~WorkStealingPool()
+    {
+        if(started_) stop();
+        for(auto&thread:threads_)
+        {
+            thread.join();
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&)=delete;
+    WorkStealingPool& operator=(const WorkStealingPool&)=delete;
+
+    //停止接收新任务，已经提交的任务执行完之后线程退出
+    void stop()
+    {
+        started_.store(false);
+        std::lock_guard<std::mutex>lock(sleep_mtx_);
+        cv_.notify_all();
+    }
+
+    bool started()
+    {
+        return started_.load();
+    }
+
+    //提交不关心返回值的任务，不分配future，任务数达到上限或者已经停止时返回false
+    bool post(Task task)override
+    {
+        if(!started_.load()) return false;
+        if(pending_.fetch_add(1)>=max_tasks_)
+        {
+            pending_.fetch_sub(1);
+            return false;
+        }
+
+        size_t idx= local_pool_==this ? local_index_ : next_.fetch_add(1,std::memory_order_relaxed)%workers_.size();
+        {
+            Worker& w=*workers_[idx];
+            std::lock_guard<std::mutex>lock(w.mtx_);
+            w.tasks_.push_back(std::move(task));
+        }
+
+        //pending_和sleeping_都是顺序一致的，休眠的线程要么看到新任务，要么在这里被唤醒
+        if(sleeping_.load()>0)
+        {
+            std::lock_guard<std::mutex>lock(sleep_mtx_);
+            cv_.notify_one();
+        }
+        return true;
+    }
+
+    template<typename F,typename... Args>
+    auto enqueue(F&&func,Args&& ... args)->std::optional<std::future<std::invoke_result_t<F,Args...>>>
+    {
+        using return_type = std::invoke_result_t<F,Args...>;
+
+        std::packaged_task<return_type()>task(std::bind(std::forward<F>(func),std::forward<Args>(args)...));
+        std::optional<std::future<return_type>> ret(task.get_future());
+
+        if(!post([task=std::move(task)]()mutable{task();})) return std::nullopt;
+
+        return ret;
+    }
+
+    inline size_t threadCount()const {return workers_.size();}
+};
+
+} // namespace asynclog
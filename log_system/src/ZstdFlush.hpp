@@ -0,0 +1,136 @@
+#pragma once
+
+#ifdef ASYNCLOG_WITH_ZSTD
+
+#include <zstd.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "LogFlush.hpp"
+#include "Util.hpp"
+
+namespace asynclog
+{
+
+/* 边写边压缩的文件输出，每批数据用ZSTD_compressStream2压缩之后交给WritevFileFlush写入
+每批数据结束时刷新压缩器: zstd_frame_per_batch_为false时只结束当前块(ZSTD_e_flush)，压缩率更高，
+流式解压可以读出最后一次刷新之前的全部数据，为true时结束整个帧(ZSTD_e_end)，文件是若干个完整帧的拼接，
+崩溃之后用任何zstd工具都可以完整解压，正常关闭时结束最后一个帧
+zstd_workers_大于0时由zstd内部的线程并行压缩(需要libzstd支持多线程) */
+class ZstdFileFlush: public LogFlush
+{
+private:
+    WritevFileFlush file_;
+    std::unique_ptr<ZSTD_CCtx,size_t(*)(ZSTD_CCtx*)>cctx_;
+    ZSTD_EndDirective batch_end_;   //每批数据结束时的刷新方式
+    bool frame_open_;               //当前帧中已经有数据，关闭时需要结束
+    std::vector<char>out_buf_;      //ZSTD_compressStream2每次输出的缓冲区
+    std::vector<char>out_;          //这一批压缩之后的数据
+    uint64_t in_bytes_;             //压缩前的总字节数
+    uint64_t out_bytes_;            //压缩后的总字节数
+
+    //压缩input中的数据，mode为e_continue时消耗完输入即可，否则要等到压缩器中的数据全部输出
+    bool compress(ZSTD_inBuffer& input,ZSTD_EndDirective mode)
+    {
+        while(true)
+        {
+            ZSTD_outBuffer output{out_buf_.data(),out_buf_.size(),0};
+            size_t remaining=ZSTD_compressStream2(cctx_.get(),&output,&input,mode);
+            if(ZSTD_isError(remaining))
+            {
+                ::fprintf(stderr,"ZSTD_compressStream2 failed: %s\n",ZSTD_getErrorName(remaining));
+                ZSTD_CCtx_reset(cctx_.get(),ZSTD_reset_session_only);
+                return false;
+            }
+            out_.insert(out_.end(),out_buf_.data(),out_buf_.data()+output.pos);
+            if(mode==ZSTD_e_continue ? input.pos==input.size : remaining==0) return true;
+        }
+    }
+
+    //结束当前的块或者帧，把这一批压缩后的数据写入文件
+    void finishBatch(ZSTD_EndDirective mode)
+    {
+        ZSTD_inBuffer empty{nullptr,0,0};
+        if(!compress(empty,mode))
+        {
+            //压缩器已经重置，下一批从新的帧开始
+            out_.clear();
+            frame_open_=false;
+            return;
+        }
+        if(!out_.empty())
+        {
+            file_.flush(out_.data(),out_.size());
+            out_bytes_+=out_.size();
+        }
+        out_.clear();
+        frame_open_= mode!=ZSTD_e_end;
+    }
+
+public:
+    ZstdFileFlush(std::string file_path,const Util::JsonUtil::JsonData&json_data,std::unique_ptr<ISystemOps>ops=nullptr)
+        :file_(std::move(file_path),json_data,std::move(ops))
+        ,cctx_(ZSTD_createCCtx(),ZSTD_freeCCtx)
+        ,batch_end_(json_data.zstd_frame_per_batch_ ? ZSTD_e_end : ZSTD_e_flush)
+        ,frame_open_(false)
+        ,out_buf_(ZSTD_CStreamOutSize())
+        ,in_bytes_(0)
+        ,out_bytes_(0)
+    {
+        if(!cctx_)
+        {
+            throw std::runtime_error("ZSTD_createCCtx failed");
+        }
+        ZSTD_CCtx_setParameter(cctx_.get(),ZSTD_c_compressionLevel,json_data.zstd_level_);
+        if(json_data.zstd_workers_>0)
+        {
+            //libzstd没有编译多线程支持时返回错误，继续单线程压缩
+            size_t ret=ZSTD_CCtx_setParameter(cctx_.get(),ZSTD_c_nbWorkers,json_data.zstd_workers_);
+            if(ZSTD_isError(ret))
+            {
+                ::fprintf(stderr,"ZSTD_c_nbWorkers unsupported: %s\n",ZSTD_getErrorName(ret));
+            }
+        }
+    }
+    ~ZstdFileFlush()override
+    {
+        if(frame_open_) finishBatch(ZSTD_e_end);
+    }
+
+    void flush(const char* data,size_t len)override
+    {
+        struct iovec iov{const_cast<char*>(data),len};
+        flushv(&iov,1);
+    }
+
+    //所有段压缩到同一个块(帧)中，结束之后一次写入
+    void flushv(const struct iovec* iov,int cnt)override
+    {
+        bool ok=true;
+        for(int i=0;i<cnt&&ok;++i)
+        {
+            ZSTD_inBuffer input{iov[i].iov_base,iov[i].iov_len,0};
+            ok=compress(input,ZSTD_e_continue);
+            in_bytes_+=iov[i].iov_len;
+        }
+        if(!ok)
+        {
+            out_.clear();
+            frame_open_=false;
+            return;
+        }
+        finishBatch(batch_end_);
+    }
+
+    void sync()override {file_.sync();}
+
+    inline uint64_t inputBytes()const {return in_bytes_;}
+    inline uint64_t outputBytes()const {return out_bytes_;}
+};
+
+} // namespace asynclog
+
+#endif
@@ -1,7 +1,28 @@
 #pragma once
 
-#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netdb.h>
+#include <dirent.h>
+#include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "../Util.hpp"
 
@@ -9,14 +30,371 @@
 namespace asynclog
 {
 
-void start_backup(std::string message,std::string addr,uint16_t port)
+/* 备份协议: 每条记录是一个帧，4字节大端的长度加上记录的内容，多条记录的帧直接拼接在同一个TCP连接上发送 */
+namespace BackupFrame
 {
-    
-}
+    static constexpr size_t kHeaderSize=4;
 
-} // namespace asynclog
+    inline void append(std::string& out,const char* data,size_t len)
+    {
+        uint32_t n=static_cast<uint32_t>(len);
+        char header[kHeaderSize]={static_cast<char>(n>>24),static_cast<char>(n>>16),static_cast<char>(n>>8),static_cast<char>(n)};
+        out.append(header,kHeaderSize);
+        out.append(data,len);
+    }
+
+    inline uint32_t length(const char* header)
+    {
+        auto b=reinterpret_cast<const unsigned char*>(header);
+        return (uint32_t(b[0])<<24)|(uint32_t(b[1])<<16)|(uint32_t(b[2])<<8)|uint32_t(b[3]);
+    }
+} // namespace BackupFrame
+
+/* 把ERROR/FATAL日志转发到备份服务器的客户端
+调用线程只把记录拷贝到有上限的内存队列中，后台线程把队列中的记录合并成一批帧，通过一个长连接一次发送，
+连接失败时按指数退避重连，期间的数据追加到本地的溢出文件中，重新连上之后先补发溢出文件再发送新的数据
+只保证至少一次: 补发中途断开时下次会从头补发溢出文件
+每个客户端使用自己的溢出文件: 配置的路径加上服务器地址、进程号和序号，同一个服务器的多个客户端(包括其它进程)互不干扰，
+已经退出的进程留下的同一个服务器的溢出文件由之后连接成功的客户端接管补发 */
+class BackupClient
+{
+private:
+    static constexpr std::chrono::milliseconds kMinRetry{100};
+    static constexpr int kConnectTimeoutMs=1000;
+
+    std::string addr_;
+    uint16_t port_;
+    size_t max_queue_bytes_;    //内存队列的上限，超过时丢弃新的记录
+    size_t batch_bytes_;        //每批发送的数据量
+    std::string spill_path_;    //溢出文件，为空时不能发送的数据直接丢弃
+    std::string replay_path_;   //补发之前先把溢出文件改名为这个文件，补发期间新的记录写入新的溢出文件
+    std::string spill_dir_;     //溢出文件所在的目录
+    std::string spill_prefix_;  //同一个服务器的溢出文件名的前缀，后面是进程号
+    size_t spill_max_bytes_;    //溢出文件的上限
+    std::chrono::milliseconds retry_max_;   //重连间隔的上限
+
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    std::deque<std::string>queue_;
+    size_t queue_bytes_;
+    bool stop_;
+    int fd_;
+    std::atomic<uint64_t>sent_;     //直接发送成功的记录数(不包括从溢出文件补发的)
+    std::atomic<uint64_t>spilled_;  //写入溢出文件的记录数
+    std::atomic<uint64_t>dropped_;  //队列或者溢出文件满时丢弃的记录数
+    std::thread thread_;
+
+    //非阻塞地连接，超时之后放弃，成功之后恢复为阻塞模式并设置发送超时
+    bool connectServer()
+    {
+        struct addrinfo hints;
+        std::memset(&hints,0,sizeof(hints));
+        hints.ai_family=AF_UNSPEC;
+        hints.ai_socktype=SOCK_STREAM;
+        struct addrinfo* res=nullptr;
+        if(::getaddrinfo(addr_.c_str(),std::to_string(port_).c_str(),&hints,&res)!=0) return false;
+
+        for(auto ai=res;ai;ai=ai->ai_next)
+        {
+            int fd=::socket(ai->ai_family,ai->ai_socktype|SOCK_CLOEXEC|SOCK_NONBLOCK,ai->ai_protocol);
+            if(fd<0) continue;
+            int ret=::connect(fd,ai->ai_addr,ai->ai_addrlen);
+            if(ret!=0&&errno==EINPROGRESS)
+            {
+                struct pollfd pfd{fd,POLLOUT,0};
+                int err=ETIMEDOUT;
+                socklen_t len=sizeof(err);
+                if(::poll(&pfd,1,kConnectTimeoutMs)==1) ::getsockopt(fd,SOL_SOCKET,SO_ERROR,&err,&len);
+                ret= err==0 ? 0 : -1;
+            }
+            if(ret==0)
+            {
+                ::fcntl(fd,F_SETFL,::fcntl(fd,F_GETFL)&~O_NONBLOCK);
+                struct timeval tv{1,0};
+                ::setsockopt(fd,SOL_SOCKET,SO_SNDTIMEO,&tv,sizeof(tv));
+                fd_=fd;
+                break;
+            }
+            ::close(fd);
+        }
+        ::freeaddrinfo(res);
+        return fd_>=0;
+    }
+
+    void disconnect()
+    {
+        if(fd_<0) return;
+        ::close(fd_);
+        fd_=-1;
+    }
+
+    //对端已经关闭连接时可读(EOF)，发送之前检查，避免数据写入已经失效的连接
+    bool peerClosed()
+    {
+        struct pollfd pfd{fd_,POLLIN|POLLRDHUP,0};
+        if(::poll(&pfd,1,0)<=0) return false;
+        return pfd.revents&(POLLRDHUP|POLLHUP|POLLERR|POLLIN);
+    }
+
+    bool sendAll(const char* data,size_t len)
+    {
+        while(len>0)
+        {
+            ssize_t n=::send(fd_,data,len,MSG_NOSIGNAL);
+            if(n<0)
+            {
+                if(errno==EINTR) continue;
+                return false;
+            }
+            data+=n;
+            len-=static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    //连接(必要时重连)并发送，失败时断开连接
+    bool sendFrames(const std::string& frames)
+    {
+        if(fd_>=0&&peerClosed()) disconnect();
+        if(fd_<0&&!connectServer()) return false;
+        if(!replaySpill()||!sendAll(frames.data(),frames.size()))
+        {
+            disconnect();
+            return false;
+        }
+        return true;
+    }
+
+    //发送replay_path_中的全部数据，成功之后删除
+    bool replayFile()
+    {
+        FILE* fp=::fopen(replay_path_.c_str(),"rb");
+        if(fp==nullptr) return true;
+        std::string buf(std::max<size_t>(batch_bytes_,4096),'\0');
+        bool ok=true;
+        size_t n;
+        while((n=::fread(buf.data(),1,buf.size(),fp))>0)
+        {
+            if(!sendAll(buf.data(),n))
+            {
+                ok=false;
+                break;
+            }
+        }
+        ::fclose(fp);
+        if(ok) ::remove(replay_path_.c_str());
+        return ok;
+    }
 
+    //同一个服务器的、进程已经退出的溢出文件(包括补发到一半的)
+    std::vector<std::string> orphanSpills()
+    {
+        std::vector<std::string>orphans;
+        DIR* dir=::opendir(spill_dir_.c_str());
+        if(dir==nullptr) return orphans;
+        while(struct dirent* entry=::readdir(dir))
+        {
+            std::string name(entry->d_name);
+            if(name.rfind(spill_prefix_,0)!=0) continue;
+            //文件名中前缀之后是<进程号>.<序号>
+            char* end=nullptr;
+            long pid=std::strtol(name.c_str()+spill_prefix_.size(),&end,10);
+            if(end==name.c_str()+spill_prefix_.size()||*end!='.'||pid<=0||pid==::getpid()) continue;
+            if(::kill(static_cast<pid_t>(pid),0)==0||errno!=ESRCH) continue;
+            orphans.push_back(spill_dir_+name);
+        }
+        ::closedir(dir);
+        return orphans;
+    }
 
+    /* 补发溢出文件，先改名再补发，补发期间追加的记录写入新的溢出文件，不会在补发完成之后被一起删除
+    上一次补发失败留下的文件最先补发，然后是自己的溢出文件和已经退出的进程的溢出文件 */
+    bool replaySpill()
+    {
+        if(spill_path_.empty()) return true;
+        if(!replayFile()) return false;
+        if(::rename(spill_path_.c_str(),replay_path_.c_str())==0&&!replayFile()) return false;
+        for(auto& orphan:orphanSpills())
+        {
+            //其它客户端同时接管时只有一个改名成功
+            if(::rename(orphan.c_str(),replay_path_.c_str())==0&&!replayFile()) return false;
+        }
+        return true;
+    }
 
+    //发送失败的帧追加到溢出文件中，超过上限时丢弃
+    void spill(const std::string& frames,size_t records)
+    {
+        if(!spill_path_.empty())
+        {
+            struct stat st;
+            size_t size= ::stat(spill_path_.c_str(),&st)==0 ? static_cast<size_t>(st.st_size) : 0;
+            if(size+frames.size()<=spill_max_bytes_)
+            {
+                Util::File::createDirectory(Util::File::folderPath(spill_path_));
+                FILE* fp=::fopen(spill_path_.c_str(),"ab");
+                if(fp!=nullptr)
+                {
+                    bool ok=::fwrite(frames.data(),1,frames.size(),fp)==frames.size();
+                    ok=::fclose(fp)==0&&ok;
+                    if(ok)
+                    {
+                        spilled_.fetch_add(records,std::memory_order_relaxed);
+                        return;
+                    }
+                }
+            }
+        }
+        dropped_.fetch_add(records,std::memory_order_relaxed);
+    }
 
+    //调用者持有mtx_，把队列中的记录合并为一批，返回记录数
+    size_t takeBatch(std::string& frames)
+    {
+        frames.clear();
+        size_t records=0;
+        while(!queue_.empty()&&(frames.empty()||frames.size()+queue_.front().size()<=batch_bytes_))
+        {
+            BackupFrame::append(frames,queue_.front().data(),queue_.front().size());
+            queue_bytes_-=queue_.front().size();
+            queue_.pop_front();
+            ++records;
+        }
+        return records;
+    }
 
+    /* 调用者持有mtx_，连接失败之后等待下一次重连，期间新的记录直接写入溢出文件，
+    不等到重连时才处理，否则服务器长时间不可用时内存队列很快被填满，之后的记录都被丢弃
+    停止或者到达重连时间时返回 */
+    void spillUntil(std::unique_lock<std::mutex>& lock,std::chrono::steady_clock::time_point deadline,std::string& frames)
+    {
+        while(cond_.wait_until(lock,deadline,[this](){return stop_||!queue_.empty();})&&!stop_)
+        {
+            size_t records=takeBatch(frames);
+            lock.unlock();
+            spill(frames,records);
+            lock.lock();
+        }
+    }
+
+    void threadEntry()
+    {
+        auto retry=kMinRetry;
+        bool offline=false;     //停止时连接失败，剩余的数据不再尝试发送
+        bool reconnect=false;   //连接失败之后到达重连时间，队列为空时也要重连补发溢出文件
+        std::string frames;
+        std::unique_lock<std::mutex>lock(mtx_);
+        while(true)
+        {
+            if(!reconnect) cond_.wait(lock,[this](){return stop_||!queue_.empty();});
+            if(queue_.empty()&&(stop_||!reconnect)) break;
+
+            size_t records=takeBatch(frames);
+            bool stopping=stop_;
+            lock.unlock();
+
+            if(!offline&&sendFrames(frames))
+            {
+                sent_.fetch_add(records,std::memory_order_relaxed);
+                retry=kMinRetry;
+                reconnect=false;
+                lock.lock();
+                continue;
+            }
+
+            if(records>0) spill(frames,records);
+            reconnect=true;
+            lock.lock();
+            //停止时不再等待重连，剩余的数据都写入溢出文件
+            if(stopping||stop_)
+            {
+                offline=true;
+                continue;
+            }
+            spillUntil(lock,std::chrono::steady_clock::now()+retry,frames);
+            retry=std::min(retry*2,std::max(retry_max_,kMinRetry));
+        }
+        lock.unlock();
+        disconnect();
+    }
+
+public:
+    BackupClient(std::string addr,uint16_t port,const Util::JsonUtil::JsonData& json_data)
+        :addr_(std::move(addr))
+        ,port_(port)
+        ,max_queue_bytes_(json_data.backup_queue_bytes_)
+        ,batch_bytes_(std::max<size_t>(json_data.backup_batch_bytes_,1))
+        ,spill_path_(json_data.backup_spill_path_)
+        ,spill_max_bytes_(json_data.backup_spill_max_bytes_)
+        ,retry_max_(json_data.backup_retry_max_ms_)
+        ,queue_bytes_(0)
+        ,stop_(false)
+        ,fd_(-1)
+        ,sent_(0)
+        ,spilled_(0)
+        ,dropped_(0)
+    {
+        if(!spill_path_.empty())
+        {
+            static std::atomic<uint64_t>seq{0};
+            spill_dir_=Util::File::folderPath(spill_path_);
+            spill_dir_= spill_dir_.empty() ? "./" : spill_dir_+"/";
+            spill_prefix_=spill_path_.substr(spill_path_.find_last_of("/\\")+1)+"."+addr_+"_"+std::to_string(port_)+".";
+            spill_path_=spill_dir_+spill_prefix_+std::to_string(::getpid())+"."+std::to_string(seq.fetch_add(1));
+            replay_path_=spill_path_+".replay";
+        }
+        thread_=std::thread([this](){threadEntry();});
+    }
+
+    //发送或者溢出队列中剩余的记录之后退出
+    ~BackupClient()
+    {
+        {
+            std::lock_guard<std::mutex>lock(mtx_);
+            stop_=true;
+        }
+        cond_.notify_one();
+        thread_.join();
+    }
+
+    BackupClient(const BackupClient&)=delete;
+    BackupClient& operator=(const BackupClient&)=delete;
+
+    //放入一条记录，队列满时丢弃并返回false
+    bool post(const char* data,size_t len)
+    {
+        {
+            std::lock_guard<std::mutex>lock(mtx_);
+            if(stop_||queue_bytes_+len>max_queue_bytes_)
+            {
+                dropped_.fetch_add(1,std::memory_order_relaxed);
+                return false;
+            }
+            queue_.emplace_back(data,len);
+            queue_bytes_+=len;
+        }
+        cond_.notify_one();
+        return true;
+    }
+
+    inline uint64_t sentCount()const {return sent_.load(std::memory_order_relaxed);}
+    inline uint64_t spilledCount()const {return spilled_.load(std::memory_order_relaxed);}
+    inline uint64_t droppedCount()const {return dropped_.load(std::memory_order_relaxed);}
+    //这个客户端实际使用的溢出文件，没有配置溢出文件时为空
+    inline const std::string& spillPath()const {return spill_path_;}
+};
+
+//使用默认配置，每个地址共享一个BackupClient，进程退出时发送或者溢出剩余的记录
+inline void start_backup(std::string message,std::string addr,uint16_t port)
+{
+    static std::mutex mtx;
+    static std::map<std::pair<std::string,uint16_t>,std::unique_ptr<BackupClient>>clients;
+    static Util::JsonUtil::JsonData json_data;
+
+    std::lock_guard<std::mutex>lock(mtx);
+    auto& client=clients[{addr,port}];
+    if(!client) client=std::make_unique<BackupClient>(addr,port,json_data);
+    client->post(message.data(),message.size());
+}
+
+} // namespace asynclog
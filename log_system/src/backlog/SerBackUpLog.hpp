@@ -0,0 +1,159 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "CliBackUpLog.hpp"
+
+
+namespace asynclog
+{
+
+/* 接收BackupClient转发的日志的服务端，用于本地测试和部署简单的备份节点
+单个线程用poll处理监听套接字和所有连接，按照BackupFrame的格式拆出每条记录交给handler_ */
+class BackupServer
+{
+public:
+    using Handler=std::function<void(std::string_view record)>;
+
+private:
+    static constexpr uint32_t kMaxRecord=16*1024*1024;  //单条记录的上限，超过时认为连接的数据有误
+    static constexpr int kPollMs=100;                    //检查停止标志的间隔
+
+    //一个客户端连接和它还没有组成完整帧的数据
+    struct Connection
+    {
+        int fd_;
+        std::string pending_;
+    };
+
+    uint16_t port_;
+    Handler handler_;
+    int listen_fd_;
+    std::atomic_bool stop_;
+    std::vector<Connection>conns_;
+    std::thread thread_;
+
+    //拆出pending_中所有完整的帧，数据有误时返回false
+    bool parse(Connection& conn)
+    {
+        size_t pos=0;
+        while(conn.pending_.size()-pos>=BackupFrame::kHeaderSize)
+        {
+            uint32_t len=BackupFrame::length(conn.pending_.data()+pos);
+            if(len>kMaxRecord) return false;
+            if(conn.pending_.size()-pos-BackupFrame::kHeaderSize<len) break;
+            handler_(std::string_view(conn.pending_.data()+pos+BackupFrame::kHeaderSize,len));
+            pos+=BackupFrame::kHeaderSize+len;
+        }
+        conn.pending_.erase(0,pos);
+        return true;
+    }
+
+    void threadEntry()
+    {
+        std::vector<struct pollfd>pfds;
+        char buf[64*1024];
+        while(!stop_.load())
+        {
+            pfds.clear();
+            pfds.push_back(pollfd{listen_fd_,POLLIN,0});
+            for(auto& conn:conns_) pfds.push_back(pollfd{conn.fd_,POLLIN,0});
+            if(::poll(pfds.data(),pfds.size(),kPollMs)<=0) continue;
+
+            //先处理已有的连接，再接受新的连接，保证pfds和conns_的下标对应
+            for(size_t i=conns_.size();i>0;--i)
+            {
+                if(pfds[i].revents==0) continue;
+                Connection& conn=conns_[i-1];
+                ssize_t n=::recv(conn.fd_,buf,sizeof(buf),0);
+                if(n>0)
+                {
+                    conn.pending_.append(buf,static_cast<size_t>(n));
+                    if(parse(conn)) continue;
+                }
+                else if(n<0&&errno==EINTR)
+                {
+                    continue;
+                }
+                ::close(conn.fd_);
+                conns_.erase(conns_.begin()+(i-1));
+            }
+            if(pfds[0].revents&POLLIN)
+            {
+                int fd=::accept4(listen_fd_,nullptr,nullptr,SOCK_CLOEXEC);
+                if(fd>=0) conns_.push_back(Connection{fd,std::string()});
+            }
+        }
+        for(auto& conn:conns_) ::close(conn.fd_);
+        conns_.clear();
+    }
+
+public:
+    //port为0时由系统分配端口，start之后通过port()获取
+    BackupServer(uint16_t port,Handler handler)
+        :port_(port)
+        ,handler_(std::move(handler))
+        ,listen_fd_(-1)
+        ,stop_(false)
+    {}
+
+    ~BackupServer(){stop();}
+
+    BackupServer(const BackupServer&)=delete;
+    BackupServer& operator=(const BackupServer&)=delete;
+
+    //监听所有地址上的port_并启动线程，失败时返回false
+    bool start()
+    {
+        listen_fd_=::socket(AF_INET,SOCK_STREAM|SOCK_CLOEXEC,0);
+        if(listen_fd_<0) return false;
+        int on=1;
+        ::setsockopt(listen_fd_,SOL_SOCKET,SO_REUSEADDR,&on,sizeof(on));
+
+        struct sockaddr_in addr;
+        std::memset(&addr,0,sizeof(addr));
+        addr.sin_family=AF_INET;
+        addr.sin_addr.s_addr=htonl(INADDR_ANY);
+        addr.sin_port=htons(port_);
+        socklen_t len=sizeof(addr);
+        if(::bind(listen_fd_,reinterpret_cast<struct sockaddr*>(&addr),len)!=0
+            ||::listen(listen_fd_,SOMAXCONN)!=0
+            ||::getsockname(listen_fd_,reinterpret_cast<struct sockaddr*>(&addr),&len)!=0)
+        {
+            ::close(listen_fd_);
+            listen_fd_=-1;
+            return false;
+        }
+        port_=ntohs(addr.sin_port);
+        stop_.store(false);
+        thread_=std::thread([this](){threadEntry();});
+        return true;
+    }
+
+    //关闭监听套接字和所有连接
+    void stop()
+    {
+        stop_.store(true);
+        if(thread_.joinable()) thread_.join();
+        if(listen_fd_>=0)
+        {
+            ::close(listen_fd_);
+            listen_fd_=-1;
+        }
+    }
+
+    inline uint16_t port()const {return port_;}
+};
+
+} // namespace asynclog
@@ -3,12 +3,26 @@
 #include "test_Level.h"
 #include "test_Util.h"
 #include "test_Message.h"
+#include "test_BinaryLog.h"
+#include "test_Format.h"
+#include "test_Clock.h"
 #include "test_Buffer.h"
+#include "test_RingBuffer.h"
+#include "test_ChunkBuffer.h"
+#include "test_FlushScheduler.h"
+#include "test_RateLimit.h"
 #include "test_ThreadPool.h"
 #include "test_LogFlush.h"
+#include "test_UringFlush.h"
+#include "test_MmapFlush.h"
+#include "test_Retention.h"
+#include "test_ZstdFlush.h"
 
 #include "test_AsyncWorker.h"
 #include "test_AsyncLogger.h"
+#include "test_Backup.h"
+#include "test_Manager.h"
+#include "test_MyLog.h"
 #include "test_Integration.h"
 
 
@@ -13,6 +13,25 @@ public:
     MOCK_METHOD(int,vasprintf,(char **,const char *,va_list),(override));
 };
 
+//把日志保存到字符串中的落地方向，用于验证输出内容
+class StringFlush: public LogFlush
+{
+public:
+    void flush(const char* data,size_t len)override
+    {
+        std::lock_guard<std::mutex>lock(mtx_);
+        output_.append(data,len);
+    }
+    std::string output()
+    {
+        std::lock_guard<std::mutex>lock(mtx_);
+        return output_;
+    }
+private:
+    std::mutex mtx_;
+    std::string output_;
+};
+
 class AsyncLoggerTest: public ::testing::Test
 {
 protected:
@@ -87,6 +106,390 @@ TEST_F(AsyncLoggerTest,async_logger_builder_test)
     EXPECT_EQ(logger->info("builder.cpp",30,"Logger built by AsyncLoggerBuilder."),true);
 }
 
+//测试线程本地暂存区：线程退出和日志器析构时暂存的日志都不会丢失，并且锁的获取次数减少
+TEST_F(AsyncLoggerTest,staging_buffer_test)
+{
+    auto string_flush=std::make_shared<StringFlush>();
+    json_data_.buffer_size_=1024;
+    json_data_.staging_size_=4096;
+    json_data_.staging_interval_ms_=60*1000;
+    const int thread_num=4;
+    const int logs_per_thread=200;
+
+    size_t lock_count=0;
+    {
+        AsyncLogger logger("staging_log",{string_flush},pool,json_data_);
+        std::vector<std::thread>threads;
+        for(int t=0;t<thread_num;++t)
+        {
+            threads.emplace_back([&logger,t,logs_per_thread](){
+                for(int i=0;i<logs_per_thread;++i)
+                {
+                    logger.info("test.cpp",1,"thread %d message %d",t,i);
+                }
+            });
+        }
+        for(auto&t:threads) t.join();
+
+        //主线程写入的日志只存在于暂存区中，由析构函数提交
+        logger.info("test.cpp",2,"main thread message");
+        lock_count=logger.lockCount();
+    }
+
+    std::string output=string_flush->output();
+    for(int t=0;t<thread_num;++t)
+    {
+        for(int i=0;i<logs_per_thread;++i)
+        {
+            EXPECT_THAT(output,::testing::HasSubstr("\tthread "+std::to_string(t)+" message "+std::to_string(i)+"\n"));
+        }
+    }
+    EXPECT_THAT(output,::testing::HasSubstr("main thread message"));
+    EXPECT_LT(lock_count,thread_num*logs_per_thread/10);
+}
+
+//测试后台线程会定期回收空闲线程暂存区中的日志
+TEST_F(AsyncLoggerTest,staging_collect_test)
+{
+    auto string_flush=std::make_shared<StringFlush>();
+    json_data_.staging_size_=4096;
+    json_data_.staging_interval_ms_=60*1000;
+    AsyncLogger logger("staging_log",{string_flush},pool,json_data_);
+
+    logger.info("test.cpp",1,"idle message");
+    std::this_thread::sleep_for(std::chrono::milliseconds(3200));
+    EXPECT_THAT(string_flush->output(),::testing::HasSubstr("idle message"));
+}
+
+//测试二进制日志模式，输出格式和文本模式一致
+TEST_F(AsyncLoggerTest,binary_log_test)
+{
+    auto string_flush=std::make_shared<StringFlush>();
+    json_data_.binary_log_=true;
+    {
+        auto logger=std::make_shared<AsyncLogger>("binary_log",std::vector<std::shared_ptr<LogFlush>>{string_flush},pool,json_data_);
+        logger->info("test.cpp",10,"This is a test log message: %d %s",42,"abc");
+        static const CallSite site(LogLevel::value::WARN,"site.cpp",3,"site message %d %.2f");
+        logger->logSite(&site,7,1.5);
+    }
+    std::string output=string_flush->output();
+    EXPECT_THAT(output,::testing::HasSubstr("[INFO][binary_log][test.cpp:10]\tThis is a test log message: 42 abc\n"));
+    EXPECT_THAT(output,::testing::HasSubstr("[WARN][binary_log][site.cpp:3]\tsite message 7 1.50\n"));
+}
+
+//测试类型安全的日志接口
+TEST_F(AsyncLoggerTest,format_log_test)
+{
+    auto string_flush=std::make_shared<StringFlush>();
+    {
+        AsyncLogger logger("fmt_log",{string_flush},pool,json_data_);
+        std::string_view name="file.txt";
+        EXPECT_TRUE(logger.infoFmt("upload {} size {} ratio {}",name,1024,0.5));
+    }
+    std::string output=string_flush->output();
+    EXPECT_THAT(output,::testing::HasSubstr("[INFO][fmt_log]["));
+    EXPECT_THAT(output,::testing::HasSubstr("test_AsyncLogger.h:"));
+    EXPECT_THAT(output,::testing::HasSubstr("]\tupload file.txt size 1024 ratio 0.5\n"));
+}
+
+//整数、浮点数和string_view参数不使用堆内存
+TEST_F(AsyncLoggerTest,format_log_no_alloc_test)
+{
+    auto string_flush=std::make_shared<StringFlush>();
+    json_data_.buffer_size_=1024*1024;
+    AsyncLogger logger("fmt_log",{string_flush},pool,json_data_);
+    std::string_view sv="view";
+    //第一次调用会初始化线程本地的线程id文本
+    logger.debugFmt("warm up {}",0);
+
+    g_alloc_count=0;
+    g_count_alloc=true;
+    for(int i=0;i<100;++i)
+    {
+        logger.debugFmt("int {} double {} view {}",i,i*0.5,sv);
+    }
+    g_count_alloc=false;
+    EXPECT_EQ(g_alloc_count.load(),0);
+}
+
+//测试运行时的日志等级过滤
+TEST_F(AsyncLoggerTest,level_filter_test)
+{
+    auto string_flush=std::make_shared<StringFlush>();
+    json_data_.log_level_="INFO";
+    {
+        AsyncLogger logger("level_log",{string_flush},pool,json_data_);
+        EXPECT_EQ(logger.level(),LogLevel::value::INFO);
+        EXPECT_FALSE(logger.shouldLog(LogLevel::value::DEBUG));
+        EXPECT_FALSE(logger.debug("a.cpp",1,"debug message"));
+        EXPECT_TRUE(logger.info("a.cpp",2,"info message"));
 
+        logger.setLevel(LogLevel::value::ERROR);
+        EXPECT_FALSE(logger.warn("a.cpp",3,"warn message"));
+        EXPECT_FALSE(logger.infoFmt("info fmt {}",1));
+        EXPECT_TRUE(logger.error("a.cpp",4,"error message"));
+    }
+    std::string output=string_flush->output();
+    EXPECT_THAT(output,::testing::HasSubstr("info message"));
+    EXPECT_THAT(output,::testing::HasSubstr("error message"));
+    EXPECT_THAT(output,::testing::Not(::testing::HasSubstr("debug message")));
+    EXPECT_THAT(output,::testing::Not(::testing::HasSubstr("warn message")));
+    EXPECT_THAT(output,::testing::Not(::testing::HasSubstr("info fmt")));
+}
 
+//测试微秒精度的时间戳
+TEST_F(AsyncLoggerTest,timestamp_precision_test)
+{
+    auto string_flush=std::make_shared<StringFlush>();
+    json_data_.timestamp_precision_="us";
+    {
+        AsyncLogger logger("us_log",{string_flush},pool,json_data_);
+        logger.info("a.cpp",1,"printf path");
+        logger.infoFmt("typed path");
+    }
+    std::string output=string_flush->output();
+    EXPECT_THAT(output,::testing::ContainsRegex("\\.[0-9]{6}\\]\\[[^]]*\\]\\[INFO\\]\\[us_log\\]\\[a\\.cpp:1\\]\tprintf path"));
+    EXPECT_THAT(output,::testing::ContainsRegex("\\.[0-9]{6}\\]\\[[^]]*\\]\\[INFO\\]\\[us_log\\].*typed path"));
 
+    //二进制记录中保存纳秒时间，由后台线程按精度渲染
+    auto binary_flush=std::make_shared<StringFlush>();
+    json_data_.timestamp_precision_="ms";
+    json_data_.binary_log_=true;
+    {
+        AsyncLogger logger("ms_log",{binary_flush},pool,json_data_);
+        logger.info("b.cpp",2,"binary %d",1);
+    }
+    EXPECT_THAT(binary_flush->output(),::testing::ContainsRegex("\\.[0-9]{3}\\]\\[[^]]*\\]\\[INFO\\]\\[ms_log\\]\\[b\\.cpp:2\\]\tbinary 1"));
+}
+
+//测试分段缓冲区模式下文本和二进制日志的输出
+TEST_F(AsyncLoggerTest,segmented_buffer_test)
+{
+    json_data_.chunk_size_=64;
+    for(bool binary:{false,true})
+    {
+        json_data_.binary_log_=binary;
+        auto string_flush=std::make_shared<StringFlush>();
+        {
+            AsyncLogger logger("chunk_log",{string_flush},pool,json_data_);
+            for(int i=0;i<200;++i)
+            {
+                logger.info("c.cpp",1,"segmented message %d",i);
+            }
+        }
+        std::string output=string_flush->output();
+        for(int i=0;i<200;++i)
+        {
+            EXPECT_THAT(output,::testing::HasSubstr("\tsegmented message "+std::to_string(i)+"\n"));
+        }
+    }
+}
+
+
+//落地方向阻塞时按等级丢弃日志，压力消退之后写入一条汇报丢弃条数的日志
+TEST_F(AsyncLoggerTest,overflow_drop_report_test)
+{
+    class GateFlush: public StringFlush
+    {
+    public:
+        void flush(const char* data,size_t len)override
+        {
+            entered_=true;
+            std::lock_guard<std::mutex>lock(gate_);
+            StringFlush::flush(data,len);
+        }
+        std::mutex gate_;
+        std::atomic_bool entered_{false};
+    };
+
+    auto gate_flush=std::make_shared<GateFlush>();
+    json_data_.buffer_size_=1024;
+    json_data_.flush_max_latency_ms_=20;
+    json_data_.overflow_policy_="drop_low";
+    uint64_t dropped=0;
+
+    gate_flush->gate_.lock();
+    {
+        AsyncLogger logger("drop_log",{gate_flush},pool,json_data_,BufferPolicy::LIMIT_SIZE,1024);
+        ASSERT_TRUE(logger.info("d.cpp",1,"first message"));
+        while(!gate_flush->entered_) std::this_thread::yield();
+
+        while(logger.debug("d.cpp",2,"noisy debug message")) {}
+        ASSERT_TRUE(logger.warn("d.cpp",3,"important warning"));
+        dropped=logger.droppedCount(LogLevel::value::DEBUG);
+        gate_flush->gate_.unlock();
+    }
+    ASSERT_EQ(dropped,1);
+    std::string output=gate_flush->output();
+    EXPECT_THAT(output,::testing::HasSubstr("\timportant warning\n"));
+    EXPECT_THAT(output,::testing::HasSubstr("log records dropped under buffer pressure: DEBUG=1 INFO=0 WARN=0 ERROR=0 FATAL=0\n"));
+}
+
+//测试暂存区和block策略一起使用，提交暂存区时等待空间的生产者在落地方向恢复之后很快被接受，不会等到超时丢弃
+TEST_F(AsyncLoggerTest,staging_overflow_block_test)
+{
+    class GateFlush: public StringFlush
+    {
+    public:
+        void flush(const char* data,size_t len)override
+        {
+            entered_=true;
+            std::lock_guard<std::mutex>lock(gate_);
+            StringFlush::flush(data,len);
+        }
+        std::mutex gate_;
+        std::atomic_bool entered_{false};
+    };
+
+    auto gate_flush=std::make_shared<GateFlush>();
+    json_data_.buffer_size_=1024;
+    json_data_.flush_max_latency_ms_=20;
+    json_data_.staging_size_=256;
+    json_data_.staging_interval_ms_=60*1000;
+    json_data_.overflow_policy_="block";
+    json_data_.overflow_block_ms_=5000;
+
+    gate_flush->gate_.lock();
+    {
+        AsyncLogger logger("block_log",{gate_flush},pool,json_data_,BufferPolicy::LIMIT_SIZE,1024);
+        ASSERT_TRUE(logger.info("b.cpp",1,"first message"));
+        while(!gate_flush->entered_) std::this_thread::yield();
+
+        //落地方向阻塞期间写满缓冲区，生产者阻塞在提交暂存区中
+        std::atomic_bool done{false};
+        bool all_pushed=true;
+        std::thread productor([&](){
+            for(int i=0;i<40;++i)
+            {
+                if(!logger.info("b.cpp",2,"staged message %d",i)) all_pushed=false;
+            }
+            done=true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        EXPECT_FALSE(done);
+
+        auto start=std::chrono::steady_clock::now();
+        gate_flush->gate_.unlock();
+        productor.join();
+        EXPECT_LT(std::chrono::steady_clock::now()-start,std::chrono::milliseconds(2000));
+        EXPECT_TRUE(all_pushed);
+        EXPECT_EQ(logger.droppedCount(LogLevel::value::INFO),0);
+    }
+    EXPECT_THAT(gate_flush->output(),::testing::HasSubstr("\tstaged message 39\n"));
+}
+
+//测试flushAndWait把暂存区和缓冲区中的日志立即刷新并落盘
+TEST_F(AsyncLoggerTest,flush_and_wait_test)
+{
+    class SyncFlush: public StringFlush
+    {
+    public:
+        void sync()override{++sync_count_;}
+        std::atomic<int> sync_count_{0};
+    };
+
+    auto sync_flush=std::make_shared<SyncFlush>();
+    json_data_.buffer_size_=64*1024;
+    json_data_.staging_size_=4096;
+    json_data_.staging_interval_ms_=60*1000;
+    AsyncLogger logger("sync_log",{sync_flush},pool,json_data_);
+
+    logger.info("s.cpp",1,"metadata committed");
+    ASSERT_TRUE(logger.flushAndWait(std::chrono::milliseconds(1000)));
+    EXPECT_THAT(sync_flush->output(),::testing::HasSubstr("\tmetadata committed\n"));
+    ASSERT_EQ(sync_flush->sync_count_,1);
+
+    logger.info("s.cpp",2,"second commit");
+    ASSERT_TRUE(logger.sync());
+    EXPECT_THAT(sync_flush->output(),::testing::HasSubstr("\tsecond commit\n"));
+    ASSERT_EQ(sync_flush->sync_count_,2);
+}
+
+//测试每个落地方向使用独立的线程，连续缓冲区、分段缓冲区和二进制模式下所有落地方向都收到相同的数据
+TEST_F(AsyncLoggerTest,sink_threads_test)
+{
+    class SyncFlush: public StringFlush
+    {
+    public:
+        void sync()override{++sync_count_;}
+        std::atomic<int> sync_count_{0};
+    };
+
+    json_data_.sink_threads_=true;
+    json_data_.buffer_size_=1024;
+    for(size_t chunk_size:{0,64})
+    {
+        for(bool binary:{false,true})
+        {
+            json_data_.chunk_size_=chunk_size;
+            json_data_.binary_log_=binary;
+            auto first=std::make_shared<SyncFlush>();
+            auto second=std::make_shared<SyncFlush>();
+            {
+                AsyncLogger logger("sink_log",{first,second},pool,json_data_);
+                for(int i=0;i<200;++i)
+                {
+                    logger.info("k.cpp",1,"fan out message %d",i);
+                }
+                ASSERT_TRUE(logger.flushAndWait(std::chrono::milliseconds(1000)));
+                ASSERT_EQ(first->sync_count_,1);
+                ASSERT_EQ(second->sync_count_,1);
+                EXPECT_THAT(first->output(),::testing::HasSubstr("\tfan out message 199\n"));
+            }
+            std::string output=first->output();
+            ASSERT_EQ(output,second->output());
+            for(int i=0;i<200;++i)
+            {
+                EXPECT_THAT(output,::testing::HasSubstr("\tfan out message "+std::to_string(i)+"\n"));
+            }
+        }
+    }
+}
+
+//测试慢的落地方向不会拖慢其它落地方向，队列满时丢弃这个落地方向的批次
+TEST_F(AsyncLoggerTest,sink_threads_slow_sink_test)
+{
+    class GateFlush: public StringFlush
+    {
+    public:
+        void flush(const char* data,size_t len)override
+        {
+            entered_=true;
+            std::lock_guard<std::mutex>lock(gate_);
+            StringFlush::flush(data,len);
+        }
+        std::mutex gate_;
+        std::atomic_bool entered_{false};
+    };
+
+    auto slow=std::make_shared<GateFlush>();
+    auto fast=std::make_shared<StringFlush>();
+    json_data_.sink_threads_=true;
+    json_data_.sink_queue_size_=2;
+    json_data_.sink_overflow_="drop";
+    json_data_.buffer_size_=1024;
+    json_data_.flush_max_latency_ms_=5;
+    uint64_t dropped=0;
+
+    slow->gate_.lock();
+    {
+        AsyncLogger logger("slow_log",{slow,fast},pool,json_data_);
+        //每条日志等快的落地方向收到之后再写下一条，保证每条日志是单独的一批
+        for(int i=0;i<10;++i)
+        {
+            logger.info("k.cpp",2,"message %d",i);
+            std::string expected="\tmessage "+std::to_string(i)+"\n";
+            while(fast->output().find(expected)==std::string::npos) std::this_thread::yield();
+            while(!slow->entered_) std::this_thread::yield();
+        }
+        dropped=logger.sinkDroppedBatches(0);
+        ASSERT_EQ(logger.sinkDroppedBatches(1),0);
+        slow->gate_.unlock();
+    }
+    //第一批阻塞在落地方向中，队列中还有两批
+    ASSERT_EQ(dropped,7);
+    std::string output=slow->output();
+    EXPECT_THAT(output,::testing::HasSubstr("\tmessage 0\n"));
+    EXPECT_THAT(output,::testing::HasSubstr("\tmessage 2\n"));
+    EXPECT_THAT(output,::testing::Not(::testing::HasSubstr("\tmessage 3\n")));
+}
@@ -128,5 +128,615 @@ TEST_F(AsyncWorkerTest,mutiple_thread_test)
     }
 }
 
+//测试无锁模式的多线程写入
+TEST_F(AsyncWorkerTest,lock_free_mutiple_thread_test)
+{
+    std::vector<std::string>datas;
+    std::vector<std::thread>threads;
+    std::mutex out_mtx;
+    {
+        AsyncWorker worker(json_data,[this](Buffer&buf){dataProcess(buf);},BufferPolicy::LOCK_FREE);
+        worker.start();
+
+        for(int i=0;i<100;++i)
+        {
+            datas.emplace_back(std::to_string(i)+std::string(15,'a'+i%26));
+        }
+        auto thread_func=[&](int idx){
+            for(int i=idx;i<idx+10;++i)
+            {
+                ASSERT_TRUE(worker.push(datas[i].c_str(),datas[i].size()));
+            }
+        };
+        for(int i=0;i<10;++i)
+        {
+            threads.emplace_back(thread_func,i*10);
+        }
+        for(auto&t:threads)
+        {
+            t.join();
+        }
+    }
+
+    //析构时会把环形缓冲区中剩余的数据全部写入
+    for(auto&data:datas)
+    {
+        EXPECT_THAT(output_buffer,::testing::HasSubstr(data));
+    }
+}
+
+//测试环形缓冲区写满之后退化为加锁写入，同一线程的数据保持顺序
+TEST_F(AsyncWorkerTest,lock_free_overflow_test)
+{
+    std::string expected;
+    {
+        AsyncWorker worker(json_data,[this](Buffer&buf){dataProcess(buf);},BufferPolicy::LOCK_FREE);
+        worker.start();
+        for(int i=0;i<200;++i)
+        {
+            std::string data=std::to_string(i)+std::string(1500,'x')+"\n";
+            ASSERT_TRUE(worker.push(data.c_str(),data.size()));
+            expected+=data;
+        }
+    }
+    ASSERT_EQ(output_buffer,expected);
+}
+
+//测试stop和无锁写入并发，push返回true的数据都会被输出
+TEST_F(AsyncWorkerTest,lock_free_stop_race_test)
+{
+    json_data.buffer_size_=1024*1024;
+    for(int round=0;round<20;++round)
+    {
+        output_buffer.clear();
+        std::atomic<size_t>accepted=0;
+        {
+            AsyncWorker worker(json_data,[this](Buffer&buf){dataProcess(buf);},BufferPolicy::LOCK_FREE);
+            worker.start();
+            std::vector<std::thread>threads;
+            for(int t=0;t<4;++t)
+            {
+                threads.emplace_back([&](){
+                    while(worker.push("x\n",2)) accepted.fetch_add(1);
+                });
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            worker.stop();
+            for(auto& t:threads) t.join();
+        }
+        ASSERT_EQ(output_buffer.size(),accepted.load()*2);
+    }
+}
+
+//测试分段缓冲区模式，chunk_functor为空时拷贝为连续的缓冲区
+TEST_F(AsyncWorkerTest,segmented_test)
+{
+    json_data.buffer_size_=64;
+    json_data.chunk_size_=16;
+    std::string expected;
+    {
+        AsyncWorker worker(json_data,[this](Buffer&buf){dataProcess(buf);});
+        worker.start();
+        for(int i=0;i<100;++i)
+        {
+            std::string data="log "+std::to_string(i)+"\n";
+            expected+=data;
+            ASSERT_TRUE(worker.push(data.c_str(),data.size()));
+        }
+    }
+    ASSERT_EQ(expected,output_buffer);
+}
+
+//分段缓冲区和无锁环形缓冲区一起使用，块链直接交给chunk_functor
+TEST_F(AsyncWorkerTest,segmented_chunk_functor_test)
+{
+    json_data.buffer_size_=4096;
+    json_data.chunk_size_=128;
+    const int thread_num=4;
+    const int per_thread=2000;
+    std::vector<std::string>lines;
+    {
+        AsyncWorker worker(json_data,[this](Buffer&buf){dataProcess(buf);},BufferPolicy::LOCK_FREE,16*1024,
+            [this](ChunkBuffer&chunks){
+                std::vector<struct iovec>iov;
+                chunks.toIovec(iov);
+                for(auto&v:iov) output_buffer.append(static_cast<const char*>(v.iov_base),v.iov_len);
+            });
+        worker.start();
+        std::vector<std::thread>threads;
+        for(int t=0;t<thread_num;++t)
+        {
+            threads.emplace_back([&worker,t](){
+                for(int i=0;i<per_thread;++i)
+                {
+                    std::string data=std::to_string(t)+" "+std::to_string(i)+"\n";
+                    while(!worker.push(data.c_str(),data.size())){}
+                }
+            });
+        }
+        for(auto&t:threads) t.join();
+    }
+
+    //每个线程的日志保持顺序
+    std::vector<int>next(thread_num,0);
+    std::stringstream ss(output_buffer);
+    int t,i;
+    while(ss>>t>>i)
+    {
+        ASSERT_EQ(next[t],i);
+        ++next[t];
+    }
+    for(int n:next) ASSERT_EQ(n,per_thread);
+}
+
+//块池达到内存上限时push失败，没有限制缓冲区大小时也计入丢弃条数
+TEST_F(AsyncWorkerTest,segmented_pool_limit_test)
+{
+    json_data.buffer_size_=1024*1024;
+    json_data.chunk_size_=64;
+    json_data.pool_idle_ms_=0;
+    ChunkPoolTestAccess::configure(0,std::chrono::milliseconds(0));
+    ChunkPool::getInstance().trim();
+    json_data.pool_max_bytes_=ChunkPool::getInstance().totalBytes()+64*4;
+    {
+        AsyncWorker worker(json_data,[this](Buffer&buf){dataProcess(buf);});
+        worker.start();
+        std::string data(64,'x');
+        for(int i=0;i<4;++i) ASSERT_TRUE(worker.push(data.c_str(),data.size()));
+        ASSERT_FALSE(worker.push(data.c_str(),data.size(),LogLevel::value::WARN));
+        ASSERT_EQ(worker.droppedCount(LogLevel::value::WARN),1);
+    }
+    ASSERT_EQ(output_buffer.size(),64*4);
+    ChunkPoolTestAccess::configure(0,std::chrono::seconds(30));
+}
+
+//多个分段模式的日志器设置不同的块池上限时保留非0的最小值，后创建的日志器不会取消上限
+TEST_F(AsyncWorkerTest,segmented_pool_limit_merge_test)
+{
+    auto& pool=ChunkPool::getInstance();
+    ChunkPoolTestAccess::configure(0,std::chrono::seconds(30));
+    json_data.chunk_size_=64;
+    {
+        json_data.pool_max_bytes_=1024*1024;
+        AsyncWorker capped(json_data,[this](Buffer&buf){dataProcess(buf);});
+        ASSERT_EQ(pool.maxBytes(),1024*1024);
+
+        json_data.pool_max_bytes_=0;
+        AsyncWorker unlimited(json_data,[this](Buffer&buf){dataProcess(buf);});
+        ASSERT_EQ(pool.maxBytes(),1024*1024);
+
+        json_data.pool_max_bytes_=4*1024*1024;
+        AsyncWorker looser(json_data,[this](Buffer&buf){dataProcess(buf);});
+        ASSERT_EQ(pool.maxBytes(),1024*1024);
+
+        json_data.pool_max_bytes_=512*1024;
+        AsyncWorker tighter(json_data,[this](Buffer&buf){dataProcess(buf);});
+        ASSERT_EQ(pool.maxBytes(),512*1024);
+    }
+    ChunkPoolTestAccess::configure(0,std::chrono::seconds(30));
+}
+
+//测试缓冲区队列模式，消费者阻塞时生产者换上空闲缓冲区继续写入
+TEST_F(AsyncWorkerTest,buffer_queue_test)
+{
+    json_data.buffer_size_=64;
+    json_data.buffer_count_=4;
+    std::mutex gate;
+    std::atomic_bool entered{false};
+    std::string accepted;
+    size_t accepted_after_block=0;
+
+    gate.lock();
+    {
+        AsyncWorker worker(json_data,[&](Buffer&buf){
+            entered=true;
+            std::lock_guard<std::mutex>lock(gate);
+            dataProcess(buf);
+        },BufferPolicy::LIMIT_SIZE,64);
+        worker.start();
+
+        int id=0;
+        auto push_one=[&]()->bool{
+            char data[17];
+            snprintf(data,sizeof(data),"record %07d\n",id);
+            if(!worker.push(data,16)) return false;
+            accepted.append(data,16);
+            ++id;
+            return true;
+        };
+
+        //写入超过交换阈值的数据，等待消费者阻塞在慢速的落地方向中
+        for(int i=0;i<3;++i) EXPECT_TRUE(push_one());
+        while(!entered) std::this_thread::yield();
+
+        while(push_one()) accepted_after_block+=16;
+        gate.unlock();
+    }
+
+    //双缓冲时最多只能再写入一个缓冲区，队列模式下可以写满两个空闲缓冲区
+    ASSERT_GE(accepted_after_block,64*2);
+    ASSERT_EQ(accepted,output_buffer);
+}
+
+//测试环形缓冲区模式下配置了buffer_count，退化为加锁写入时同一线程的数据仍然保持顺序
+TEST_F(AsyncWorkerTest,lock_free_buffer_count_order_test)
+{
+    json_data.buffer_count_=4;
+    std::string expected;
+    {
+        AsyncWorker worker(json_data,[this](Buffer&buf){dataProcess(buf);},BufferPolicy::LOCK_FREE);
+        worker.start();
+        for(int i=0;i<200;++i)
+        {
+            std::string data=std::to_string(i)+std::string(1500,'x')+"\n";
+            ASSERT_TRUE(worker.push(data.c_str(),data.size()));
+            expected+=data;
+        }
+    }
+    ASSERT_EQ(output_buffer,expected);
+}
 
+//测试可配置的最长等待时间
+TEST_F(AsyncWorkerTest,max_latency_test)
+{
+    json_data.buffer_size_=1024;
+    json_data.flush_max_latency_ms_=200;
+    AsyncWorker worker(json_data,[this](Buffer&buf){dataProcess(buf);});
+    worker.start();
+    std::string data="1";
+    ASSERT_TRUE(worker.push(data.c_str(),data.size()));
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    ASSERT_EQ(data,output_buffer);
+}
+
+//测试自适应刷新，流量小时日志很快被刷新，不需要等待max_latency
+TEST_F(AsyncWorkerTest,adaptive_flush_test)
+{
+    json_data.buffer_size_=1024;
+    json_data.adaptive_flush_=true;
+    std::mutex mtx;
+    std::string expected;
+    {
+        AsyncWorker worker(json_data,[&](Buffer&buf){
+            std::lock_guard<std::mutex>lock(mtx);
+            dataProcess(buf);
+        });
+        worker.start();
+        for(int i=0;i<3;++i)
+        {
+            std::string data="quiet "+std::to_string(i)+"\n";
+            expected+=data;
+            ASSERT_TRUE(worker.push(data.c_str(),data.size()));
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            std::lock_guard<std::mutex>lock(mtx);
+            ASSERT_EQ(expected,output_buffer);
+        }
+
+        //突发写入
+        for(int i=0;i<10000;++i)
+        {
+            std::string data="burst "+std::to_string(i)+"\n";
+            expected+=data;
+            ASSERT_TRUE(worker.push(data.c_str(),data.size()));
+        }
+    }
+    ASSERT_EQ(expected,output_buffer);
+}
+
+
+//测试block策略，缓冲区满时生产者等待消费者腾出空间
+TEST_F(AsyncWorkerTest,overflow_block_test)
+{
+    json_data.buffer_size_=64;
+    json_data.overflow_policy_="block";
+    json_data.overflow_block_ms_=5000;
+    std::mutex gate;
+    std::atomic_bool entered{false};
+    std::string data(16,'b');
+
+    gate.lock();
+    {
+        AsyncWorker worker(json_data,[&](Buffer&buf){
+            entered=true;
+            std::lock_guard<std::mutex>lock(gate);
+            dataProcess(buf);
+        },BufferPolicy::LIMIT_SIZE,64);
+        worker.start();
+
+        //等待消费者阻塞在慢速的落地方向中，然后写满生产者缓冲区
+        for(int i=0;i<4;++i) ASSERT_TRUE(worker.push(data.c_str(),data.size()));
+        while(!entered) std::this_thread::yield();
+        for(int i=0;i<4;++i) ASSERT_TRUE(worker.push(data.c_str(),data.size()));
+
+        std::atomic_bool done{false};
+        bool pushed=false;
+        std::thread productor([&](){
+            pushed=worker.push(data.c_str(),data.size());
+            done=true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        EXPECT_FALSE(done);
+
+        gate.unlock();
+        productor.join();
+        ASSERT_TRUE(pushed);
+        ASSERT_EQ(worker.droppedCount(LogLevel::value::INFO),0);
+    }
+    ASSERT_EQ(output_buffer,std::string(16*9,'b'));
+}
+
+//测试block策略的超时
+TEST_F(AsyncWorkerTest,overflow_block_timeout_test)
+{
+    json_data.buffer_size_=64;
+    json_data.overflow_policy_="block";
+    json_data.overflow_block_ms_=50;
+    std::mutex gate;
+    std::atomic_bool entered{false};
+    std::string data(16,'t');
+
+    gate.lock();
+    {
+        AsyncWorker worker(json_data,[&](Buffer&buf){
+            entered=true;
+            std::lock_guard<std::mutex>lock(gate);
+            dataProcess(buf);
+        },BufferPolicy::LIMIT_SIZE,64);
+        worker.start();
+
+        for(int i=0;i<4;++i) ASSERT_TRUE(worker.push(data.c_str(),data.size()));
+        while(!entered) std::this_thread::yield();
+        for(int i=0;i<4;++i) ASSERT_TRUE(worker.push(data.c_str(),data.size()));
+
+        auto begin=std::chrono::steady_clock::now();
+        ASSERT_FALSE(worker.push(data.c_str(),data.size(),LogLevel::value::WARN));
+        ASSERT_GE(std::chrono::steady_clock::now()-begin,std::chrono::milliseconds(50));
+        ASSERT_EQ(worker.droppedCount(LogLevel::value::WARN),1);
+        gate.unlock();
+    }
+    ASSERT_EQ(output_buffer,std::string(16*8,'t'));
+}
+
+//测试drop_low策略，缓冲区使用超过1/2时丢弃DEBUG，超过3/4时丢弃INFO
+TEST_F(AsyncWorkerTest,overflow_drop_low_test)
+{
+    json_data.buffer_size_=64;
+    json_data.overflow_policy_="drop_low";
+    json_data.flush_max_latency_ms_=20;
+    std::mutex gate;
+    std::atomic_bool entered{false};
+    std::vector<uint64_t>reported;
+
+    gate.lock();
+    {
+        AsyncWorker worker(json_data,[&](Buffer&buf){
+            entered=true;
+            std::lock_guard<std::mutex>lock(gate);
+            dataProcess(buf);
+        },BufferPolicy::LIMIT_SIZE,64);
+        worker.setDropReporter([&](const auto& counts){
+            reported.assign(counts.begin(),counts.end());
+        });
+        worker.start();
+
+        std::string first(64,'-');
+        ASSERT_TRUE(worker.push(first.c_str(),first.size(),LogLevel::value::WARN));
+        while(!entered) std::this_thread::yield();
+
+        auto push=[&worker](const char* data,LogLevel::value level){return worker.push(data,16,level);};
+        EXPECT_TRUE(push("debug record 01\n",LogLevel::value::DEBUG));
+        EXPECT_TRUE(push("debug record 02\n",LogLevel::value::DEBUG));
+        EXPECT_FALSE(push("debug record 03\n",LogLevel::value::DEBUG));
+        EXPECT_TRUE(push("info record 001\n",LogLevel::value::INFO));
+        EXPECT_FALSE(push("info record 002\n",LogLevel::value::INFO));
+        EXPECT_TRUE(push("warn record 001\n",LogLevel::value::WARN));
+        EXPECT_FALSE(push("error record 01\n",LogLevel::value::ERROR));
+        EXPECT_EQ(worker.droppedCount(LogLevel::value::DEBUG),1);
+        EXPECT_EQ(worker.droppedCount(LogLevel::value::INFO),1);
+        EXPECT_EQ(worker.droppedCount(LogLevel::value::ERROR),1);
+        gate.unlock();
+    }
+    ASSERT_EQ(output_buffer,std::string(64,'-')+"debug record 01\ndebug record 02\ninfo record 001\nwarn record 001\n");
+    ASSERT_EQ(reported,(std::vector<uint64_t>{1,1,0,1,0}));
+}
+
+//测试evict_low策略，缓冲区满时丢弃最早的DEBUG/INFO日志为高等级的日志腾出空间
+TEST_F(AsyncWorkerTest,overflow_evict_low_test)
+{
+    json_data.buffer_size_=64;
+    json_data.overflow_policy_="evict_low";
+    std::mutex gate;
+    std::atomic_bool entered{false};
+
+    gate.lock();
+    {
+        AsyncWorker worker(json_data,[&](Buffer&buf){
+            entered=true;
+            std::lock_guard<std::mutex>lock(gate);
+            dataProcess(buf);
+        },BufferPolicy::LIMIT_SIZE,64);
+        worker.start();
+
+        std::string first(64,'-');
+        ASSERT_TRUE(worker.push(first.c_str(),first.size()));
+        while(!entered) std::this_thread::yield();
+
+        auto push=[&worker](const std::string& data,LogLevel::value level){return worker.push(data.c_str(),data.size(),level);};
+        EXPECT_TRUE(push("debug record 01\n",LogLevel::value::DEBUG));
+        EXPECT_TRUE(push("info record 001\n",LogLevel::value::INFO));
+        EXPECT_TRUE(push("warn record 001\n",LogLevel::value::WARN));
+        EXPECT_TRUE(push("info record 002\n",LogLevel::value::INFO));
+        //缓冲区已满，丢弃最早的DEBUG日志
+        EXPECT_TRUE(push("error record 01\n",LogLevel::value::ERROR));
+        EXPECT_FALSE(push("debug record 02\n",LogLevel::value::DEBUG));
+        //丢弃剩下的两条INFO日志
+        EXPECT_TRUE(push("error record with 32 bytes long\n",LogLevel::value::ERROR));
+        //没有低等级的日志可以丢弃
+        EXPECT_FALSE(push("warn record 002\n",LogLevel::value::WARN));
+        EXPECT_EQ(worker.droppedCount(LogLevel::value::DEBUG),2);
+        EXPECT_EQ(worker.droppedCount(LogLevel::value::INFO),2);
+        EXPECT_EQ(worker.droppedCount(LogLevel::value::WARN),1);
+        gate.unlock();
+    }
+    ASSERT_EQ(output_buffer,std::string(64,'-')+"warn record 001\nerror record 01\nerror record with 32 bytes long\n");
+}
+
+//测试block策略下后台线程回收暂存区时缓冲区已满，不会等待自己腾出空间，这批数据按REJECT处理
+TEST_F(AsyncWorkerTest,overflow_block_collector_test)
+{
+    json_data.buffer_size_=64;
+    json_data.overflow_policy_="block";
+    json_data.overflow_block_ms_=5000;
+    std::mutex gate;
+    std::atomic_bool entered{false};
+    std::atomic_bool armed{false};
+    std::atomic_bool collected{false};
+    bool staged=true;
+    std::chrono::steady_clock::duration elapsed{};
+    AsyncWorker* self=nullptr;
+
+    gate.lock();
+    {
+        AsyncWorker worker(json_data,[&](Buffer&buf){
+            entered=true;
+            std::lock_guard<std::mutex>lock(gate);
+            dataProcess(buf);
+        },BufferPolicy::LIMIT_SIZE,64);
+        self=&worker;
+        worker.setCollector([&](){
+            if(!armed.exchange(false)) return;
+            auto begin=std::chrono::steady_clock::now();
+            std::string batch(32,'s');
+            staged=self->pushStaged(batch.c_str(),batch.size(),std::array<uint64_t,5>{1,2,0,0,0});
+            elapsed=std::chrono::steady_clock::now()-begin;
+            collected=true;
+        });
+        worker.start();
+
+        std::string data(64,'a');
+        ASSERT_TRUE(worker.push(data.c_str(),data.size()));
+        while(!entered) std::this_thread::yield();
+        data.assign(64,'b');
+        ASSERT_TRUE(worker.push(data.c_str(),data.size()));
+        armed=true;
+        gate.unlock();
+        while(!collected) std::this_thread::yield();
+        ASSERT_FALSE(staged);
+        ASSERT_LT(elapsed,std::chrono::milliseconds(1000));
+        ASSERT_EQ(worker.droppedCount(LogLevel::value::DEBUG),1);
+        ASSERT_EQ(worker.droppedCount(LogLevel::value::INFO),2);
+    }
+    ASSERT_EQ(output_buffer,std::string(64,'a')+std::string(64,'b'));
+}
+
+//测试暂存区提交的一批数据被拒绝或者被挤出时，按批内每个等级的条数统计丢弃
+TEST_F(AsyncWorkerTest,staged_batch_drop_count_test)
+{
+    for(const char* policy:{"reject","evict_low"})
+    {
+        json_data.buffer_size_=64;
+        json_data.overflow_policy_=policy;
+        std::mutex gate;
+        std::atomic_bool entered{false};
+        output_buffer.clear();
+
+        gate.lock();
+        {
+            AsyncWorker worker(json_data,[&](Buffer&buf){
+                entered=true;
+                std::lock_guard<std::mutex>lock(gate);
+                dataProcess(buf);
+            },BufferPolicy::LIMIT_SIZE,64);
+            worker.start();
+
+            std::string first(64,'-');
+            ASSERT_TRUE(worker.push(first.c_str(),first.size(),LogLevel::value::WARN));
+            while(!entered) std::this_thread::yield();
+
+            //一批3条DEBUG和2条INFO日志
+            std::string low(48,'l');
+            ASSERT_TRUE(worker.pushStaged(low.c_str(),low.size(),std::array<uint64_t,5>{3,2,0,0,0}));
+            //一批1条INFO和1条WARN日志，放不下时不能被挤出
+            std::string mixed(32,'m');
+            bool evict=std::string(policy)=="evict_low";
+            ASSERT_EQ(worker.pushStaged(mixed.c_str(),mixed.size(),std::array<uint64_t,5>{0,1,1,0,0}),evict);
+            if(evict)
+            {
+                EXPECT_EQ(worker.droppedCount(LogLevel::value::DEBUG),3);
+                EXPECT_EQ(worker.droppedCount(LogLevel::value::INFO),2);
+                EXPECT_EQ(worker.droppedCount(LogLevel::value::WARN),0);
+                std::string error(48,'e');
+                ASSERT_FALSE(worker.pushStaged(error.c_str(),error.size(),std::array<uint64_t,5>{0,0,0,2,0}));
+                EXPECT_EQ(worker.droppedCount(LogLevel::value::ERROR),2);
+            }
+            else
+            {
+                EXPECT_EQ(worker.droppedCount(LogLevel::value::DEBUG),0);
+                EXPECT_EQ(worker.droppedCount(LogLevel::value::INFO),1);
+                EXPECT_EQ(worker.droppedCount(LogLevel::value::WARN),1);
+            }
+            gate.unlock();
+        }
+        if(std::string(policy)=="evict_low") ASSERT_EQ(output_buffer,std::string(64,'-')+std::string(32,'m'));
+        else ASSERT_EQ(output_buffer,std::string(64,'-')+std::string(48,'l'));
+    }
+}
+
+//测试sync立即刷新之前写入的数据并落盘
+TEST_F(AsyncWorkerTest,sync_test)
+{
+    json_data.buffer_size_=1024;
+    std::mutex mtx;
+    std::atomic<int> sync_count{0};
+    AsyncWorker worker(json_data,[&](Buffer&buf){
+        std::lock_guard<std::mutex>lock(mtx);
+        dataProcess(buf);
+    });
+    worker.setSyncFunctor([&](){++sync_count;});
+    worker.start();
+
+    std::string data="durable record\n";
+    ASSERT_TRUE(worker.push(data.c_str(),data.size()));
+    auto begin=std::chrono::steady_clock::now();
+    ASSERT_TRUE(worker.sync(std::chrono::milliseconds(1000)));
+    ASSERT_LT(std::chrono::steady_clock::now()-begin,std::chrono::milliseconds(1000));
+    {
+        std::lock_guard<std::mutex>lock(mtx);
+        ASSERT_EQ(output_buffer,data);
+    }
+    ASSERT_EQ(sync_count,1);
+
+    worker.stop();
+    ASSERT_FALSE(worker.sync(std::chrono::milliseconds(10)));
+}
 
+//测试多个线程同时sync时共享落盘
+TEST_F(AsyncWorkerTest,sync_group_commit_test)
+{
+    json_data.buffer_size_=1024;
+    std::atomic<int> sync_count{0};
+    AsyncWorker worker(json_data,[this](Buffer&buf){dataProcess(buf);});
+    worker.setSyncFunctor([&](){
+        ++sync_count;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    });
+    worker.start();
+
+    const int thread_num=8;
+    std::atomic<int> ready{0};
+    std::atomic<int> succeed{0};
+    std::vector<std::thread>threads;
+    for(int i=0;i<thread_num;++i)
+    {
+        threads.emplace_back([&,i](){
+            std::string data="record "+std::to_string(i)+"\n";
+            worker.push(data.c_str(),data.size());
+            ++ready;
+            while(ready<thread_num) std::this_thread::yield();
+            if(worker.sync(std::chrono::milliseconds(2000))) ++succeed;
+        });
+    }
+    for(auto&t:threads) t.join();
+    ASSERT_EQ(succeed,thread_num);
+    ASSERT_LT(sync_count,thread_num);
+}
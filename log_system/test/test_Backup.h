@@ -0,0 +1,200 @@
+#pragma once
+
+#include "test_helper.h"
+#include "AsyncLogger.hpp"
+#include "backlog/SerBackUpLog.hpp"
+
+using namespace asynclog;
+
+class BackupTest: public ::testing::Test
+{
+protected:
+    void SetUp()override
+    {
+        fs::remove_all(dir_);
+        json_data.backup_addr_="127.0.0.1";
+        json_data.backup_spill_path_=dir_+"/spill.bin";
+        json_data.backup_retry_max_ms_=200;
+    }
+    void TearDown()override
+    {
+        fs::remove_all(dir_);
+    }
+
+    //启动接收端，收到的记录保存在records_中
+    std::unique_ptr<BackupServer> startServer(uint16_t port)
+    {
+        auto server=std::make_unique<BackupServer>(port,[this](std::string_view record){
+            std::lock_guard<std::mutex>lock(mtx_);
+            records_.emplace_back(record);
+        });
+        EXPECT_TRUE(server->start());
+        return server;
+    }
+
+    //等待收到n条记录，超时返回false
+    bool waitRecords(size_t n)
+    {
+        for(int i=0;i<500;++i)
+        {
+            {
+                std::lock_guard<std::mutex>lock(mtx_);
+                if(records_.size()>=n) return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return false;
+    }
+
+    const std::string dir_="./backup_test";
+    Util::JsonUtil::JsonData json_data;
+    std::mutex mtx_;
+    std::vector<std::string>records_;
+};
+
+//测试多条记录合并成批发送，接收端按顺序拆出每条记录
+TEST_F(BackupTest,batch_send_test)
+{
+    auto server=startServer(0);
+    json_data.backup_batch_bytes_=256;
+    {
+        BackupClient client("127.0.0.1",server->port(),json_data);
+        for(int i=0;i<100;++i)
+        {
+            std::string record="error record "+std::to_string(i)+"\n";
+            ASSERT_TRUE(client.post(record.data(),record.size()));
+        }
+        ASSERT_TRUE(waitRecords(100));
+        ASSERT_EQ(client.sentCount(),100);
+    }
+    for(int i=0;i<100;++i)
+    {
+        ASSERT_EQ(records_[i],"error record "+std::to_string(i)+"\n");
+    }
+}
+
+//测试备份服务器不可用时写入溢出文件，服务器恢复之后先补发溢出文件中的记录
+TEST_F(BackupTest,spill_and_replay_test)
+{
+    //先占用一个端口再关闭，保证客户端连接失败
+    uint16_t port=startServer(0)->port();
+
+    BackupClient client("127.0.0.1",port,json_data);
+    for(int i=0;i<5;++i)
+    {
+        std::string record="offline "+std::to_string(i);
+        ASSERT_TRUE(client.post(record.data(),record.size()));
+    }
+    for(int i=0;i<500&&client.spilledCount()<5;++i) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_EQ(client.spilledCount(),5);
+    ASSERT_TRUE(fs::exists(client.spillPath()));
+
+    auto server=startServer(port);
+    std::string record="online";
+    ASSERT_TRUE(client.post(record.data(),record.size()));
+    ASSERT_TRUE(waitRecords(6));
+    for(int i=0;i<5;++i) ASSERT_EQ(records_[i],"offline "+std::to_string(i));
+    ASSERT_EQ(records_[5],"online");
+    ASSERT_FALSE(fs::exists(client.spillPath()));
+}
+
+//测试备份服务器长时间不可用时，重连间隔之间新的记录也及时写入溢出文件，总量超过内存队列的上限也不丢弃
+TEST_F(BackupTest,spill_during_outage_test)
+{
+    json_data.backup_queue_bytes_=100;
+    json_data.backup_retry_max_ms_=5000;
+    uint16_t port=startServer(0)->port();
+
+    BackupClient client("127.0.0.1",port,json_data);
+    //每轮50字节，共1000字节，轮次之间的间隔远小于重连间隔
+    for(int round=0;round<20;++round)
+    {
+        for(int i=0;i<5;++i)
+        {
+            ASSERT_TRUE(client.post("0123456789",10));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    for(int i=0;i<500&&client.spilledCount()<100;++i) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_EQ(client.spilledCount(),100);
+    ASSERT_EQ(client.droppedCount(),0);
+    ASSERT_EQ(fs::file_size(client.spillPath()),100*(BackupFrame::kHeaderSize+10));
+}
+
+//测试配置相同溢出路径的多个客户端各自使用自己的溢出文件
+TEST_F(BackupTest,spill_path_per_client_test)
+{
+    uint16_t port=startServer(0)->port();
+    BackupClient first("127.0.0.1",port,json_data);
+    BackupClient second("127.0.0.1",port,json_data);
+    ASSERT_NE(first.spillPath(),second.spillPath());
+    ASSERT_TRUE(first.post("first",5));
+    ASSERT_TRUE(second.post("second",6));
+    for(int i=0;i<500&&(first.spilledCount()<1||second.spilledCount()<1);++i) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_EQ(fs::file_size(first.spillPath()),BackupFrame::kHeaderSize+5);
+    ASSERT_EQ(fs::file_size(second.spillPath()),BackupFrame::kHeaderSize+6);
+}
+
+//测试已经退出的进程留下的同一个服务器的溢出文件由新的客户端接管补发
+TEST_F(BackupTest,orphan_spill_replay_test)
+{
+    auto server=startServer(0);
+    //不存在的进程号
+    std::string orphan=dir_+"/spill.bin.127.0.0.1_"+std::to_string(server->port())+".2147483632.0";
+    fs::create_directories(dir_);
+    {
+        std::string frames;
+        BackupFrame::append(frames,"orphan 0",8);
+        BackupFrame::append(frames,"orphan 1",8);
+        std::ofstream(orphan,std::ios::binary)<<frames;
+    }
+
+    BackupClient client("127.0.0.1",server->port(),json_data);
+    ASSERT_TRUE(client.post("online",6));
+    ASSERT_TRUE(waitRecords(3));
+    ASSERT_EQ(records_[0],"orphan 0");
+    ASSERT_EQ(records_[1],"orphan 1");
+    ASSERT_EQ(records_[2],"online");
+    ASSERT_FALSE(fs::exists(orphan));
+}
+
+//测试内存队列满时丢弃新的记录
+TEST_F(BackupTest,queue_limit_test)
+{
+    json_data.backup_queue_bytes_=10;
+    json_data.backup_spill_path_="";
+    uint16_t port=startServer(0)->port();
+    BackupClient client("127.0.0.1",port,json_data);
+    size_t accepted=0;
+    for(int i=0;i<100;++i)
+    {
+        if(client.post("0123456789",10)) ++accepted;
+    }
+    ASSERT_GE(client.droppedCount(),100-accepted);
+    ASSERT_LT(accepted,100);
+}
+
+//测试日志器只转发ERROR/FATAL日志
+TEST_F(BackupTest,logger_forward_test)
+{
+    auto server=startServer(0);
+    json_data.backup_enabled_=true;
+    json_data.backup_port_=server->port();
+    json_data.buffer_size_=1024;
+    {
+        std::vector<std::shared_ptr<LogFlush>>flushes{std::make_shared<StdOutFlush>()};
+        AsyncLogger logger("backup_log",flushes,nullptr,json_data);
+        std::streambuf* old_buf=std::cout.rdbuf();
+        std::ostringstream oss;
+        std::cout.rdbuf(oss.rdbuf());
+        logger.info("b.cpp",1,"normal message");
+        logger.error("b.cpp",2,"disk %s failed","sda");
+        logger.fatalFmt("process {} aborted",42);
+        ASSERT_TRUE(waitRecords(2));
+        ASSERT_TRUE(logger.sync());
+        std::cout.rdbuf(old_buf);
+    }
+    ASSERT_EQ(records_.size(),2);
+    EXPECT_THAT(records_[0],::testing::HasSubstr("\tdisk sda failed\n"));
+    EXPECT_THAT(records_[1],::testing::HasSubstr("\tprocess 42 aborted\n"));
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "test_helper.h"
+#include "BinaryLog.hpp"
+
+using namespace asynclog;
+
+//编码一条内联调用点信息的记录
+inline void encodeInline(std::string& out,LogLevel::value level,const char* file,size_t line,const char* format,...)
+{
+    va_list args;
+    va_start(args,format);
+    Binary::encode(out,nullptr,level,file,line,format,args);
+    va_end(args);
+}
+
+inline void encodeSite(std::string& out,const CallSite* site,...)
+{
+    va_list args;
+    va_start(args,site);
+    Binary::encode(out,site,site->level_,site->file_,site->line_,site->format_,args);
+    va_end(args);
+}
+
+//取出渲染结果中'\t'之后的消息体
+inline std::string payloadOf(const std::string& line)
+{
+    auto pos=line.find('\t');
+    return line.substr(pos+1);
+}
+
+TEST(BinaryLogTest,call_site_registry_test)
+{
+    static const CallSite site1(LogLevel::value::INFO,"a.cpp",1,"first");
+    static const CallSite site2(LogLevel::value::WARN,"b.cpp",2,"second");
+    ASSERT_NE(site1.id_,0);
+    ASSERT_EQ(site2.id_,site1.id_+1);
+    ASSERT_EQ(CallSiteRegistry::getInstance().get(site1.id_),&site1);
+    ASSERT_EQ(CallSiteRegistry::getInstance().get(site2.id_),&site2);
+    ASSERT_EQ(CallSiteRegistry::getInstance().get(0),nullptr);
+}
+
+//延迟格式化的结果应该和printf完全一致
+TEST(BinaryLogTest,encode_decode_test)
+{
+    const char* fmt="%d|%5.2f|%s|%-8s|%x|%llu|%c|%%|%*d|%.*s|%zu|%ld|%08.3Lf|%hhd|%e|%10.3s";
+    std::string dynamic="dynamic string";
+    std::string record;
+    encodeInline(record,LogLevel::value::INFO,"binary.cpp",42,fmt,
+        -7,3.14159,dynamic.c_str(),"ab",255u,123456789012345ULL,'z',6,42,3,"abcdef",size_t(99),-5L,2.5L,300,1e-9,"truncated");
+    //编码之后修改原字符串，验证记录中保存的是拷贝
+    dynamic[0]='D';
+
+    char expected[512];
+    snprintf(expected,sizeof(expected),fmt,
+        -7,3.14159,"dynamic string","ab",255u,123456789012345ULL,'z',6,42,3,"abcdef",size_t(99),-5L,2.5L,300,1e-9,"truncated");
+
+    std::string out;
+    size_t n=Binary::decode(record.data(),record.size(),"bin_logger",out);
+    ASSERT_EQ(n,record.size());
+    EXPECT_THAT(out,::testing::HasSubstr("[INFO][bin_logger][binary.cpp:42]\t"));
+    EXPECT_EQ(payloadOf(out),std::string(expected)+"\n");
+}
+
+TEST(BinaryLogTest,call_site_record_test)
+{
+    static const CallSite site(LogLevel::value::ERROR,"site.cpp",7,"value=%d name=%s");
+    std::string record;
+    encodeSite(record,&site,10,"x");
+    encodeSite(record,&site,20,"y");
+
+    std::vector<LogLevel::value>levels;
+    std::string out;
+    Binary::decode(record.data(),record.size(),"bin_logger",out,
+        [&levels](LogLevel::value level,const char*,size_t){levels.push_back(level);});
+    EXPECT_THAT(out,::testing::HasSubstr("[ERROR][bin_logger][site.cpp:7]\tvalue=10 name=x\n"));
+    EXPECT_THAT(out,::testing::HasSubstr("[ERROR][bin_logger][site.cpp:7]\tvalue=20 name=y\n"));
+    ASSERT_EQ(levels.size(),2);
+}
+
+//损坏的记录不会被解析，输出一条说明丢弃字节数的诊断日志
+TEST(BinaryLogTest,corrupted_record_test)
+{
+    std::string record;
+    encodeInline(record,LogLevel::value::INFO,"a.cpp",1,"%d",1);
+    std::string out;
+    ASSERT_EQ(Binary::decode(record.data(),record.size()-1,"bin_logger",out),0);
+    EXPECT_THAT(out,::testing::HasSubstr("[WARN][bin_logger]["));
+    EXPECT_THAT(out,::testing::HasSubstr("]\tbinary log: "+std::to_string(record.size()-1)+" bytes of corrupt records discarded\n"));
+    EXPECT_THAT(out,::testing::Not(::testing::HasSubstr("a.cpp:1")));
+}
+
+//调用点未知的记录按照长度跳过，之后的记录正常输出
+TEST(BinaryLogTest,skip_unknown_site_test)
+{
+    std::string data;
+    encodeInline(data,LogLevel::value::INFO,"a.cpp",1,"before %d",1);
+    size_t bad_begin=data.size();
+    encodeInline(data,LogLevel::value::INFO,"b.cpp",2,"unknown %d",2);
+    size_t bad_len=data.size()-bad_begin;
+    uint32_t bad_id=UINT32_MAX-1;
+    std::memcpy(data.data()+bad_begin+offsetof(Binary::RecordHeader,site_id_),&bad_id,sizeof(bad_id));
+    encodeInline(data,LogLevel::value::INFO,"c.cpp",3,"after %d",3);
+
+    std::string out;
+    ASSERT_EQ(Binary::decode(data.data(),data.size(),"bin_logger",out),data.size());
+    EXPECT_THAT(out,::testing::HasSubstr("[a.cpp:1]\tbefore 1\n"));
+    EXPECT_THAT(out,::testing::HasSubstr("[c.cpp:3]\tafter 3\n"));
+    EXPECT_THAT(out,::testing::Not(::testing::HasSubstr("unknown")));
+    EXPECT_THAT(out,::testing::HasSubstr("binary log: "+std::to_string(bad_len)+" bytes of corrupt records discarded\n"));
+}
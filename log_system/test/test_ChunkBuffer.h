@@ -0,0 +1,128 @@
+#pragma once
+
+#include "test_helper.h"
+#include "ChunkBuffer.hpp"
+
+using namespace asynclog;
+
+namespace asynclog
+{
+//块池是进程内的单例，日志器只能收紧它的设置，测试之间通过这里恢复
+struct ChunkPoolTestAccess
+{
+    static void configure(size_t max_bytes,std::chrono::milliseconds idle_time)
+    {
+        ChunkPool::getInstance().configure(max_bytes,idle_time);
+    }
+};
+} // namespace asynclog
+
+class ChunkBufferTest: public ::testing::Test
+{
+protected:
+    void SetUp()override
+    {
+        json_data.chunk_size_=8;
+        json_data.buffer_size_=32;
+    }
+
+    //把所有块拼接起来
+    static std::string content(const ChunkBuffer& buf)
+    {
+        std::vector<struct iovec>iov;
+        buf.toIovec(iov);
+        std::string ret;
+        for(auto& v:iov) ret.append(static_cast<const char*>(v.iov_base),v.iov_len);
+        return ret;
+    }
+
+    Util::JsonUtil::JsonData json_data;
+};
+
+TEST_F(ChunkBufferTest,push_test)
+{
+    ChunkBuffer buf(json_data);
+    ASSERT_TRUE(buf.isEmpty());
+
+    buf.push("hello",5);
+    ASSERT_EQ(buf.chunkCount(),1);
+    //跨越多个块的写入
+    buf.push(" world, chunk",13);
+    ASSERT_EQ(buf.readableBytes(),18);
+    ASSERT_EQ(buf.chunkCount(),3);
+    ASSERT_EQ(content(buf),"hello world, chunk");
+
+    std::vector<struct iovec>iov;
+    ASSERT_EQ(buf.toIovec(iov),3);
+    ASSERT_EQ(iov[0].iov_len,8);
+    ASSERT_EQ(iov[2].iov_len,2);
+}
+
+//reset之后块归还给ChunkPool，由其它缓冲区复用
+TEST_F(ChunkBufferTest,reuse_test)
+{
+    auto& pool=ChunkPool::getInstance();
+    ChunkBuffer buf(json_data);
+    std::string data(8*6,'x');
+    ASSERT_TRUE(buf.push(data.data(),data.size()));
+    ASSERT_EQ(buf.chunkCount(),6);
+
+    size_t free_bytes=pool.freeBytes();
+    buf.reset();
+    ASSERT_TRUE(buf.isEmpty());
+    ASSERT_EQ(buf.chunkCount(),0);
+    ASSERT_EQ(pool.freeBytes(),free_bytes+8*6);
+
+    ChunkBuffer other(json_data);
+    size_t total_bytes=pool.totalBytes();
+    ASSERT_TRUE(other.push("abc",3));
+    ASSERT_EQ(pool.totalBytes(),total_bytes);
+    ASSERT_EQ(content(other),"abc");
+}
+
+//块池的内存上限和空闲释放
+TEST_F(ChunkBufferTest,pool_limit_test)
+{
+    auto& pool=ChunkPool::getInstance();
+    ChunkPoolTestAccess::configure(0,std::chrono::milliseconds(0));
+    pool.trim();
+    ASSERT_EQ(pool.freeBytes(),0);
+
+    ChunkPoolTestAccess::configure(pool.totalBytes()+8*2,std::chrono::milliseconds(0));
+    {
+        ChunkBuffer buf(json_data);
+        ASSERT_TRUE(buf.push("0123456789",10));
+        //超过上限时不写入任何数据
+        ASSERT_FALSE(buf.push("0123456789",10));
+        ASSERT_EQ(buf.readableBytes(),10);
+        ASSERT_TRUE(buf.push("abcdef",6));
+        ASSERT_EQ(content(buf),"0123456789abcdef");
+    }
+    ASSERT_EQ(pool.freeBytes(),8*2);
+    pool.trim();
+    ASSERT_EQ(pool.freeBytes(),0);
+
+    ChunkPoolTestAccess::configure(0,std::chrono::seconds(30));
+}
+
+TEST_F(ChunkBufferTest,swap_and_splice_test)
+{
+    ChunkBuffer a(json_data);
+    ChunkBuffer b(json_data);
+    a.push("0123456789",10);
+    b.push("xyz",3);
+
+    a.swap(b);
+    ASSERT_EQ(content(a),"xyz");
+    ASSERT_EQ(content(b),"0123456789");
+
+    //splice不拷贝数据，中间的块可以没有写满
+    a.splice(b);
+    ASSERT_TRUE(b.isEmpty());
+    ASSERT_EQ(a.readableBytes(),13);
+    ASSERT_EQ(content(a),"xyz0123456789");
+
+    Buffer out(json_data);
+    a.appendTo(out);
+    ASSERT_EQ(std::string(out.peek(),out.readableBytes()),"xyz0123456789");
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "test_helper.h"
+#include "Clock.hpp"
+
+TEST(ClockTest,precision_from_string_test)
+{
+    using namespace asynclog;
+    TimePrecision precision=TimePrecision::SECOND;
+    ASSERT_TRUE(Clock::precisionFromString("us",precision));
+    ASSERT_EQ(precision,TimePrecision::MICRO);
+    ASSERT_TRUE(Clock::precisionFromString("ns",precision));
+    ASSERT_EQ(precision,TimePrecision::NANO);
+    ASSERT_FALSE(Clock::precisionFromString("minute",precision));
+    ASSERT_EQ(precision,TimePrecision::NANO);
+    ASSERT_EQ(Clock::fractionDigits(TimePrecision::SECOND),0);
+    ASSERT_EQ(Clock::fractionDigits(TimePrecision::MILLI),3);
+}
+
+//高精度时钟和系统时间的偏差应该很小
+TEST(ClockTest,tsc_clock_test)
+{
+    using namespace asynclog;
+    auto& clock=Clock::TscClock::getInstance();
+    clock.resync();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    uint64_t real=Clock::realtimeNs();
+    uint64_t now=clock.nowNs();
+    uint64_t diff= now>real ? now-real : real-now;
+    ASSERT_LT(diff,2000000ULL);
+
+    //同一秒内的两次读取可以区分先后
+    uint64_t first=clock.nowNs();
+    uint64_t second=clock.nowNs();
+    ASSERT_LE(first,second);
+
+    Timestamp ts=Clock::now(TimePrecision::MICRO);
+    ASSERT_LT(ts.nsec_,1000000000u);
+    ASSERT_NEAR(ts.sec_,time(nullptr),1);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "test_helper.h"
+#include "FlushScheduler.hpp"
+
+using namespace std::chrono_literals;
+
+TEST(FlushSchedulerTest,quiet_test)
+{
+    asynclog::FlushScheduler scheduler(3000ms,1024*1024);
+    //没有样本时尽快刷新
+    ASSERT_EQ(scheduler.interval(),1ms);
+    ASSERT_EQ(scheduler.threshold(),4096);
+
+    //流量很小、落地很快时仍然很快刷新
+    scheduler.record(100,1s,100us);
+    ASSERT_EQ(scheduler.interval(),1ms);
+    ASSERT_EQ(scheduler.threshold(),4096);
+}
+
+TEST(FlushSchedulerTest,burst_test)
+{
+    asynclog::FlushScheduler scheduler(3000ms,1024*1024);
+    //落地变慢时拉长等待时间，阈值随写入速率增大
+    for(int i=0;i<50;++i) scheduler.record(64*1024*1024,1s,20ms);
+    ASSERT_GT(scheduler.interval(),30ms);
+    ASSERT_LT(scheduler.interval(),50ms);
+    ASSERT_EQ(scheduler.threshold(),1024*1024);
+
+    //上限
+    for(int i=0;i<50;++i) scheduler.record(1024,1s,10s);
+    ASSERT_EQ(scheduler.interval(),3000ms);
+
+    //没有流量时速率衰减
+    double rate=scheduler.rate();
+    scheduler.record(0,1s,0ms);
+    ASSERT_LT(scheduler.rate(),rate);
+}
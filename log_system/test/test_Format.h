@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <new>
+
+#include "test_helper.h"
+#include "Format.hpp"
+
+//统计当前线程堆内存分配的次数，用于验证类型安全的日志接口不使用堆内存
+inline thread_local bool g_count_alloc=false;
+inline std::atomic<size_t> g_alloc_count{0};
+
+void* operator new(size_t size)
+{
+    if(g_count_alloc) g_alloc_count.fetch_add(1);
+    void* p=malloc(size==0 ? 1 : size);
+    if(p==nullptr) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p)noexcept {free(p);}
+void operator delete(void* p,size_t)noexcept {free(p);}
+
+using namespace asynclog;
+
+template<typename... Args>
+std::string formatToString(FormatStringFor<Args...> fmt,Args&&... args)
+{
+    Fmt::LineWriter w;
+    fmt.format(w,args...);
+    return std::string(w.data(),w.size());
+}
+
+TEST(FormatTest,format_test)
+{
+    std::string_view sv="view";
+    std::string str="string";
+    const char* null_str=nullptr;
+    EXPECT_EQ(formatToString("no args"),"no args");
+    EXPECT_EQ(formatToString("{} {} {}",1,-2L,3ULL),"1 -2 3");
+    EXPECT_EQ(formatToString("{}|{}",1.5,0.1f),"1.5|0.1");
+    EXPECT_EQ(formatToString("{} {} {} {}",sv,str,"literal",null_str),"view string literal (null)");
+    EXPECT_EQ(formatToString("{}{}",true,'c'),"truec");
+    EXPECT_EQ(formatToString("{{{}}} {{}}",7),"{7} {}");
+    EXPECT_EQ(formatToString("{}",static_cast<void*>(nullptr)),"0x0");
+}
+
+//片段是在编译期计算的
+TEST(FormatTest,constexpr_test)
+{
+    constexpr FormatString<int,int> fmt("a{}b{}c");
+    static_assert(fmt.str()=="a{}b{}c");
+    Fmt::LineWriter w;
+    fmt.format(w,1,2);
+    EXPECT_EQ(std::string(w.data(),w.size()),"a1b2c");
+}
+
+//超过栈上缓冲区大小的日志使用堆内存
+TEST(FormatTest,line_writer_overflow_test)
+{
+    std::string large(Fmt::LineWriter::kInlineSize*2,'x');
+    EXPECT_EQ(formatToString("[{}]",large),"["+large+"]");
+}
+
+//同一秒内复用缓存，跨秒时重新格式化
+TEST(FormatTest,date_text_test)
+{
+    time_t t=Util::Date::now();
+    char buf[32];
+    struct tm tm_;
+    localtime_r(&t,&tm_);
+    size_t n=strftime(buf,sizeof(buf),"%Y-%m-%d %H:%M:%S",&tm_);
+    EXPECT_EQ(Fmt::dateText(t),std::string_view(buf,n));
+    EXPECT_EQ(Fmt::dateText(t).data(),Fmt::dateText(t).data());
+
+    localtime_r(&(++t),&tm_);
+    n=strftime(buf,sizeof(buf),"%Y-%m-%d %H:%M:%S",&tm_);
+    EXPECT_EQ(Fmt::dateText(t),std::string_view(buf,n));
+}
+
+//不同精度下小数部分的位数
+TEST(FormatTest,header_precision_test)
+{
+    Timestamp ts{Util::Date::now(),123456789};
+    std::string date(Fmt::dateText(ts.sec_));
+    auto header=[&ts](TimePrecision precision){
+        std::string out;
+        Fmt::writeHeader(out,ts,precision,"1",LogLevel::value::INFO,"name","a.cpp",1);
+        return out;
+    };
+    EXPECT_EQ(header(TimePrecision::SECOND),"["+date+"][1][INFO][name][a.cpp:1]\t");
+    EXPECT_EQ(header(TimePrecision::MILLI),"["+date+".123][1][INFO][name][a.cpp:1]\t");
+    EXPECT_EQ(header(TimePrecision::MICRO),"["+date+".123456][1][INFO][name][a.cpp:1]\t");
+    EXPECT_EQ(header(TimePrecision::NANO),"["+date+".123456789][1][INFO][name][a.cpp:1]\t");
+    ts.nsec_=5000;
+    EXPECT_EQ(header(TimePrecision::MICRO),"["+date+".000005][1][INFO][name][a.cpp:1]\t");
+}
@@ -11,4 +11,16 @@ TEST(LevelTest,base_test)
     ASSERT_EQ(LogLevel::toString(LogLevel::value::WARN),"WARN");
     ASSERT_EQ(LogLevel::toString(LogLevel::value::ERROR),"ERROR");
     ASSERT_EQ(LogLevel::toString(LogLevel::value::FATAL),"FATAL");
-}
\ No newline at end of file
+}
+TEST(LevelTest,from_string_test)
+{
+    using namespace asynclog;
+    LogLevel::value level=LogLevel::value::DEBUG;
+    ASSERT_TRUE(LogLevel::fromString("WARN",level));
+    ASSERT_EQ(level,LogLevel::value::WARN);
+    ASSERT_TRUE(LogLevel::fromString("FATAL",level));
+    ASSERT_EQ(level,LogLevel::value::FATAL);
+    ASSERT_FALSE(LogLevel::fromString("VERBOSE",level));
+    ASSERT_EQ(level,LogLevel::value::FATAL);
+    ASSERT_TRUE(LogLevel::enabled(LogLevel::value::DEBUG));
+}
@@ -2,6 +2,9 @@
 
 #include "test_helper.h"
 
+#include <fstream>
+#include <map>
+
 #include "LogFlush.hpp"
 
 namespace fs = std::filesystem;
@@ -20,6 +23,14 @@ public:
     MOCK_METHOD(int, fileno, (FILE*), (override));
     MOCK_METHOD(int, fsync, (int), (override));
     MOCK_METHOD(int, ferror, (FILE*), (override));
+    MOCK_METHOD(int, open, (const char*, int, mode_t), (override));
+    MOCK_METHOD(int, close, (int), (override));
+    MOCK_METHOD(ssize_t, writev, (int, const struct iovec*, int), (override));
+    MOCK_METHOD(ssize_t, pwritev2, (int, const struct iovec*, int, off_t, int), (override));
+    MOCK_METHOD(int, fdatasync, (int), (override));
+    MOCK_METHOD(int, rename, (const char*, const char*), (override));
+    MOCK_METHOD(int, remove, (const char*), (override));
+    MOCK_METHOD(std::vector<std::string>, listDirectory, (const std::string&), (override));
     MOCK_METHOD(void, perror, (const char*), (override));
     MOCK_METHOD(void, createDirectory, (const std::string&), (override));
     MOCK_METHOD(time_t, now, (), (override));
@@ -120,6 +131,55 @@ TEST_F(LogFlushTest,FileFlush_success_test_mutiple_write)
     file_flush->flush(data.c_str(),data.size());
 }
 
+//测试FileFlush一次写入多段数据时只刷新一次
+TEST_F(LogFlushTest,FileFlush_flushv_test)
+{
+    json_data.flush_log_=2;
+    auto mock=std::make_unique<MockSystemOps>();
+    MockSystemOps* m=mock.get();
+
+    EXPECT_CALL(*m,createDirectory(_));
+    EXPECT_CALL(*m,fopen(_,_)).WillOnce(Return(kFakeFile));
+
+    std::string first="hello ";
+    std::string second="world";
+    struct iovec iov[2]={{first.data(),first.size()},{second.data(),second.size()}};
+
+    EXPECT_CALL(*m,fwrite(first.data(),1,first.size(),kFakeFile)).WillOnce(Return(first.size()));
+    EXPECT_CALL(*m,fwrite(second.data(),1,second.size(),kFakeFile)).WillOnce(Return(second.size()));
+    EXPECT_CALL(*m,fflush(kFakeFile)).Times(1).WillOnce(Return(0));
+    EXPECT_CALL(*m,fileno(kFakeFile)).WillOnce(Return(12345));
+    EXPECT_CALL(*m,fsync(12345)).Times(1).WillOnce(Return(0));
+    EXPECT_CALL(*m,fclose(kFakeFile)).Times(1).WillOnce(Return(0));
+
+    auto file_flush=LogFlushFactory<FileFlush>::createLogFlush("place holder",json_data,std::move(mock));
+    file_flush->flushv(iov,2);
+}
+
+//测试flush_log为0时写入不刷新，sync时刷新并落盘
+TEST_F(LogFlushTest,FileFlush_sync_test)
+{
+    json_data.flush_log_=0;
+    auto mock=std::make_unique<MockSystemOps>();
+    MockSystemOps* m=mock.get();
+
+    EXPECT_CALL(*m,createDirectory(_));
+    EXPECT_CALL(*m,fopen(_,_)).WillOnce(Return(kFakeFile));
+    std::string data="hello world";
+    {
+        InSequence seq;
+        EXPECT_CALL(*m,fwrite(data.c_str(),1,data.size(),kFakeFile)).WillOnce(Return(data.size()));
+        EXPECT_CALL(*m,fflush(kFakeFile)).WillOnce(Return(0));
+        EXPECT_CALL(*m,fileno(kFakeFile)).WillOnce(Return(12345));
+        EXPECT_CALL(*m,fsync(12345)).WillOnce(Return(0));
+        EXPECT_CALL(*m,fclose(kFakeFile)).WillOnce(Return(0));
+    }
+
+    auto file_flush=LogFlushFactory<FileFlush>::createLogFlush("place holder",json_data,std::move(mock));
+    file_flush->flush(data.c_str(),data.size());
+    file_flush->sync();
+}
+
 TEST_F(LogFlushTest,FileFlush_fail_test_fopen)
 {
     auto mock=std::make_unique<MockSystemOps>();
@@ -362,3 +422,353 @@ TEST_F(LogFlushTest,RollFileFlush_fail_test_fsync)
 
 
 
+
+//模拟writev，把写入的数据追加到out中，每次最多写入limit字节
+static ssize_t fakeWritev(std::string& out,const struct iovec* iov,int cnt,size_t limit)
+{
+    size_t written=0;
+    for(int i=0;i<cnt&&written<limit;++i)
+    {
+        size_t n=std::min(iov[i].iov_len,limit-written);
+        out.append(static_cast<const char*>(iov[i].iov_base),n);
+        written+=n;
+    }
+    return static_cast<ssize_t>(written);
+}
+
+//测试WritevFileFlush处理部分写入和EINTR
+TEST_F(LogFlushTest,WritevFileFlush_partial_write_test)
+{
+    auto mock=std::make_unique<MockSystemOps>();
+    MockSystemOps* m=mock.get();
+    const int kFakeFd=42;
+
+    EXPECT_CALL(*m,createDirectory(_));
+    EXPECT_CALL(*m,open(_,_,_)).WillOnce(Return(kFakeFd));
+
+    std::string first="hello ";
+    std::string second="writev ";
+    std::string third="world";
+    struct iovec iov[3]={{first.data(),first.size()},{second.data(),second.size()},{third.data(),third.size()}};
+
+    std::string output;
+    {
+        InSequence seq;
+        //第一次只写入8个字节，第二次被信号中断，第三次写入剩余数据
+        EXPECT_CALL(*m,writev(kFakeFd,_,3)).WillOnce([&](int,const struct iovec* v,int cnt){
+            return fakeWritev(output,v,cnt,8);
+        });
+        EXPECT_CALL(*m,writev(kFakeFd,_,2)).WillOnce(::testing::SetErrnoAndReturn(EINTR,-1))
+            .WillOnce([&](int,const struct iovec* v,int cnt){
+                return fakeWritev(output,v,cnt,SIZE_MAX);
+            });
+    }
+    EXPECT_CALL(*m,pwritev2(_,_,_,_,_)).Times(0);
+    EXPECT_CALL(*m,fdatasync(_)).Times(0);
+    EXPECT_CALL(*m,close(kFakeFd)).WillOnce(Return(0));
+
+    auto flush=LogFlushFactory<WritevFileFlush>::createLogFlush("place holder",json_data,std::move(mock));
+    flush->flushv(iov,3);
+    ASSERT_EQ(output,"hello writev world");
+}
+
+//测试WritevFileFlush每次writev最多传入IOV_MAX个段
+TEST_F(LogFlushTest,WritevFileFlush_iov_max_test)
+{
+    auto mock=std::make_unique<MockSystemOps>();
+    MockSystemOps* m=mock.get();
+
+    EXPECT_CALL(*m,createDirectory(_));
+    EXPECT_CALL(*m,open(_,_,_)).WillOnce(Return(42));
+
+    const int total=IOV_MAX+10;
+    std::string data(total,'x');
+    std::vector<struct iovec>iov;
+    for(int i=0;i<total;++i) iov.push_back(iovec{&data[i],1});
+
+    std::string output;
+    EXPECT_CALL(*m,writev(42,_,::testing::Le(IOV_MAX))).Times(2).WillRepeatedly([&](int,const struct iovec* v,int cnt){
+        return fakeWritev(output,v,cnt,SIZE_MAX);
+    });
+    EXPECT_CALL(*m,close(42)).WillOnce(Return(0));
+
+    auto flush=LogFlushFactory<WritevFileFlush>::createLogFlush("place holder",json_data,std::move(mock));
+    flush->flushv(iov.data(),total);
+    ASSERT_EQ(output,data);
+}
+
+//测试flush_log为2时使用RWF_DSYNC写入，不再单独落盘
+TEST_F(LogFlushTest,WritevFileFlush_dsync_test)
+{
+    json_data.flush_log_=2;
+    auto mock=std::make_unique<MockSystemOps>();
+    MockSystemOps* m=mock.get();
+
+    EXPECT_CALL(*m,createDirectory(_));
+    EXPECT_CALL(*m,open(_,_,_)).WillOnce(Return(42));
+
+    std::string data="hello world";
+    std::string output;
+    EXPECT_CALL(*m,pwritev2(42,_,1,-1,RWF_DSYNC)).WillOnce([&](int,const struct iovec* v,int cnt,off_t,int){
+        return fakeWritev(output,v,cnt,SIZE_MAX);
+    });
+    EXPECT_CALL(*m,writev(_,_,_)).Times(0);
+    EXPECT_CALL(*m,fdatasync(_)).Times(0);
+    EXPECT_CALL(*m,close(42)).WillOnce(Return(0));
+
+    auto flush=LogFlushFactory<WritevFileFlush>::createLogFlush("place holder",json_data,std::move(mock));
+    flush->flush(data.c_str(),data.size());
+    ASSERT_EQ(output,data);
+}
+
+//测试内核不支持RWF_DSYNC时退化为writev+fdatasync
+TEST_F(LogFlushTest,WritevFileFlush_dsync_fallback_test)
+{
+    json_data.flush_log_=2;
+    auto mock=std::make_unique<MockSystemOps>();
+    MockSystemOps* m=mock.get();
+
+    EXPECT_CALL(*m,createDirectory(_));
+    EXPECT_CALL(*m,open(_,_,_)).WillOnce(Return(42));
+
+    std::string data="hello world";
+    std::string output;
+    EXPECT_CALL(*m,pwritev2(42,_,1,-1,RWF_DSYNC)).WillOnce(::testing::SetErrnoAndReturn(EOPNOTSUPP,-1));
+    EXPECT_CALL(*m,writev(42,_,1)).Times(2).WillRepeatedly([&](int,const struct iovec* v,int cnt){
+        return fakeWritev(output,v,cnt,SIZE_MAX);
+    });
+    EXPECT_CALL(*m,fdatasync(42)).Times(2).WillRepeatedly(Return(0));
+    EXPECT_CALL(*m,close(42)).WillOnce(Return(0));
+
+    auto flush=LogFlushFactory<WritevFileFlush>::createLogFlush("place holder",json_data,std::move(mock));
+    flush->flush(data.c_str(),data.size());
+    flush->flush(data.c_str(),data.size());
+    ASSERT_EQ(output,data+data);
+}
+
+//测试open和writev失败
+TEST_F(LogFlushTest,WritevFileFlush_fail_test)
+{
+    {
+        auto mock=std::make_unique<MockSystemOps>();
+        MockSystemOps* m=mock.get();
+        EXPECT_CALL(*m,createDirectory(_));
+        EXPECT_CALL(*m,open(_,_,_)).WillOnce(::testing::SetErrnoAndReturn(EACCES,-1));
+        EXPECT_CALL(*m,perror(::testing::HasSubstr("open failed"))).Times(1);
+        EXPECT_CALL(*m,writev(_,_,_)).Times(0);
+        EXPECT_CALL(*m,close(_)).Times(0);
+        auto flush=LogFlushFactory<WritevFileFlush>::createLogFlush("place holder",json_data,std::move(mock));
+        flush->flush("data",4);
+    }
+    {
+        auto mock=std::make_unique<MockSystemOps>();
+        MockSystemOps* m=mock.get();
+        EXPECT_CALL(*m,createDirectory(_));
+        EXPECT_CALL(*m,open(_,_,_)).WillOnce(Return(42));
+        EXPECT_CALL(*m,writev(42,_,1)).WillOnce(::testing::SetErrnoAndReturn(ENOSPC,-1));
+        EXPECT_CALL(*m,perror(::testing::HasSubstr("writev failed"))).Times(1);
+        EXPECT_CALL(*m,close(42)).WillOnce(Return(0));
+        auto flush=LogFlushFactory<WritevFileFlush>::createLogFlush("place holder",json_data,std::move(mock));
+        flush->flush("data",4);
+    }
+}
+
+//测试WritevFileFlush真实写入文件
+TEST_F(LogFlushTest,WritevFileFlush_real_file_test)
+{
+    std::string path="./writev_flush_test/writev.log";
+    fs::remove_all("./writev_flush_test");
+    json_data.flush_log_=2;
+    {
+        auto flush=LogFlushFactory<WritevFileFlush>::createLogFlush(path,json_data);
+        std::string first="first line\n";
+        std::string second="second line\n";
+        struct iovec iov[2]={{first.data(),first.size()},{second.data(),second.size()}};
+        flush->flushv(iov,2);
+        flush->flush("third line\n",11);
+    }
+    std::ifstream ifs(path);
+    std::string content((std::istreambuf_iterator<char>(ifs)),std::istreambuf_iterator<char>());
+    ASSERT_EQ(content,"first line\nsecond line\nthird line\n");
+    fs::remove_all("./writev_flush_test");
+}
+
+//测试RollFileFlush的sync同时落盘已经滚动关闭的文件
+TEST_F(LogFlushTest,RollFileFlush_sync_test)
+{
+    json_data.flush_log_=0;
+    std::string data="hello world";
+    size_t max_size=data.size()-2;
+
+    auto mock=std::make_unique<MockSystemOps>();
+    MockSystemOps* m=mock.get();
+
+    EXPECT_CALL(*m,createDirectory(_));
+    EXPECT_CALL(*m,now()).Times(2).WillOnce(Return(1600000000)).WillOnce(Return(1700000000));
+    EXPECT_CALL(*m,fopen(_,_)).Times(2).WillRepeatedly(Return(kFakeFile));
+    EXPECT_CALL(*m,fwrite(data.c_str(),1,data.size(),kFakeFile)).Times(2).WillRepeatedly(Return(data.size()));
+    EXPECT_CALL(*m,fclose(kFakeFile)).Times(2).WillRepeatedly(Return(0));
+
+    //第一个文件已经关闭，重新打开落盘
+    EXPECT_CALL(*m,open(::testing::MatchesRegex("log/LOG_.*-1.log"),_,_)).WillOnce(Return(42));
+    EXPECT_CALL(*m,fsync(42)).WillOnce(Return(0));
+    EXPECT_CALL(*m,close(42)).WillOnce(Return(0));
+    //当前文件
+    EXPECT_CALL(*m,fflush(kFakeFile)).WillOnce(Return(0));
+    EXPECT_CALL(*m,fileno(kFakeFile)).WillOnce(Return(12345));
+    EXPECT_CALL(*m,fsync(12345)).WillOnce(Return(0));
+
+    auto roll_file_flush=LogFlushFactory<RollFileFlush>::createLogFlush("log",max_size,json_data,std::move(mock));
+    roll_file_flush->flush(data.c_str(),data.size());
+    roll_file_flush->flush(data.c_str(),data.size());
+    roll_file_flush->sync();
+}
+
+//测试一直不调用sync时，等待落盘的已关闭文件达到上限之后在滚动时落盘，列表不会无限增长
+TEST_F(LogFlushTest,RollFileFlush_unsynced_limit_test)
+{
+    json_data.flush_log_=0;
+    std::string data="hello world";
+    size_t max_size=data.size()-2;
+    time_t now=1600000000;
+    int opened=0;
+
+    auto mock=std::make_unique<MockSystemOps>();
+    MockSystemOps* m=mock.get();
+
+    EXPECT_CALL(*m,createDirectory(_)).Times(::testing::AnyNumber());
+    EXPECT_CALL(*m,listDirectory(_)).Times(::testing::AnyNumber());
+    EXPECT_CALL(*m,now()).WillRepeatedly([&now](){return now++;});
+    EXPECT_CALL(*m,fopen(_,_)).Times(18).WillRepeatedly(Return(kFakeFile));
+    EXPECT_CALL(*m,fwrite(data.c_str(),1,data.size(),kFakeFile)).Times(18).WillRepeatedly(Return(data.size()));
+    EXPECT_CALL(*m,fclose(kFakeFile)).Times(18).WillRepeatedly(Return(0));
+    EXPECT_CALL(*m,open(_,_,_)).WillRepeatedly([&opened](const char*,int,mode_t){++opened;return 42;});
+    EXPECT_CALL(*m,fsync(42)).WillRepeatedly(Return(0));
+    EXPECT_CALL(*m,close(42)).WillRepeatedly(Return(0));
+
+    auto roll_file_flush=LogFlushFactory<RollFileFlush>::createLogFlush("log",max_size,json_data,std::move(mock));
+    //前17个文件滚动关闭时只记录，第18个文件打开时先落盘之前记录的16个
+    for(int i=0;i<17;++i) roll_file_flush->flush(data.c_str(),data.size());
+    ASSERT_EQ(opened,0);
+    roll_file_flush->flush(data.c_str(),data.size());
+    ASSERT_EQ(opened,16);
+
+    EXPECT_CALL(*m,fflush(kFakeFile)).WillOnce(Return(0));
+    EXPECT_CALL(*m,fileno(kFakeFile)).WillOnce(Return(12345));
+    EXPECT_CALL(*m,fsync(12345)).WillOnce(Return(0));
+    roll_file_flush->sync();
+    ASSERT_EQ(opened,17);
+}
+
+//测试按时间和大小混合滚动
+TEST_F(LogFlushTest,RollFileFlush_hybrid_roll_test)
+{
+    json_data.roll_interval_="hour";
+    std::string data="hello world";
+    time_t now=1600000000;   //2020-09-13 12:26:40 UTC
+
+    auto mock=std::make_unique<MockSystemOps>();
+    MockSystemOps* m=mock.get();
+
+    EXPECT_CALL(*m,createDirectory(_));
+    EXPECT_CALL(*m,listDirectory(_)).WillOnce(Return(std::vector<std::string>{}));
+    EXPECT_CALL(*m,now()).WillRepeatedly([&now](){return now;});
+    EXPECT_CALL(*m,fwrite(_,1,_,kFakeFile)).WillRepeatedly([](const void*,size_t,size_t n,FILE*){return n;});
+    EXPECT_CALL(*m,fflush(kFakeFile)).WillRepeatedly(Return(0));
+    EXPECT_CALL(*m,fclose(kFakeFile)).Times(4).WillRepeatedly(Return(0));
+    //第一个文件，同一个小时内没有超过大小时不滚动
+    EXPECT_CALL(*m,fopen(::testing::EndsWith("-1.log"),_)).WillOnce(Return(kFakeFile));
+    //超过大小滚动
+    EXPECT_CALL(*m,fopen(::testing::EndsWith("-2.log"),_)).WillOnce(Return(kFakeFile));
+    //到达整点滚动
+    EXPECT_CALL(*m,fopen(::testing::EndsWith("-3.log"),_)).WillOnce(Return(kFakeFile));
+    //一小时之后再次滚动
+    EXPECT_CALL(*m,fopen(::testing::EndsWith("-4.log"),_)).WillOnce(Return(kFakeFile));
+
+    auto roll_file_flush=std::dynamic_pointer_cast<RollFileFlush>
+                        (LogFlushFactory<RollFileFlush>::createLogFlush("log",data.size()*2,json_data,std::move(mock)));
+    roll_file_flush->flush(data.c_str(),data.size());
+    now+=60;
+    roll_file_flush->flush(data.c_str(),data.size());
+    roll_file_flush->flush(data.c_str(),data.size());
+    ASSERT_EQ(roll_file_flush->getFileNum(),1);
+    roll_file_flush->flush(data.c_str(),data.size());
+    ASSERT_EQ(roll_file_flush->getFileNum(),2);
+    //下一个整点
+    now=(now/3600+1)*3600;
+    roll_file_flush->flush(data.c_str(),data.size());
+    ASSERT_EQ(roll_file_flush->getFileNum(),3);
+    now+=3599;
+    roll_file_flush->flush(data.c_str(),data.size());
+    ASSERT_EQ(roll_file_flush->getFileNum(),3);
+    now+=1;
+    roll_file_flush->flush(data.c_str(),data.size());
+    ASSERT_EQ(roll_file_flush->getFileNum(),4);
+}
+
+//测试启动时扫描目录接着已有文件的序号，只删除已经退出的进程留下的临时文件
+TEST_F(LogFlushTest,RollFileFlush_resume_counter_test)
+{
+    std::string folder="./roll_resume_test";
+    fs::remove_all(folder);
+    fs::create_directories(folder);
+    std::ofstream(folder+"/LOG_2020-09-13_12:2640-3.log")<<"old";
+    std::ofstream(folder+"/LOG_2020-09-13_12:3640-7.log")<<"old";
+    std::ofstream(folder+"/other-100.txt")<<"other";
+    //不存在的进程号
+    std::ofstream(folder+"/.LOG_next_2147483632_0.tmp");
+    //仍然存在的进程(包括本进程)的临时文件可能已经被预打开
+    std::string live_tmp=".LOG_next_"+std::to_string(::getppid())+"_0.tmp";
+    std::string own_tmp=".LOG_next_"+std::to_string(::getpid())+"_1000000.tmp";
+    std::ofstream(folder+"/"+live_tmp);
+    std::ofstream(folder+"/"+own_tmp);
+    {
+        RollFileFlush roll_file_flush(folder,1024,json_data);
+        roll_file_flush.flush("new",3);
+    }
+    size_t new_files=0;
+    for(auto& entry:fs::directory_iterator(folder))
+    {
+        std::string name=entry.path().filename().string();
+        EXPECT_NE(name,".LOG_next_2147483632_0.tmp");
+        if(name.size()>6&&name.compare(name.size()-6,6,"-8.log")==0) ++new_files;
+    }
+    ASSERT_EQ(new_files,1);
+    EXPECT_TRUE(fs::exists(folder+"/"+live_tmp));
+    EXPECT_TRUE(fs::exists(folder+"/"+own_tmp));
+    fs::remove_all(folder);
+}
+
+//测试预打开，滚动时使用辅助线程提前打开的文件，数据按顺序写入各个文件
+TEST_F(LogFlushTest,RollFileFlush_preopen_test)
+{
+    std::string folder="./roll_preopen_test";
+    fs::remove_all(folder);
+    json_data.roll_preopen_=true;
+    std::string expected;
+    {
+        RollFileFlush roll_file_flush(folder,64,json_data);
+        for(int i=0;i<100;++i)
+        {
+            std::string line="preopen line "+std::to_string(i)+"\n";
+            roll_file_flush.flush(line.c_str(),line.size());
+            expected+=line;
+        }
+    }
+
+    //按序号拼接所有文件的内容
+    std::map<size_t,std::string>files;
+    for(auto& entry:fs::directory_iterator(folder))
+    {
+        std::string name=entry.path().filename().string();
+        ASSERT_EQ(name.rfind("LOG_",0),0)<<name;
+        size_t dash=name.find_last_of('-');
+        std::ifstream ifs(entry.path());
+        files[std::stoul(name.substr(dash+1))]=std::string((std::istreambuf_iterator<char>(ifs)),std::istreambuf_iterator<char>());
+    }
+    ASSERT_GT(files.size(),2);
+    std::string content;
+    for(auto& [cnt,data]:files) content+=data;
+    ASSERT_EQ(content,expected);
+    fs::remove_all(folder);
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include "test_helper.h"
+#include "Manager.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+class ManagerTest:public ::testing::Test
+{
+protected:
+    static std::shared_ptr<asynclog::AsyncLogger> makeLogger(const std::string& name)
+    {
+        asynclog::AsyncLoggerBuilder builder;
+        builder.setLoggerName(name);
+        builder.addLogFlush<asynclog::StdOutFlush>();
+        return builder.build(pool);
+    }
+    //Manager是单例，每次运行使用不同的名字，避免重复运行时名字已经注册
+    static std::string uniqueName(const std::string& name)
+    {
+        static std::atomic_int seq=0;
+        return name+"_"+std::to_string(seq.fetch_add(1));
+    }
+    inline static std::shared_ptr<asynclog::WorkStealingPool>pool=std::make_shared<asynclog::WorkStealingPool>(1,100);
+};
+
+TEST_F(ManagerTest,get_logger_test)
+{
+    using namespace asynclog;
+    Manager& manager=Manager::getInstance();
+    std::string name=uniqueName("manager_test_get");
+    ASSERT_FALSE(manager.exist(name));
+    ASSERT_EQ(manager.getLogger(name),nullptr);
+
+    auto logger=makeLogger(name);
+    manager.addLogger(logger);
+    ASSERT_TRUE(manager.exist(name));
+    ASSERT_EQ(manager.getLogger(name),logger);
+}
+
+//句柄在日志器注册之前获取，注册和替换之后自动指向新的日志器
+TEST_F(ManagerTest,handle_test)
+{
+    using namespace asynclog;
+    Manager& manager=Manager::getInstance();
+    std::string name=uniqueName("manager_test_handle");
+    LoggerHandle& handle=manager.handle(name);
+    ASSERT_FALSE(handle);
+    ASSERT_FALSE(manager.exist(name));
+    ASSERT_EQ(&manager.handle(name),&handle);
+
+    auto first=makeLogger(name);
+    manager.addLogger(first);
+    ASSERT_TRUE(handle);
+    ASSERT_EQ(handle.shared(),first);
+    ASSERT_EQ(handle->name(),name);
+
+    auto second=makeLogger(name);
+    manager.addLogger(second);
+    ASSERT_EQ(handle.shared(),second);
+    ASSERT_EQ(manager.getLogger(name),second);
+}
+
+//注册新日志器的同时其它线程无锁地查找
+TEST_F(ManagerTest,concurrent_lookup_test)
+{
+    using namespace asynclog;
+    Manager& manager=Manager::getInstance();
+    std::string name=uniqueName("manager_test_concurrent");
+    manager.addLogger(makeLogger(name));
+    std::atomic_bool stop=false;
+    std::atomic_size_t misses=0;
+    std::vector<std::thread>readers;
+    for(int i=0;i<4;++i)
+    {
+        readers.emplace_back([&](){
+            while(!stop.load())
+            {
+                if(manager.getLogger(name)==nullptr) misses.fetch_add(1);
+            }
+        });
+    }
+    for(int i=0;i<16;++i)
+    {
+        manager.addLogger(makeLogger(name+"_"+std::to_string(i)));
+    }
+    stop.store(true);
+    for(auto& t:readers) t.join();
+    ASSERT_EQ(misses.load(),0);
+    for(int i=0;i<16;++i)
+    {
+        ASSERT_TRUE(manager.exist(name+"_"+std::to_string(i)));
+    }
+}
+
+//读取句柄不修改引用计数；被替换的日志器保留到Manager析构，替换之前取得的指针仍然有效，之后写入的日志照常落地
+TEST_F(ManagerTest,replaced_logger_keep_alive_test)
+{
+    using namespace asynclog;
+    Manager& manager=Manager::getInstance();
+    std::string name=uniqueName("manager_test_keep_alive");
+    LoggerHandle& handle=manager.handle(name);
+    auto string_flush=std::make_shared<StringFlush>();
+    Util::JsonUtil::JsonData json_data;
+    std::weak_ptr<AsyncLogger>weak;
+    {
+        auto first=std::make_shared<AsyncLogger>(name,std::vector<std::shared_ptr<LogFlush>>{string_flush},nullptr,json_data);
+        weak=first;
+        manager.addLogger(std::move(first));
+    }
+    long use_count=handle.shared().use_count();
+    AsyncLogger* reader=handle.get();
+    ASSERT_TRUE(handle->info("m.cpp",1,"before replace"));
+    ASSERT_EQ(handle.shared().use_count(),use_count);
+
+    manager.addLogger(makeLogger(name));
+    ASSERT_NE(handle.get(),reader);
+    ASSERT_FALSE(weak.expired());
+    ASSERT_TRUE(reader->info("m.cpp",2,"still usable"));
+    ASSERT_TRUE(reader->sync());
+    EXPECT_THAT(string_flush->output(),::testing::HasSubstr("\tbefore replace\n"));
+    EXPECT_THAT(string_flush->output(),::testing::HasSubstr("\tstill usable\n"));
+}
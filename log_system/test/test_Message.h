@@ -57,3 +57,23 @@ TEST(MessageTest,format_test)
     //验证日志格式是否正确
     ASSERT_EQ(expected_string,msg.format());
 }
+
+TEST(MessageTest,format_to_test)
+{
+    using namespace asynclog;
+    LogMessage msg(LogLevel::value::WARN,7,"a.cpp","Logger","payload");
+    std::string expected=msg.format();
+
+    std::string out="prefix";
+    msg.formatTo(out);
+    ASSERT_EQ(out,"prefix"+expected);
+
+    Fmt::LineWriter w;
+    msg.formatTo(w);
+    ASSERT_EQ(std::string(w.data(),w.size()),expected);
+
+    //其它线程的id不能使用当前线程的缓存
+    std::thread([&msg,&expected](){
+        ASSERT_EQ(msg.format(),expected);
+    }).join();
+}
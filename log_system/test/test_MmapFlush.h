@@ -0,0 +1,106 @@
+#pragma once
+
+#include "test_helper.h"
+#include "MmapFlush.hpp"
+
+using namespace asynclog;
+
+class MmapFlushTest: public ::testing::Test
+{
+protected:
+    void SetUp()override
+    {
+        fs::remove_all(dir_);
+        json_data.flush_log_=1;
+        json_data.mmap_window_size_=4096;
+    }
+    void TearDown()override
+    {
+        fs::remove_all(dir_);
+    }
+
+    std::string readFile(const std::string& path)
+    {
+        std::ifstream ifs(path,std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(ifs)),std::istreambuf_iterator<char>());
+    }
+
+    const std::string dir_="./mmap_flush_test";
+    Util::JsonUtil::JsonData json_data;
+};
+
+//测试跨越多个窗口写入，关闭之后文件长度等于写入的数据长度
+TEST_F(MmapFlushTest,window_test)
+{
+    std::string path=dir_+"/mmap.log";
+    for(size_t flush_log:{0,1,2})
+    {
+        fs::remove_all(dir_);
+        json_data.flush_log_=flush_log;
+        std::string expected;
+        {
+            MmapFileFlush flush(path,json_data);
+            for(int i=0;i<500;++i)
+            {
+                std::string line="mmap line "+std::to_string(i)+"\n";
+                std::string tail="tail\n";
+                struct iovec iov[2]={{line.data(),line.size()},{tail.data(),tail.size()}};
+                flush.flushv(iov,2);
+                expected+=line+tail;
+            }
+            //大于一个窗口的批次
+            std::string big(10000,'m');
+            flush.flush(big.data(),big.size());
+            expected+=big;
+            //写入之后还没有关闭时数据已经在文件中
+            ASSERT_EQ(readFile(path).substr(0,expected.size()),expected);
+        }
+        ASSERT_EQ(fs::file_size(path),expected.size());
+        ASSERT_EQ(readFile(path),expected);
+    }
+}
+
+//测试追加到已有的文件
+TEST_F(MmapFlushTest,append_test)
+{
+    std::string path=dir_+"/append.log";
+    {
+        MmapFileFlush flush(path,json_data);
+        flush.flush("first\n",6);
+    }
+    {
+        MmapFileFlush flush(path,json_data);
+        flush.flush("second\n",7);
+    }
+    ASSERT_EQ(readFile(path),"first\nsecond\n");
+}
+
+//测试崩溃之后文件末尾留有预分配的0字节，重新打开时从实际数据之后继续追加
+TEST_F(MmapFlushTest,crash_recover_test)
+{
+    std::string path=dir_+"/crash.log";
+    fs::create_directories(dir_);
+    {
+        std::ofstream ofs(path,std::ios::binary);
+        std::string data="before crash\n";
+        ofs.write(data.data(),data.size());
+        std::string zeros(8192,'\0');
+        ofs.write(zeros.data(),zeros.size());
+    }
+    {
+        MmapFileFlush flush(path,json_data);
+        flush.flush("after crash\n",12);
+    }
+    ASSERT_EQ(readFile(path),"before crash\nafter crash\n");
+}
+
+//测试打开文件失败时退化为FileFlush
+TEST_F(MmapFlushTest,open_fail_fallback_test)
+{
+    fs::create_directories(dir_);
+    std::ofstream(dir_+"/not_dir")<<"x";
+    MmapFileFlush flush(dir_+"/not_dir/mmap.log",json_data);
+    ASSERT_FALSE(flush.usingMmap());
+    flush.flush("dropped\n",8);
+    flush.sync();
+}
@@ -0,0 +1,165 @@
+#pragma once
+#include "test_helper.h"
+#include "MyLog.hpp"
+
+//MyLog.hpp在全局命名空间中定义了LogLevel，这个文件中使用asynclog::LogLevel
+
+
+class MyLogTest:public ::testing::Test
+{
+protected:
+    std::shared_ptr<asynclog::AsyncLogger> makeLogger(const std::string& name,bool binary)
+    {
+        json_data_.binary_log_=binary;
+        return std::make_shared<asynclog::AsyncLogger>(name,std::vector<std::shared_ptr<asynclog::LogFlush>>{flush_},pool_,json_data_);
+    }
+    asynclog::Util::JsonUtil::JsonData json_data_;
+    std::shared_ptr<StringFlush>flush_=std::make_shared<StringFlush>();
+    inline static std::shared_ptr<asynclog::ThreadPool>pool_=std::make_shared<asynclog::ThreadPool>(1,100);
+};
+
+//同一条日志语句只注册一次调用点，文本和二进制模式的输出相同
+TEST_F(MyLogTest,call_site_macro_test)
+{
+    for(bool binary:{false,true})
+    {
+        flush_=std::make_shared<StringFlush>();
+        uint32_t before=0;
+        {
+            auto logger=makeLogger("site_macro",binary);
+            for(int i=0;i<3;++i)
+            {
+                if(i==1) before=asynclog::CallSiteRegistry::getInstance().size();
+                LogInfo(logger,"site message %d %s",i,"abc");
+            }
+            ASSERT_EQ(asynclog::CallSiteRegistry::getInstance().size(),before);
+            LogDebug(logger,"debug without args");
+        }
+        std::string output=flush_->output();
+        EXPECT_THAT(output,::testing::ContainsRegex("\\[INFO\\]\\[site_macro\\]\\[[^]]*test_MyLog\\.h:[0-9]+\\]\tsite message 2 abc\n"));
+        EXPECT_THAT(output,::testing::HasSubstr("debug without args\n"));
+    }
+}
+
+//二进制日志器上混用类型安全的宏和printf风格的宏，两种记录都能解码输出，ERROR级别也不丢失
+TEST_F(MyLogTest,binary_mixed_fmt_macro_test)
+{
+    {
+        auto logger=makeLogger("binary_mixed",true);
+        for(int i=0;i<3;++i)
+        {
+            LogInfoFmt(logger,"typed {} {}",i,std::string_view("abc"));
+            LogInfo(logger,"printf %d %s",i,"xyz");
+        }
+        LogErrorFmt(logger,"typed error {}%s",100);
+    }
+    std::string output=flush_->output();
+    EXPECT_THAT(output,::testing::Not(::testing::HasSubstr("corrupt")));
+    for(int i=0;i<3;++i)
+    {
+        EXPECT_THAT(output,::testing::ContainsRegex("\\[INFO\\]\\[binary_mixed\\]\\[[^]]*test_MyLog\\.h:[0-9]+\\]\ttyped "+std::to_string(i)+" abc\n"));
+        EXPECT_THAT(output,::testing::HasSubstr("\tprintf "+std::to_string(i)+" xyz\n"));
+    }
+    EXPECT_THAT(output,::testing::HasSubstr("[ERROR][binary_mixed]["));
+    EXPECT_THAT(output,::testing::HasSubstr("\ttyped error 100%s\n"));
+}
+
+//关闭的调用点不求值参数也不输出，其它调用点不受影响
+TEST_F(MyLogTest,call_site_disable_test)
+{
+    auto logger=makeLogger("site_disable",false);
+    int evaluated=0;
+    auto arg=[&evaluated](){return ++evaluated;};
+    size_t line=0;
+    for(int i=0;i<2;++i)
+    {
+        line=__LINE__+1;
+        LogWarn(logger,"disabled site %d",arg());
+        LogWarn(logger,"enabled site %d",i);
+        if(i==0)
+        {
+            ASSERT_EQ(asynclog::CallSiteRegistry::getInstance().setEnabled("test_MyLog.h",line,false),1);
+        }
+    }
+    logger.reset();
+    ASSERT_EQ(evaluated,1);
+    std::string output=flush_->output();
+    EXPECT_THAT(output,::testing::HasSubstr("disabled site 1\n"));
+    EXPECT_THAT(output,::testing::HasSubstr("enabled site 1\n"));
+    ASSERT_EQ(asynclog::CallSiteRegistry::getInstance().setEnabled("test_MyLog.h",line,true),1);
+}
+
+//宏展开为完整的if-else语句，可以直接放在没有大括号的分支中
+TEST_F(MyLogTest,macro_dangling_else_test)
+{
+    auto logger=makeLogger("site_else",false);
+    bool else_taken=false;
+    for(bool cond:{true,false})
+    {
+        if(cond)
+            LogError(logger,"branch taken");
+        else
+            else_taken=true;
+    }
+    logger.reset();
+    ASSERT_TRUE(else_taken);
+    EXPECT_THAT(flush_->output(),::testing::HasSubstr("branch taken\n"));
+}
+
+//限流的调用点被跳过时不求值参数，之后输出的第一条日志之前有一条汇总记录
+TEST_F(MyLogTest,rate_limited_macro_test)
+{
+    auto logger=makeLogger("site_limited",false);
+    int evaluated=0;
+    auto arg=[&evaluated](){return ++evaluated;};
+    //调用点的状态是静态的，调用次数取n的倍数，重复运行时结果相同
+    for(int i=0;i<12;++i)
+    {
+        LogInfoEvery(logger,4,"every %d",arg());
+    }
+    ASSERT_EQ(evaluated,3);
+
+    evaluated=0;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    for(int i=0;i<11;++i)
+    {
+        //最后一次之前等待产生新的令牌
+        if(i==10)
+        {
+            ASSERT_EQ(evaluated,2);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        LogWarnTokenBucket(logger,1000,2,"bucket %d",arg());
+    }
+    logger.reset();
+
+    std::string output=flush_->output();
+    EXPECT_THAT(output,::testing::HasSubstr("every 1\n"));
+    EXPECT_THAT(output,::testing::HasSubstr("every 3\n"));
+    EXPECT_THAT(output,::testing::Not(::testing::HasSubstr("records suppressed by rate limit: every")));
+    EXPECT_THAT(output,::testing::HasSubstr("bucket 2\n"));
+    EXPECT_THAT(output,::testing::HasSubstr("]\t8 records suppressed by rate limit: bucket %d\n"));
+    EXPECT_THAT(output,::testing::HasSubstr("bucket 3\n"));
+}
+
+//日志风暴之后调用点不再输出，日志器存活期间后台线程也会输出被限流条数的汇总记录
+TEST_F(MyLogTest,suppressed_flush_after_storm_test)
+{
+    json_data_.flush_max_latency_ms_=50;
+    for(bool binary:{false,true})
+    {
+        flush_=std::make_shared<StringFlush>();
+        auto logger=makeLogger("storm",binary);
+        //令牌几乎不会恢复，只有整个进程中的第一次调用能输出
+        for(int i=0;i<10;++i)
+        {
+            LogWarnTokenBucket(logger,0.001,1,"storm %d",i);
+        }
+        const std::string pattern="\\[WARN\\]\\[storm\\]\\[[^]]*test_MyLog\\.h:[0-9]+\\]\t[0-9]+ records suppressed by rate limit: storm %d\n";
+        for(int i=0;i<500&&!::testing::Matches(::testing::ContainsRegex(pattern))(flush_->output());++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_THAT(flush_->output(),::testing::ContainsRegex(pattern));
+    }
+}
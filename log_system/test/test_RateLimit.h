@@ -0,0 +1,78 @@
+#pragma once
+#include "test_helper.h"
+#include "RateLimit.hpp"
+
+#include <thread>
+#include <vector>
+
+
+TEST(RateLimitTest,every_n_test)
+{
+    asynclog::EveryNLimiter limiter(3);
+    std::vector<bool>allowed;
+    for(int i=0;i<7;++i) allowed.push_back(limiter.allow());
+    ASSERT_EQ(allowed,std::vector<bool>({true,false,false,true,false,false,true}));
+    ASSERT_EQ(limiter.takeSuppressed(),0);
+}
+
+//每个一秒的窗口最多输出per_sec条，进入新窗口时重新计数
+TEST(RateLimitTest,rate_limiter_test)
+{
+    asynclog::RateLimiter limiter(2);
+    const int64_t sec=1000000000LL;
+    ASSERT_TRUE(limiter.allow(10*sec));
+    ASSERT_TRUE(limiter.allow(10*sec+1));
+    ASSERT_FALSE(limiter.allow(10*sec+2));
+    ASSERT_FALSE(limiter.allow(11*sec-1));
+    ASSERT_EQ(limiter.takeSuppressed(),2);
+    ASSERT_EQ(limiter.takeSuppressed(),0);
+    ASSERT_TRUE(limiter.allow(11*sec));
+    ASSERT_TRUE(limiter.allow(11*sec+5));
+    ASSERT_FALSE(limiter.allow(11*sec+6));
+
+    asynclog::RateLimiter none(0);
+    ASSERT_FALSE(none.allow(sec));
+}
+
+//令牌桶先允许burst条连续输出，之后按照rate补充
+TEST(RateLimitTest,token_bucket_test)
+{
+    asynclog::TokenBucketLimiter limiter(10,3);
+    const int64_t interval=100000000LL;
+    int64_t now=1000*interval;
+    ASSERT_TRUE(limiter.allow(now));
+    ASSERT_TRUE(limiter.allow(now));
+    ASSERT_TRUE(limiter.allow(now));
+    ASSERT_FALSE(limiter.allow(now));
+    ASSERT_FALSE(limiter.allow(now+interval/2));
+    ASSERT_TRUE(limiter.allow(now+interval));
+    ASSERT_FALSE(limiter.allow(now+interval));
+    ASSERT_EQ(limiter.takeSuppressed(),3);
+    //空闲足够长的时间之后令牌最多恢复到burst个
+    now+=100*interval;
+    for(int i=0;i<3;++i) ASSERT_TRUE(limiter.allow(now));
+    ASSERT_FALSE(limiter.allow(now));
+
+    asynclog::TokenBucketLimiter none(0,5);
+    ASSERT_FALSE(none.allow(now));
+}
+
+//多个线程同时调用时，同一个窗口内输出的条数不超过上限，被限流的条数不丢失
+TEST(RateLimitTest,concurrent_test)
+{
+    asynclog::RateLimiter limiter(100);
+    std::atomic<int>allowed=0;
+    std::vector<std::thread>threads;
+    for(int t=0;t<4;++t)
+    {
+        threads.emplace_back([&](){
+            for(int i=0;i<10000;++i)
+            {
+                if(limiter.allow(5000000000LL)) allowed.fetch_add(1);
+            }
+        });
+    }
+    for(auto& t:threads) t.join();
+    ASSERT_EQ(allowed.load(),100);
+    ASSERT_EQ(limiter.takeSuppressed(),40000-100);
+}
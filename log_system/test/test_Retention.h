@@ -0,0 +1,141 @@
+#pragma once
+
+#include "test_helper.h"
+#include "LogFlush.hpp"
+#include "Retention.hpp"
+
+#include <set>
+
+using namespace asynclog;
+
+class RetentionTest: public ::testing::Test
+{
+protected:
+    void SetUp()override
+    {
+        fs::remove_all(dir_);
+        fs::remove_all(archive_);
+        fs::create_directories(dir_);
+        json_data.flush_log_=1;
+        json_data.retention_cpu_percent_=0;
+    }
+    void TearDown()override
+    {
+        fs::remove_all(dir_);
+        fs::remove_all(archive_);
+    }
+
+    //创建一个序号为seq的滚动文件
+    std::string makeSegment(size_t seq,const std::string& data)
+    {
+        std::string path=dir_+"/LOG_2020-09-13_12:2640-"+std::to_string(seq)+".log";
+        std::ofstream(path,std::ios::binary)<<data;
+        return path;
+    }
+
+    std::string readFile(const std::string& path)
+    {
+        std::ifstream ifs(path,std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(ifs)),std::istreambuf_iterator<char>());
+    }
+
+    const std::string dir_="./retention_test";
+    const std::string archive_="./retention_archive_test";
+    Util::JsonUtil::JsonData json_data;
+};
+
+#ifdef ASYNCLOG_WITH_ZSTD
+//测试压缩序号小于limit的文件，解压之后和原文件相同，当前文件不受影响
+TEST_F(RetentionTest,compress_test)
+{
+    json_data.retention_compress_=true;
+    std::string data;
+    for(int i=0;i<20000;++i) data+="retention line "+std::to_string(i)+"\n";
+    std::string first=makeSegment(1,data);
+    std::string second=makeSegment(2,"short");
+    std::string current=makeSegment(3,"current");
+    auto mtime=fs::last_write_time(first);
+
+    auto retention=std::make_shared<RetentionManager>(dir_+"/",json_data);
+    retention->sweep(3);
+
+    ASSERT_FALSE(fs::exists(first));
+    ASSERT_FALSE(fs::exists(second));
+    ASSERT_EQ(readFile(current),"current");
+    ASSERT_EQ(fs::last_write_time(first+".zst"),mtime);
+    for(auto& [path,expected]:{std::pair{first,data},std::pair{second,std::string("short")}})
+    {
+        std::string compressed=readFile(path+".zst");
+        ASSERT_LT(compressed.size(),expected.size()+64);
+        std::string output(expected.size(),'\0');
+        size_t n=ZSTD_decompress(output.data(),output.size(),compressed.data(),compressed.size());
+        ASSERT_FALSE(ZSTD_isError(n));
+        output.resize(n);
+        ASSERT_EQ(output,expected);
+    }
+    //再次执行时已经压缩的文件不变
+    retention->sweep(3);
+    ASSERT_TRUE(fs::exists(first+".zst"));
+}
+#endif
+
+//测试总大小超过上限时从最旧的文件开始删除
+TEST_F(RetentionTest,max_total_bytes_test)
+{
+    json_data.retention_max_total_bytes_=250;
+    for(size_t seq=1;seq<=6;++seq) makeSegment(seq,std::string(100,'a'));
+
+    auto retention=std::make_shared<RetentionManager>(dir_+"/",json_data);
+    retention->sweep(6);
+
+    std::set<std::string>names;
+    for(auto& entry:fs::directory_iterator(dir_)) names.insert(entry.path().filename().string());
+    ASSERT_EQ(names.size(),3);
+    ASSERT_TRUE(names.count("LOG_2020-09-13_12:2640-4.log"));
+    ASSERT_TRUE(names.count("LOG_2020-09-13_12:2640-5.log"));
+    //当前文件不计入总大小，也不会被删除
+    ASSERT_TRUE(names.count("LOG_2020-09-13_12:2640-6.log"));
+}
+
+//测试超过保留时间的文件移动到归档目录
+TEST_F(RetentionTest,max_age_archive_test)
+{
+    json_data.retention_max_age_sec_=3600;
+    json_data.retention_archive_dir_=archive_;
+    std::string old_path=makeSegment(1,"old");
+    std::string new_path=makeSegment(2,"new");
+    fs::last_write_time(old_path,fs::file_time_type::clock::now()-std::chrono::hours(2));
+
+    auto retention=std::make_shared<RetentionManager>(dir_+"/",json_data);
+    retention->sweep(3);
+
+    ASSERT_FALSE(fs::exists(old_path));
+    ASSERT_EQ(readFile(archive_+"/LOG_2020-09-13_12:2640-1.log"),"old");
+    ASSERT_EQ(readFile(new_path),"new");
+}
+
+//测试RollFileFlush滚动之后在线程池中清理旧文件
+TEST_F(RetentionTest,roll_file_flush_test)
+{
+    json_data.retention_max_total_bytes_=64;
+    auto pool=std::make_shared<ThreadPool>(1,10);
+    {
+        RollFileFlush roll_file_flush(dir_,32,json_data);
+        roll_file_flush.setThreadPool(pool);
+        std::string line(40,'x');
+        for(int i=0;i<10;++i) roll_file_flush.flush(line.c_str(),line.size());
+    }
+    //等待线程池中的任务执行完毕
+    pool.reset();
+
+    size_t files=0;
+    uintmax_t total=0;
+    for(auto& entry:fs::directory_iterator(dir_))
+    {
+        ++files;
+        total+=entry.file_size();
+    }
+    //当前文件加上不超过64字节的旧文件
+    ASSERT_EQ(files,2);
+    ASSERT_EQ(total,80);
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+#include <set>
+
+#include "test_helper.h"
+#include "RingBuffer.hpp"
+
+using namespace asynclog;
+
+class RingBufferTest: public ::testing::Test
+{
+protected:
+    void SetUp()override
+    {
+        json_data.buffer_size_=16;
+    }
+
+    Util::JsonUtil::JsonData json_data;
+};
+
+TEST_F(RingBufferTest,base_test)
+{
+    MpscRingBuffer ring(100);
+    //容量向上取整为2的幂，并且不小于4096
+    ASSERT_EQ(ring.capacity(),4096);
+    ASSERT_TRUE(ring.isEmpty());
+
+    std::string data1="hello ";
+    std::string data2="world";
+    ASSERT_TRUE(ring.tryPush(data1.c_str(),data1.size()));
+    ASSERT_TRUE(ring.tryPush(data2.c_str(),data2.size()));
+    ASSERT_FALSE(ring.isEmpty());
+
+    Buffer out(json_data);
+    ring.drainTo(out);
+    ASSERT_TRUE(ring.isEmpty());
+    ASSERT_EQ(std::string(out.peek(),out.readableBytes()),data1+data2);
+}
+
+//测试空间不足和单条记录过大
+TEST_F(RingBufferTest,full_test)
+{
+    MpscRingBuffer ring(4096);
+    std::string big(3000,'a');
+    ASSERT_FALSE(ring.tryPush(big.c_str(),big.size()));
+
+    std::string data(1000,'b');
+    int cnt=0;
+    while(ring.tryPush(data.c_str(),data.size())) ++cnt;
+    ASSERT_EQ(cnt,4);
+
+    //读取之后空间可以复用
+    Buffer out(json_data);
+    ring.drainTo(out);
+    ASSERT_EQ(out.readableBytes(),4*data.size());
+    ASSERT_TRUE(ring.tryPush(data.c_str(),data.size()));
+}
+
+//测试环绕写入
+TEST_F(RingBufferTest,wrap_around_test)
+{
+    MpscRingBuffer ring(4096);
+    Buffer out(json_data);
+    std::string expected;
+    for(int i=0;i<100;++i)
+    {
+        std::string data(std::to_string(i)+std::string(300+i%7,'x'));
+        ASSERT_TRUE(ring.tryPush(data.c_str(),data.size()));
+        expected+=data;
+        if(i%5==4) ring.drainTo(out);
+    }
+    ring.drainTo(out);
+    ASSERT_EQ(std::string(out.peek(),out.readableBytes()),expected);
+}
+
+//多生产者测试，每条记录都完整且只出现一次
+TEST_F(RingBufferTest,mutiple_producer_test)
+{
+    MpscRingBuffer ring(1<<16);
+    const int thread_num=8;
+    const int per_thread=2000;
+    std::atomic_bool done{false};
+    Buffer out(json_data);
+
+    std::thread consumer([&](){
+        while(!done.load()||!ring.isEmpty())
+        {
+            ring.drainTo(out);
+        }
+    });
+
+    std::vector<std::thread>threads;
+    for(int t=0;t<thread_num;++t)
+    {
+        threads.emplace_back([&ring,t,per_thread](){
+            for(int i=0;i<per_thread;++i)
+            {
+                char line[32];
+                int n=snprintf(line,sizeof(line),"%d-%d\n",t,i);
+                while(!ring.tryPush(line,n)) std::this_thread::yield();
+            }
+        });
+    }
+    for(auto&t:threads) t.join();
+    done.store(true);
+    consumer.join();
+
+    std::set<std::string>lines;
+    std::stringstream ss(std::string(out.peek(),out.readableBytes()));
+    std::string line;
+    while(std::getline(ss,line)) lines.insert(line);
+    ASSERT_EQ(lines.size(),thread_num*per_thread);
+}
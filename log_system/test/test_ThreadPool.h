@@ -1,9 +1,13 @@
 #pragma once
 #include "test_helper.h"
 #include "ThreadPool.hpp"
+#include "WorkStealingPool.hpp"
 
 #include <vector>
 #include <atomic>
+#include <array>
+#include <future>
+#include <memory>
 
 
 class ThreadPoolTest:public ::testing::Test
@@ -70,3 +74,103 @@ TEST_F(ThreadPoolTest,stress_test)
     }
     ASSERT_EQ(cnt,1000);
 }
+
+//测试只能移动的任务和post
+TEST_F(ThreadPoolTest,move_only_post_test)
+{
+    using namespace asynclog;
+    ThreadPool pool(2,10);
+    std::promise<int>done;
+    auto fut=done.get_future();
+    auto value=std::make_unique<int>(42);
+    ASSERT_TRUE(pool.post([value=std::move(value),&done](){done.set_value(*value);}));
+    ASSERT_EQ(fut.get(),42);
+}
+
+//测试小的可调用对象存放在Task内部，大的放在堆上，移动之后都可以正常调用
+TEST_F(ThreadPoolTest,task_small_buffer_test)
+{
+    using namespace asynclog;
+    int cnt=0;
+    auto small=[&cnt](){++cnt;};
+    std::array<char,256>big_data{};
+    big_data[255]=1;
+    auto big=[&cnt,big_data](){cnt+=big_data[255];};
+    static_assert(Task::storedInline<decltype(small)>());
+    static_assert(!Task::storedInline<decltype(big)>());
+
+    Task a(small);
+    Task b(big);
+    Task c(std::move(a));
+    Task d;
+    d=std::move(b);
+    ASSERT_FALSE(a);
+    ASSERT_FALSE(b);
+    c();
+    d();
+    ASSERT_EQ(cnt,2);
+}
+
+TEST_F(ThreadPoolTest,work_stealing_stress_test)
+{
+    using namespace asynclog;
+    {
+        WorkStealingPool pool(8,2000);
+        std::vector<std::optional<std::future<int>>>vec(1000);
+        for(size_t i=0;i<vec.size();++i)
+        {
+            vec[i]=pool.enqueue(&ThreadPoolTest::test_func,this,1);
+        }
+        for(int i=0;i<1000;++i)
+        {
+            ASSERT_TRUE(pool.post([this](){cnt+=1;}));
+        }
+        for(auto&ret:vec)
+        {
+            ASSERT_EQ(ret->get(),1);
+        }
+        pool.stop();
+    }
+    //停止之前提交的任务在析构时都已经执行
+    ASSERT_EQ(cnt,2000);
+}
+
+//测试线程池内部提交的任务放入当前线程的队列，当前线程阻塞时由其它线程窃取执行
+TEST_F(ThreadPoolTest,work_stealing_steal_test)
+{
+    using namespace asynclog;
+    WorkStealingPool pool(2,10);
+    std::promise<std::thread::id>stolen;
+    auto fut=stolen.get_future();
+    std::promise<bool>result;
+    ASSERT_TRUE(pool.post([&pool,&stolen,&fut,&result](){
+        pool.post([&stolen](){stolen.set_value(std::this_thread::get_id());});
+        //当前线程一直占用，只有被窃取才能在超时之前完成
+        bool ok=fut.wait_for(std::chrono::seconds(5))==std::future_status::ready
+            &&fut.get()!=std::this_thread::get_id();
+        result.set_value(ok);
+    }));
+    ASSERT_TRUE(result.get_future().get());
+}
+
+//测试任务数达到上限和停止之后拒绝提交
+TEST_F(ThreadPoolTest,work_stealing_limit_test)
+{
+    using namespace asynclog;
+    WorkStealingPool pool(1,2);
+    std::promise<void>started;
+    std::promise<void>release;
+    auto release_fut=release.get_future().share();
+    ASSERT_TRUE(pool.post([&started,release_fut](){
+        started.set_value();
+        release_fut.wait();
+    }));
+    started.get_future().wait();
+    ASSERT_TRUE(pool.post([](){}));
+    ASSERT_TRUE(pool.post([](){}));
+    ASSERT_FALSE(pool.post([](){}));
+    ASSERT_EQ(pool.enqueue(&ThreadPoolTest::test_func,this,1),std::nullopt);
+    release.set_value();
+    pool.stop();
+    ASSERT_FALSE(pool.post([](){}));
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <sys/resource.h>
+#include <csignal>
+
+#include "test_helper.h"
+#include "UringFlush.hpp"
+
+using namespace asynclog;
+
+class UringFlushTest: public ::testing::Test
+{
+protected:
+    void SetUp()override
+    {
+        fs::remove_all(dir_);
+        json_data.flush_log_=1;
+    }
+    void TearDown()override
+    {
+        fs::remove_all(dir_);
+    }
+
+    std::string readFile(const std::string& path)
+    {
+        std::ifstream ifs(path);
+        return std::string((std::istreambuf_iterator<char>(ifs)),std::istreambuf_iterator<char>());
+    }
+
+    const std::string dir_="./uring_flush_test";
+    Util::JsonUtil::JsonData json_data;
+};
+
+//测试多个批次同时等待完成时数据按顺序写入文件
+TEST_F(UringFlushTest,write_order_test)
+{
+    std::string path=dir_+"/uring.log";
+    json_data.uring_queue_depth_=2;
+    json_data.flush_log_=2;
+    std::string expected;
+    {
+        UringFileFlush flush(path,json_data);
+        for(int i=0;i<100;++i)
+        {
+            std::string line="batch "+std::to_string(i)+"\n";
+            std::string tail="tail "+std::to_string(i)+"\n";
+            struct iovec iov[2]={{line.data(),line.size()},{tail.data(),tail.size()}};
+            flush.flushv(iov,2);
+            expected+=line+tail;
+            //批次提交之后调用者的缓冲区可以立即复用
+            line.assign(line.size(),'#');
+        }
+        std::string big(256*1024,'b');
+        flush.flush(big.data(),big.size());
+        expected+=big;
+    }
+    ASSERT_EQ(readFile(path),expected);
+}
+
+//测试追加到已有的文件
+TEST_F(UringFlushTest,append_test)
+{
+    std::string path=dir_+"/append.log";
+    {
+        UringFileFlush flush(path,json_data);
+        flush.flush("first\n",6);
+    }
+    {
+        UringFileFlush flush(path,json_data);
+        flush.flush("second\n",7);
+    }
+    ASSERT_EQ(readFile(path),"first\nsecond\n");
+}
+
+//测试uring_queue_depth为0时退化为FileFlush
+TEST_F(UringFlushTest,fallback_test)
+{
+    std::string path=dir_+"/fallback.log";
+    json_data.uring_queue_depth_=0;
+    {
+        UringFileFlush flush(path,json_data);
+        ASSERT_FALSE(flush.usingUring());
+        flush.flush("fallback\n",9);
+    }
+    ASSERT_EQ(readFile(path),"fallback\n");
+}
+
+//测试打开文件失败时退化为FileFlush，写入被忽略而不是提交到无效的fd
+TEST_F(UringFlushTest,open_fail_fallback_test)
+{
+    //父目录是一个普通文件，创建目录和打开文件都会失败
+    fs::create_directories(dir_);
+    std::ofstream(dir_+"/not_dir")<<"x";
+    json_data.uring_queue_depth_=4;
+    UringFileFlush flush(dir_+"/not_dir/uring.log",json_data);
+    ASSERT_FALSE(flush.usingUring());
+    flush.flush("dropped\n",8);
+    flush.sync();
+}
+
+//测试写入失败的批次多次重试之后截断文件，之后的数据从截断的位置接着写，文件中没有空洞
+TEST_F(UringFlushTest,write_error_truncate_test)
+{
+    std::string path=dir_+"/error.log";
+    json_data.uring_queue_depth_=4;
+    const size_t limit=64*1024;
+    const size_t batch=16*1024;
+    std::string expected;
+    {
+        UringFileFlush flush(path,json_data);
+        if(!flush.usingUring()) GTEST_SKIP()<<"io_uring is not available";
+
+        //超过文件大小上限的写入以EFBIG失败(忽略SIGXFSZ)，跨过上限的写入只写入一部分
+        struct rlimit old_limit;
+        ::getrlimit(RLIMIT_FSIZE,&old_limit);
+        auto old_handler=std::signal(SIGXFSZ,SIG_IGN);
+        struct rlimit new_limit{limit,old_limit.rlim_max};
+        ::setrlimit(RLIMIT_FSIZE,&new_limit);
+        for(int i=0;i<6;++i)
+        {
+            std::string data(batch,static_cast<char>('a'+i));
+            flush.flush(data.data(),data.size());
+            expected+=data;
+        }
+        flush.sync();
+        ::setrlimit(RLIMIT_FSIZE,&old_limit);
+        std::signal(SIGXFSZ,old_handler);
+
+        expected.resize(limit);
+        flush.flush("tail\n",5);
+        expected+="tail\n";
+    }
+    ASSERT_EQ(fs::file_size(path),expected.size());
+    ASSERT_EQ(readFile(path),expected);
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#ifdef ASYNCLOG_WITH_ZSTD
+
+#include "test_helper.h"
+#include "ZstdFlush.hpp"
+
+using namespace asynclog;
+
+class ZstdFlushTest: public ::testing::Test
+{
+protected:
+    void SetUp()override
+    {
+        fs::remove_all(dir_);
+        json_data.flush_log_=1;
+    }
+    void TearDown()override
+    {
+        fs::remove_all(dir_);
+    }
+
+    //流式解压整个文件，可以处理多个帧和没有结束的帧
+    std::string decompressFile(const std::string& path)
+    {
+        std::ifstream ifs(path,std::ios::binary);
+        std::string compressed((std::istreambuf_iterator<char>(ifs)),std::istreambuf_iterator<char>());
+        std::unique_ptr<ZSTD_DCtx,size_t(*)(ZSTD_DCtx*)>dctx(ZSTD_createDCtx(),ZSTD_freeDCtx);
+        std::string result;
+        std::vector<char>out(ZSTD_DStreamOutSize());
+        ZSTD_inBuffer input{compressed.data(),compressed.size(),0};
+        while(true)
+        {
+            ZSTD_outBuffer output{out.data(),out.size(),0};
+            size_t ret=ZSTD_decompressStream(dctx.get(),&output,&input);
+            EXPECT_FALSE(ZSTD_isError(ret));
+            if(ZSTD_isError(ret)) break;
+            result.append(out.data(),output.pos);
+            if(input.pos==input.size&&output.pos<output.size) break;
+        }
+        return result;
+    }
+
+    std::string makeBatch(int batch)
+    {
+        std::string data;
+        for(int i=0;i<200;++i)
+        {
+            data+="[INFO][2024-01-01 00:00:00][server.cc:42] request "+std::to_string(batch*200+i)+" handled\n";
+        }
+        return data;
+    }
+
+    const std::string dir_="./zstd_flush_test";
+    Util::JsonUtil::JsonData json_data;
+};
+
+//测试每批数据结束一个块之后，不关闭文件也可以解压出已经写入的全部数据
+TEST_F(ZstdFlushTest,block_per_batch_test)
+{
+    std::string path=dir_+"/zstd.log.zst";
+    std::string expected;
+    {
+        ZstdFileFlush flush(path,json_data);
+        for(int batch=0;batch<5;++batch)
+        {
+            std::string data=makeBatch(batch);
+            flush.flush(data.c_str(),data.size());
+            expected+=data;
+            ASSERT_EQ(decompressFile(path),expected);
+        }
+        //重复的日志行压缩率很高
+        ASSERT_GT(flush.inputBytes(),flush.outputBytes()*5);
+    }
+    ASSERT_EQ(decompressFile(path),expected);
+    //正常关闭之后是一个完整的帧
+    std::ifstream ifs(path,std::ios::binary);
+    std::string compressed((std::istreambuf_iterator<char>(ifs)),std::istreambuf_iterator<char>());
+    ASSERT_EQ(ZSTD_findFrameCompressedSize(compressed.data(),compressed.size()),compressed.size());
+}
+
+//测试每批数据结束一个帧，多段数据压缩到同一个帧中
+TEST_F(ZstdFlushTest,frame_per_batch_test)
+{
+    json_data.zstd_frame_per_batch_=true;
+    std::string path=dir_+"/zstd.log.zst";
+    std::string expected;
+    ZstdFileFlush flush(path,json_data);
+    for(int batch=0;batch<3;++batch)
+    {
+        std::string first=makeBatch(batch);
+        std::string second="second part "+std::to_string(batch)+"\n";
+        struct iovec iov[2]={{first.data(),first.size()},{second.data(),second.size()}};
+        flush.flushv(iov,2);
+        expected+=first+second;
+    }
+
+    std::ifstream ifs(path,std::ios::binary);
+    std::string compressed((std::istreambuf_iterator<char>(ifs)),std::istreambuf_iterator<char>());
+    size_t frames=0;
+    for(size_t pos=0;pos<compressed.size();++frames)
+    {
+        size_t n=ZSTD_findFrameCompressedSize(compressed.data()+pos,compressed.size()-pos);
+        ASSERT_FALSE(ZSTD_isError(n));
+        pos+=n;
+    }
+    ASSERT_EQ(frames,3);
+    ASSERT_EQ(decompressFile(path),expected);
+}
+
+//测试开启多线程压缩(libzstd不支持时退化为单线程)
+TEST_F(ZstdFlushTest,workers_test)
+{
+    json_data.zstd_workers_=2;
+    std::string path=dir_+"/zstd.log.zst";
+    std::string expected;
+    {
+        ZstdFileFlush flush(path,json_data);
+        for(int batch=0;batch<20;++batch)
+        {
+            std::string data=makeBatch(batch);
+            flush.flush(data.c_str(),data.size());
+            expected+=data;
+        }
+        ASSERT_EQ(decompressFile(path),expected);
+    }
+    ASSERT_EQ(decompressFile(path),expected);
+}
+
+#endif
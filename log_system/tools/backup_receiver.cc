@@ -0,0 +1,62 @@
+#include <signal.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+#include "backlog/SerBackUpLog.hpp"
+
+using namespace asynclog;
+
+//本地的备份接收端，把收到的每条ERROR/FATAL日志追加到输出文件(默认标准输出)中
+//用法: BackupReceiver <port> [output_file]
+
+static std::atomic_bool g_stop{false};
+
+int main(int argc,char* argv[])
+{
+    if(argc<2)
+    {
+        fprintf(stderr,"usage: %s <port> [output_file]\n",argv[0]);
+        return 1;
+    }
+    uint16_t port=static_cast<uint16_t>(std::atoi(argv[1]));
+    FILE* out=stdout;
+    if(argc>2)
+    {
+        out=fopen(argv[2],"ab");
+        if(out==nullptr)
+        {
+            perror("fopen failed: ");
+            return 1;
+        }
+    }
+
+    signal(SIGINT,[](int){g_stop.store(true);});
+    signal(SIGTERM,[](int){g_stop.store(true);});
+
+    uint64_t records=0;
+    BackupServer server(port,[out,&records](std::string_view record){
+        fwrite(record.data(),1,record.size(),out);
+        fflush(out);
+        ++records;
+    });
+    if(!server.start())
+    {
+        perror("start backup receiver failed: ");
+        return 1;
+    }
+    fprintf(stderr,"backup receiver listening on port %u\n",server.port());
+
+    while(!g_stop.load())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    server.stop();
+    fprintf(stderr,"received %lu records\n",static_cast<unsigned long>(records));
+    if(out!=stdout) fclose(out);
+    return 0;
+}
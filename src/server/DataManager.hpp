@@ -126,7 +126,7 @@ public:
         //准备sql语句
         const char * insert_sql=
             "insert or replace into tem_table(url, atime, mtime, storage_path, file_size) values (?,?,?,?,?);";    
-        LogInfo(getLogger(),"%s:%s",__FUNCTION__,insert_sql);
+        LogInfoTokenBucket(getLogger(),50,100,"%s:%s",__FUNCTION__,insert_sql);
         
         //编译sql
         sqlite3_stmt* stmt;
@@ -168,7 +168,7 @@ public:
         std::shared_lock<std::shared_mutex>lock(mtx_);
 
         const char* select_sql_by_url="select url, atime, mtime, storage_path, file_size from tem_table tt where url=?;";
-        LogInfo(getLogger(),"%s:%s",__FUNCTION__,select_sql_by_url);
+        LogInfoTokenBucket(getLogger(),50,100,"%s:%s",__FUNCTION__,select_sql_by_url);
         
         //编译sql
         sqlite3_stmt* stmt;
@@ -201,7 +201,7 @@ public:
         std::shared_lock<std::shared_mutex>lock(mtx_);
 
         const char* select_sql_by_sp="select url, atime, mtime, storage_path, file_size from tem_table tt where storage_path=?;";
-        LogInfo(getLogger(),"%s:%s",__FUNCTION__,select_sql_by_sp);
+        LogInfoTokenBucket(getLogger(),50,100,"%s:%s",__FUNCTION__,select_sql_by_sp);
         
         //编译sql
         sqlite3_stmt* stmt;
@@ -234,7 +234,7 @@ public:
         std::shared_lock<std::shared_mutex>lock(mtx_);
 
         const char* select_sql_all="select url, atime, mtime, storage_path, file_size from tem_table tt;";
-        LogInfo(getLogger(),"%s:%s",__FUNCTION__,select_sql_all);
+        LogInfoTokenBucket(getLogger(),50,100,"%s:%s",__FUNCTION__,select_sql_all);
         
         //编译sql
         sqlite3_stmt* stmt;
@@ -269,7 +269,7 @@ public:
         const char * delete_sql=
             "delete from tem_table where url=?;";
         
-        LogInfo(getLogger(),"%s:%s",__FUNCTION__,delete_sql);
+        LogInfoTokenBucket(getLogger(),50,100,"%s:%s",__FUNCTION__,delete_sql);
         
         //编译sql
         sqlite3_stmt* stmt;
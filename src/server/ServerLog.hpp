@@ -4,14 +4,13 @@
 namespace mystorage
 {
 const std::string SERVER_LOGGER_NAME = "cloud_storage_server";
-std::shared_ptr<asynclog::ThreadPool>LOGGER_POOL;
-std::shared_ptr<asynclog::AsyncLogger>_ptr;
+std::shared_ptr<asynclog::WorkStealingPool>LOGGER_POOL;
 
 inline void initServerLog()
 {
 
     //初始化线程池
-    LOGGER_POOL=std::make_shared<asynclog::ThreadPool>(2,100);
+    LOGGER_POOL=std::make_shared<asynclog::WorkStealingPool>(2,100);
     asynclog::AsyncLoggerBuilder builder;
 
     //设置配置文件
@@ -22,14 +21,13 @@ inline void initServerLog()
     builder.setLoggerName(SERVER_LOGGER_NAME);
     builder.setConfig(config_data);
     asynclog::Manager::getInstance().addLogger(builder.build(LOGGER_POOL));
-
-    _ptr=asynclog::Manager::getInstance().getLogger(SERVER_LOGGER_NAME);
-    
 }
 
-inline std::shared_ptr<asynclog::AsyncLogger> getLogger()
+//句柄只查找一次，之后每次使用只有一次原子读取，不加锁也不修改引用计数
+inline const asynclog::LoggerHandle& getLogger()
 {
-    return _ptr;
+    static asynclog::LoggerHandle& handle=asynclog::Manager::getInstance().handle(SERVER_LOGGER_NAME);
+    return handle;
 }
 
 } //namespace mystorage
\ No newline at end of file
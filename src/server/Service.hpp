@@ -310,9 +310,14 @@ private:
         StorageInfo info(conf_);
         info.newStorageInfo(storage_path);
         data_manager_->insert(info);
-        
-        evhttp_send_reply(req, HTTP_OK, "Success", nullptr);
         LogInfo(getLogger(),"upload success file path: %s",storage_path.c_str());
+        //元数据提交之后让之前的日志落盘，平时可以使用flush_log=0
+        if(!getLogger()->flushAndWait(std::chrono::milliseconds(1000)))
+        {
+            LogWarn(getLogger(),"log sync timeout after upload: %s",storage_path.c_str());
+        }
+
+        evhttp_send_reply(req, HTTP_OK, "Success", nullptr);
     }
 
 
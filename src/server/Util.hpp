@@ -206,14 +206,14 @@ public:
         return st.st_atime;
     }
 
-    //从文件POS处获取len长度字符给content
+    //从文件POS处获取len长度字符给content，读取每个分块都会调用，出错时的日志限制速率
     static bool getPosLen(std::ifstream&ifs,std::string&buf,size_t pos,size_t len)
     {
         if(len<=0||pos<0) return false;
 
         if(!ifs.is_open())
         {
-            LogWarn(getLogger(),"stream is not open");
+            LogWarnRateLimited(getLogger(),10,"stream is not open");
             return false;
         }
 
@@ -225,7 +225,7 @@ public:
 
         if(!ifs.good())
         {
-            LogError(getLogger(),"%s seekg failed",__FUNCTION__);
+            LogErrorRateLimited(getLogger(),10,"%s seekg failed",__FUNCTION__);
             return false;
         }
 
@@ -235,7 +235,7 @@ public:
 
         if(ifs.gcount()==0&&len>0)
         {
-            LogWarn(getLogger(),"%s read 0 bytes",__FUNCTION__);
+            LogWarnRateLimited(getLogger(),10,"%s read 0 bytes",__FUNCTION__);
             return false;
         }
 